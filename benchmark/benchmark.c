@@ -11,11 +11,81 @@
 #include <sys/mman.h>
 #include <sys/wait.h>
 #include <sys/types.h>
+#include <semaphore.h>
+#include <math.h>
+#include <sys/ioctl.h>
+#include <linux/perf_event.h>
 
 int devfd;
-pthread_mutex_t mutex;
+pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+pcontainer_lock_t total_lock = PCONTAINER_LOCK_INITIALIZER;
 int total = 0;
 
+// state shared by the switch benchmarks (-m lookup, -m scale), -m width and -m ring
+pthread_mutex_t idle_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t idle_cond = PTHREAD_COND_INITIALIZER;
+int idle_release = 0;
+sem_t idle_ready;
+long switches_per_thread = 100000;
+int quantum_us = 5;
+int duration_s = 5;
+int width = 1;
+
+// state shared by the lock benchmark (-m lock)
+enum lock_kind { LOCK_UNCONTENDED, LOCK_CONTENDED, LOCK_PTHREAD };
+pthread_barrier_t lock_barrier;
+long lock_counter = 0;
+
+/**
+ * A thread of the lock benchmark, in container cid of width threads.
+ */
+struct lock_worker
+{
+    int cid;
+    int width;
+    enum lock_kind kind;
+    pcontainer_lock_t own;
+    long counter;
+    long long elapsed; // ns from the barrier to its last unlock
+    pthread_t thread;
+};
+
+// state shared by the proportional share benchmark (-m shares)
+volatile int stop = 0;
+volatile long *share_work;
+int *shares;
+
+/**
+ * Two threads sharing one container that hand the processor to each other.
+ */
+struct pair
+{
+    int cid;
+    int joined;
+    sem_t ready, go;
+    pthread_t threads[2];
+};
+
+/**
+ * current time in nanoseconds.
+ */
+static long long now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * cpu time of the calling thread in nanoseconds.
+ */
+static long long thread_cpu_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
 /**
  * Thread body that creates task in a specified container, does some simple calculations
  * and deletes the task in that container.
@@ -29,6 +99,8 @@ void *thread_body(void *x)
 
     // allocate/associate a container for the thread.
     pcontainer_create(devfd, cid);
+    if (width > 1)
+        pcontainer_set_width(devfd, cid, width);
 
     while (total < 50000000)
     {
@@ -40,9 +112,9 @@ void *thread_body(void *x)
         }
 
         // update the total counter.
-        pthread_mutex_lock(&mutex);
+        pcontainer_lock(devfd, &total_lock);
         total += 1000000;
-        pthread_mutex_unlock(&mutex);
+        pcontainer_unlock(devfd, &total_lock);
     }
     // The sum of each container should be close.
     fprintf(stderr, "TID: %d, Container: %d, Processed: %d\n", (int)syscall(SYS_gettid), cid, processed);
@@ -53,65 +125,288 @@ void *thread_body(void *x)
 }
 
 /**
- * main function to create/run/delete threads in different containers 
+ * Thread body that only occupies a container of its own so that the module
+ * has to keep track of it while the switch latency is measured.
  */
-int main(int argc, char *argv[])
+void *idle_body(void *x)
 {
-    int i, num_of_containers, tasks;
-    int total_tasks = 0; 
-    int *tasks_in_containers;
-    int *cid;
-    pthread_t *threads;
+    int cid = *((int *)x);
 
-    // check num of arguments.
-    if (argc < 3)
+    pcontainer_create(devfd, cid);
+    sem_post(&idle_ready);
+
+    pthread_mutex_lock(&idle_mutex);
+    while (!idle_release)
+        pthread_cond_wait(&idle_cond, &idle_mutex);
+    pthread_mutex_unlock(&idle_mutex);
+
+    pcontainer_delete(devfd, cid);
+    return NULL;
+}
+
+/**
+ * Thread body of the two threads of a pair that hand the processor to each
+ * other through the switch ioctl.
+ */
+void *pair_body(void *x)
+{
+    long i;
+    struct pair *p = (struct pair *)x;
+    int first = __sync_fetch_and_add(&p->joined, 1) == 0;
+
+    pcontainer_create(devfd, p->cid);
+    if (first)
     {
-        fprintf(stderr, "Not enough parameters\n");
-        fprintf(stderr, "usage: ./benchmark <num_container> [<num_task_in_container> ...]\n");
-        exit(1);
+        // let the second thread of the pair join and park before we start
+        sem_post(&p->ready);
+        sem_wait(&p->go);
     }
-    
-    // open the kernel module
-    devfd = open("/dev/pcontainer", O_RDWR);
-    if (devfd < 0)
+    for (i = 0; i < switches_per_thread; i++)
+        pcontainer_context_switch_handler(devfd, p->cid);
+    pcontainer_delete(devfd, p->cid);
+    return NULL;
+}
+
+/**
+ * Run num_of_pairs pairs in containers base_cid, base_cid + 1, ... at the
+ * same time and return the elapsed time of the switches in nanoseconds.
+ */
+long long run_pairs(int num_of_pairs, int base_cid, pthread_attr_t *attr)
+{
+    int i;
+    long long start, end;
+    struct pair *pairs = (struct pair *) calloc(num_of_pairs, sizeof(struct pair));
+
+    for (i = 0; i < num_of_pairs; i++)
     {
-        fprintf(stderr, "Device open failed\n");
-        exit(1);
+        pairs[i].cid = base_cid + i;
+        sem_init(&pairs[i].ready, 0, 0);
+        sem_init(&pairs[i].go, 0, 0);
+        pthread_create(&pairs[i].threads[0], attr, pair_body, &pairs[i]);
+        sem_wait(&pairs[i].ready);
+        pthread_create(&pairs[i].threads[1], attr, pair_body, &pairs[i]);
     }
+    usleep(100000);
 
-    // parse number of containers
-    num_of_containers = atoi(argv[1]);
-    fprintf(stderr, "num_of_containers: %d\n", num_of_containers);
+    start = now_ns();
+    for (i = 0; i < num_of_pairs; i++)
+        sem_post(&pairs[i].go);
+    for (i = 0; i < num_of_pairs; i++)
+    {
+        pthread_join(pairs[i].threads[0], NULL);
+        pthread_join(pairs[i].threads[1], NULL);
+    }
+    end = now_ns();
 
-    // the number of task arguments should be at least equal to num of container
-    if (argc - 2 < num_of_containers)
+    free(pairs);
+    return end - start;
+}
+
+/**
+ * Measure the cost of a switch between the two threads of container 0 while
+ * num_of_containers - 1 other containers exist in the module.
+ */
+double switch_latency(int num_of_containers)
+{
+    int i;
+    int *cid = (int *) calloc(num_of_containers, sizeof(int));
+    pthread_t *threads = (pthread_t *) calloc(num_of_containers, sizeof(pthread_t));
+    pthread_attr_t attr;
+    long long elapsed;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, 64 * 1024);
+    idle_release = 0;
+    sem_init(&idle_ready, 0, 0);
+
+    for (i = 1; i < num_of_containers; i++)
     {
-        fprintf(stderr, "Not enough parameters\n");
-        fprintf(stderr, "usage: ./benchmark <num_container> [<num_task_in_container> ...]\n");
-        exit(1);
+        cid[i] = i;
+        pthread_create(&threads[i], &attr, idle_body, &cid[i]);
     }
-    
-    // generate and store number of tasks and cid for each container.
-    tasks_in_containers = (int *) calloc(num_of_containers, sizeof(int));
+    for (i = 1; i < num_of_containers; i++)
+        sem_wait(&idle_ready);
+
+    elapsed = run_pairs(1, 0, &attr);
+
+    pthread_mutex_lock(&idle_mutex);
+    idle_release = 1;
+    pthread_cond_broadcast(&idle_cond);
+    pthread_mutex_unlock(&idle_mutex);
+    for (i = 1; i < num_of_containers; i++)
+        pthread_join(threads[i], NULL);
+
+    pthread_attr_destroy(&attr);
+    free(threads);
+    free(cid);
+    return (double)elapsed / (2 * switches_per_thread);
+}
+
+/**
+ * Sweep the number of containers from 1 to max_containers by powers of 10 and
+ * report the switch latency for each step; it should stay flat.
+ */
+int lookup_benchmark(int max_containers)
+{
+    int n;
+
+    printf("containers,ns_per_switch\n");
+    for (n = 1; n <= max_containers; n *= 10)
+    {
+        printf("%d,%.1f\n", n, switch_latency(n));
+        fflush(stdout);
+        if (n < max_containers && n * 10 > max_containers)
+            n = max_containers / 10;
+    }
+    return 0;
+}
+
+/**
+ * Start another tenant: a child process with a descriptor of its own that
+ * keeps num_of_containers idle containers with cids 1, 2, ... like the ones
+ * of this process, until a byte is written to *release. Returns its pid once
+ * its containers exist, -1 if it could not start.
+ */
+static pid_t tenant_start(int num_of_containers, int *release)
+{
+    int ready[2], go[2];
+    pthread_t *threads;
+    pthread_attr_t attr;
+    int *cid;
+    pid_t pid;
+    char c;
+    int i;
+
+    if (pipe(ready) != 0 || pipe(go) != 0)
+        return -1;
+    pid = fork();
+    if (pid != 0)
+    {
+        close(ready[1]);
+        close(go[0]);
+        if (pid > 0 && read(ready[0], &c, 1) != 1)
+            pid = -1;
+        close(ready[0]);
+        *release = go[1];
+        return pid;
+    }
+
+    // the descriptor inherited from the parent would share its containers
+    close(devfd);
+    devfd = pcontainer_open();
+    pcontainer_init_kernel_tick(devfd, quantum_us);
     cid = (int *) calloc(num_of_containers, sizeof(int));
+    threads = (pthread_t *) calloc(num_of_containers, sizeof(pthread_t));
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, 64 * 1024);
+    idle_release = 0;
+    sem_init(&idle_ready, 0, 0);
+    for (i = 0; i < num_of_containers; i++)
+    {
+        cid[i] = i + 1;
+        pthread_create(&threads[i], &attr, idle_body, &cid[i]);
+    }
+    for (i = 0; i < num_of_containers; i++)
+        sem_wait(&idle_ready);
+    c = 1;
+    if (write(ready[1], &c, 1) != 1 || read(go[0], &c, 1) != 1)
+        exit(1);
 
+    pthread_mutex_lock(&idle_mutex);
+    idle_release = 1;
+    pthread_cond_broadcast(&idle_cond);
+    pthread_mutex_unlock(&idle_mutex);
     for (i = 0; i < num_of_containers; i++)
+        pthread_join(threads[i], NULL);
+    exit(0);
+}
+
+/**
+ * Measure the cost of a switch between the two threads of container 1 of
+ * this process while another process keeps 0, 10, 100, ... max_containers
+ * containers with the same cids. Every process has containers of its own,
+ * so the cost should not depend on the other tenant. The kernel tick hands
+ * the slots the idle containers hold on.
+ */
+int tenants_benchmark(int max_containers)
+{
+    pthread_attr_t attr;
+    long long elapsed;
+    int release = -1;
+    pid_t pid = 0;
+    char c = 1;
+    int n;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, 64 * 1024);
+    pcontainer_init_kernel_tick(devfd, quantum_us);
+    printf("other_containers,ns_per_switch\n");
+    for (n = 0; n <= max_containers; n = n ? n * 10 : 10)
     {
-        tasks = atoi(argv[i+2]);
-        fprintf(stderr, "task for container %d: %d\n", i, tasks);
-        total_tasks += tasks;
-        tasks_in_containers[i] = tasks;
-        cid[i] = i;
+        if (n > 0 && (pid = tenant_start(n, &release)) < 0)
+        {
+            fprintf(stderr, "Cannot start the other tenant\n");
+            return 1;
+        }
+        elapsed = run_pairs(1, 1, &attr);
+        if (n > 0)
+        {
+            if (write(release, &c, 1) != 1)
+                kill(pid, SIGKILL);
+            close(release);
+            waitpid(pid, NULL, 0);
+        }
+        printf("%d,%.1f\n", n, (double)elapsed / (2 * switches_per_thread));
+        fflush(stdout);
+        if (n < max_containers && n * 10 > max_containers)
+            n = max_containers / 10;
     }
-    
-    fprintf(stderr, "num_of_total_tasks: %d\n\n", total_tasks);
+    pcontainer_init_kernel_tick(devfd, 0);
+    pthread_attr_destroy(&attr);
+    return 0;
+}
 
-    // alarm and mutex lock initialization
-    pcontainer_init(devfd);
-    pthread_mutex_init(&mutex, NULL);
+/**
+ * Run 1, 2, 4, ... max_containers switching pairs concurrently, each in its
+ * own container, and report the aggregate switch throughput; it should grow
+ * with the number of containers up to the number of cores.
+ */
+int scale_benchmark(int max_containers)
+{
+    int n;
+    long long elapsed;
+    pthread_attr_t attr;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, 64 * 1024);
+    printf("containers,cores,switches_per_sec\n");
+    for (n = 1; n <= max_containers; n *= 2)
+    {
+        elapsed = run_pairs(n, 0, &attr);
+        printf("%d,%ld,%.0f\n", n, sysconf(_SC_NPROCESSORS_ONLN),
+               2.0 * n * switches_per_thread * 1e9 / elapsed);
+        fflush(stdout);
+        if (n < max_containers && n * 2 > max_containers)
+            n = max_containers / 2;
+    }
+    pthread_attr_destroy(&attr);
+    return 0;
+}
+
+/**
+ * Run tasks_in_containers[i] threads in container cid[i] for every container
+ * until they processed 50M numbers together and return the elapsed time in
+ * nanoseconds.
+ */
+long long run_tasks(int num_of_containers, int *tasks_in_containers, int *cid, int total_tasks)
+{
+    int i, tasks;
+    pthread_t *threads;
+    long long start;
 
-    // create threads and assign tasks.
+    total = 0;
     threads = (pthread_t*) calloc(total_tasks, sizeof(pthread_t));
+    start = now_ns();
 
     // reset the total task for assigning the thread array.
     total_tasks = 0;
@@ -131,9 +426,1867 @@ int main(int argc, char *argv[])
         pthread_join(threads[i], NULL);
     }
 
-    // cleanup
-    free(tasks_in_containers);
     free(threads);
+    return now_ns() - start;
+}
+
+/**
+ * Run the same workload with switches driven by the SIGPROF timer and by the
+ * kernel module's own timer and compare the useful work done per second.
+ */
+int tick_benchmark(int num_of_containers, int *tasks_in_containers, int *cid, int total_tasks)
+{
+    long long elapsed;
+
+    printf("tick,quantum_us,seconds,work_per_sec\n");
+
+    pcontainer_init(devfd);
+    elapsed = run_tasks(num_of_containers, tasks_in_containers, cid, total_tasks);
+    printf("sigprof,5,%.3f,%.0f\n", elapsed / 1e9, total * 1e9 / elapsed);
+
+    pcontainer_init_kernel_tick(devfd, quantum_us);
+    elapsed = run_tasks(num_of_containers, tasks_in_containers, cid, total_tasks);
+    printf("kernel,%d,%.3f,%.0f\n", quantum_us, elapsed / 1e9, total * 1e9 / elapsed);
+
+    // leave the module with switches driven by user space again
+    pcontainer_init_kernel_tick(devfd, 0);
+    return 0;
+}
+
+/**
+ * Run 1, 2, 4, ... max_width threads in a single container that lets all of
+ * them run at the same time and report the useful work done per second; it
+ * should grow with the width up to the number of cores.
+ */
+int width_benchmark(int max_width)
+{
+    int n, c = 0;
+    long long elapsed;
+
+    pcontainer_init_kernel_tick(devfd, quantum_us);
+    printf("width,cores,seconds,work_per_sec\n");
+    for (n = 1; n <= max_width; n *= 2)
+    {
+        width = n;
+        elapsed = run_tasks(1, &n, &c, n);
+        printf("%d,%ld,%.3f,%.0f\n", n, sysconf(_SC_NPROCESSORS_ONLN), elapsed / 1e9, total * 1e9 / elapsed);
+        fflush(stdout);
+        if (n < max_width && n * 2 > max_width)
+            n = max_width / 2;
+    }
+    pcontainer_init_kernel_tick(devfd, 0);
+    return 0;
+}
+
+/**
+ * Thread body of the lock benchmark that increments a counter under a lock
+ * of its own, under the shared lock or under the shared pthread mutex.
+ */
+void *lock_body(void *x)
+{
+    long i;
+    long long start;
+    struct lock_worker *w = (struct lock_worker *)x;
+
+    pcontainer_create(devfd, w->cid);
+    if (w->width > 1)
+        pcontainer_set_width(devfd, w->cid, w->width);
+    pthread_barrier_wait(&lock_barrier);
+    // timed here, main may only get past the barrier once the workers are done
+    start = now_ns();
+    for (i = 0; i < switches_per_thread; i++)
+    {
+        switch (w->kind)
+        {
+        case LOCK_UNCONTENDED:
+            pcontainer_lock(devfd, &w->own);
+            w->counter++;
+            pcontainer_unlock(devfd, &w->own);
+            break;
+        case LOCK_CONTENDED:
+            pcontainer_lock(devfd, &total_lock);
+            lock_counter++;
+            pcontainer_unlock(devfd, &total_lock);
+            break;
+        case LOCK_PTHREAD:
+            pthread_mutex_lock(&mutex);
+            lock_counter++;
+            pthread_mutex_unlock(&mutex);
+            break;
+        }
+    }
+    w->elapsed = now_ns() - start;
+    pcontainer_delete(devfd, w->cid);
+    return NULL;
+}
+
+/**
+ * Run num_of_threads lock_body threads of the given kind and return the lock
+ * operations per second over the time of the slowest thread. Uncontended
+ * threads each get a container, the others share container 0 and run side
+ * by side.
+ */
+double run_locks(int num_of_threads, enum lock_kind kind)
+{
+    int i;
+    long long elapsed = 0;
+    struct lock_worker *workers = (struct lock_worker *) calloc(num_of_threads, sizeof(struct lock_worker));
+
+    lock_counter = 0;
+    pthread_barrier_init(&lock_barrier, NULL, num_of_threads + 1);
+    for (i = 0; i < num_of_threads; i++)
+    {
+        workers[i].cid = kind == LOCK_UNCONTENDED ? i : 0;
+        workers[i].width = kind == LOCK_UNCONTENDED ? 1 : num_of_threads;
+        workers[i].kind = kind;
+        pthread_create(&workers[i].thread, NULL, lock_body, &workers[i]);
+    }
+    pthread_barrier_wait(&lock_barrier);
+    for (i = 0; i < num_of_threads; i++)
+    {
+        pthread_join(workers[i].thread, NULL);
+        if (workers[i].elapsed > elapsed)
+            elapsed = workers[i].elapsed;
+    }
+
+    pthread_barrier_destroy(&lock_barrier);
+    free(workers);
+    return (double)num_of_threads * switches_per_thread * 1e9 / elapsed;
+}
+
+/**
+ * Report the lock throughput of 1, 2, 4, ... max_threads threads that take a
+ * lock nobody else takes, that all take the same lock, and that all take the
+ * same pthread mutex for comparison.
+ */
+int lock_benchmark(int max_threads)
+{
+    int n;
+
+    pcontainer_init_kernel_tick(devfd, quantum_us);
+    printf("threads,case,locks_per_sec\n");
+    for (n = 1; n <= max_threads; n *= 2)
+    {
+        printf("%d,uncontended,%.0f\n", n, run_locks(n, LOCK_UNCONTENDED));
+        printf("%d,contended,%.0f\n", n, run_locks(n, LOCK_CONTENDED));
+        printf("%d,pthread,%.0f\n", n, run_locks(n, LOCK_PTHREAD));
+        fflush(stdout);
+        if (n < max_threads && n * 2 > max_threads)
+            n = max_threads / 2;
+    }
+    pcontainer_init_kernel_tick(devfd, 0);
+    return 0;
+}
+
+/**
+ * Set the shares of container 0 num_of_ops times through the ring and
+ * return the operations per second.
+ */
+double run_ring(pcontainer_ring_t *ring, long num_of_ops)
+{
+    long queued = 0, completed = 0;
+    long long start = now_ns();
+    struct pcontainer_cqe cqes[256];
+
+    while (completed < num_of_ops)
+    {
+        while (queued < num_of_ops &&
+               pcontainer_ring_queue(ring, PCONTAINER_OP_SHARES, 0, 0, 1024 + (queued & 1), queued) == 0)
+            queued++;
+        pcontainer_ring_submit(ring);
+        completed += pcontainer_ring_reap(ring, cqes, 256);
+    }
+    return num_of_ops * 1e9 / (now_ns() - start);
+}
+
+/**
+ * Compare the operations per second of one ioctl per operation with batches
+ * submitted through the command ring and with the poll thread of the ring.
+ */
+int ring_benchmark(long num_of_ops)
+{
+    long i;
+    long long start;
+    int cid = 0;
+    pthread_t idle;
+    pcontainer_ring_t ring;
+
+    if (pcontainer_ring_init(devfd, &ring) != 0)
+    {
+        perror("ring");
+        return 1;
+    }
+    // container 0 only has to exist while its shares change
+    idle_release = 0;
+    sem_init(&idle_ready, 0, 0);
+    pthread_create(&idle, NULL, idle_body, &cid);
+    sem_wait(&idle_ready);
+
+    printf("path,ops,ops_per_sec\n");
+    start = now_ns();
+    for (i = 0; i < num_of_ops; i++)
+        pcontainer_set_shares(devfd, 0, 1024 + (i & 1));
+    printf("ioctl,%ld,%.0f\n", num_of_ops, num_of_ops * 1e9 / (now_ns() - start));
+    printf("ring,%ld,%.0f\n", num_of_ops, run_ring(&ring, num_of_ops));
+    pcontainer_ring_sqpoll(&ring, 1000);
+    printf("sqpoll,%ld,%.0f\n", num_of_ops, run_ring(&ring, num_of_ops));
+    pcontainer_ring_sqpoll(&ring, 0);
+
+    pthread_mutex_lock(&idle_mutex);
+    idle_release = 1;
+    pthread_cond_broadcast(&idle_cond);
+    pthread_mutex_unlock(&idle_mutex);
+    pthread_join(idle, NULL);
+    pcontainer_ring_exit(&ring);
+    return 0;
+}
+
+/**
+ * Thread body of the churn benchmark that creates its own container and
+ * deletes it again, so that every create allocates a container and a thread.
+ */
+void *churn_body(void *x)
+{
+    long i;
+    int cid = *((int *)x);
+
+    pthread_barrier_wait(&lock_barrier);
+    for (i = 0; i < switches_per_thread; i++)
+    {
+        pcontainer_create(devfd, cid);
+        pcontainer_delete(devfd, cid);
+    }
+    return NULL;
+}
+
+/**
+ * Run num_of_threads churn_body threads with nodes preallocated nodes and
+ * return the creates (each with its delete) per second.
+ */
+double run_churn(int num_of_threads, int nodes)
+{
+    int i;
+    long long start;
+    int *cid = (int *) calloc(num_of_threads, sizeof(int));
+    pthread_t *threads = (pthread_t *) calloc(num_of_threads, sizeof(pthread_t));
+
+    pcontainer_prealloc(devfd, nodes);
+    pthread_barrier_init(&lock_barrier, NULL, num_of_threads + 1);
+    for (i = 0; i < num_of_threads; i++)
+    {
+        cid[i] = i;
+        pthread_create(&threads[i], NULL, churn_body, &cid[i]);
+    }
+    pthread_barrier_wait(&lock_barrier);
+    start = now_ns();
+    for (i = 0; i < num_of_threads; i++)
+        pthread_join(threads[i], NULL);
+    start = now_ns() - start;
+
+    pthread_barrier_destroy(&lock_barrier);
+    pcontainer_prealloc(devfd, 0);
+    free(threads);
+    free(cid);
+    return (double)num_of_threads * switches_per_thread * 1e9 / start;
+}
+
+/**
+ * Report the creates per second of 1, 2, 4, ... max_threads threads that
+ * create and delete containers of their own, with nodes from the slab
+ * caches and with nodes preallocated through PCONTAINER_IOCTL_PREALLOC.
+ */
+int churn_benchmark(int max_threads)
+{
+    int n;
+    // the pools are shared by every user of the module, sizing them needs CAP_SYS_ADMIN
+    int prealloc = pcontainer_prealloc(devfd, 0) == 0;
+
+    if (!prealloc)
+        fprintf(stderr, "Cannot preallocate nodes without CAP_SYS_ADMIN, measuring the slab caches only\n");
+    printf("threads,prealloc,creates_per_sec\n");
+    for (n = 1; n <= max_threads; n *= 2)
+    {
+        printf("%d,0,%.0f\n", n, run_churn(n, 0));
+        if (prealloc)
+            printf("%d,%d,%.0f\n", n, PCONTAINER_MAX_PREALLOC, run_churn(n, PCONTAINER_MAX_PREALLOC));
+        fflush(stdout);
+        if (n < max_threads && n * 2 > max_threads)
+            n = max_threads / 2;
+    }
+    return 0;
+}
+
+/**
+ * Thread body that owns container cid with the configured shares and counts
+ * its progress until the benchmark stops.
+ */
+void *share_body(void *x)
+{
+    int cid = *((int *)x);
+    int i;
+    double sum = 0;
+
+    pcontainer_create(devfd, cid);
+    // compete on the run queue of cpu 0, every cpu has its own slots
+    pcontainer_set_affinity(devfd, cid, 1);
+    pcontainer_set_shares(devfd, cid, shares[cid]);
+    while (!stop)
+    {
+        for (i = 0; i < 10000; i++)
+            sum += 1.0 / (1.2 + i);
+        share_work[cid] += 10000;
+    }
+    pcontainer_delete(devfd, cid);
+    return NULL;
+}
+
+/**
+ * Run one CPU-bound thread per container for duration_s seconds and compare
+ * the share of the work each container got with its share of the total
+ * shares. All containers are pinned to cpu 0 so that they compete for its slots.
+ */
+int shares_benchmark(int num_of_containers, int *cid)
+{
+    int i;
+    long total_work = 0, total_shares = 0;
+    long *work = (long *) calloc(num_of_containers, sizeof(long));
+    pthread_t *threads = (pthread_t *) calloc(num_of_containers, sizeof(pthread_t));
+    double expected, achieved, max_error = 0;
+
+    share_work = (volatile long *) calloc(num_of_containers, sizeof(long));
+    pcontainer_init_kernel_tick(devfd, quantum_us);
+    for (i = 0; i < num_of_containers; i++)
+        pthread_create(&threads[i], NULL, share_body, &cid[i]);
+    sleep(duration_s);
+
+    // snapshot before the threads that are still parked get their last turn
+    for (i = 0; i < num_of_containers; i++)
+    {
+        work[i] = share_work[i];
+        total_work += work[i];
+        total_shares += shares[i];
+    }
+    stop = 1;
+    for (i = 0; i < num_of_containers; i++)
+        pthread_join(threads[i], NULL);
+    pcontainer_init_kernel_tick(devfd, 0);
+
+    printf("container,shares,work,expected_ratio,achieved_ratio,error\n");
+    for (i = 0; i < num_of_containers; i++)
+    {
+        expected = (double)shares[i] / total_shares;
+        achieved = total_work ? (double)work[i] / total_work : 0;
+        printf("%d,%d,%ld,%.4f,%.4f,%.4f\n", i, shares[i], work[i], expected, achieved, achieved - expected);
+        if (fabs(achieved - expected) > max_error)
+            max_error = fabs(achieved - expected);
+    }
+    fprintf(stderr, "max ratio error: %.4f\n", max_error);
+
+    free((void *)share_work);
+    free(threads);
+    free(work);
+    return 0;
+}
+
+/**
+ * Print ratio a / b as a CSV field, empty if either was not counted.
+ */
+static void print_rate(double a, double b)
+{
+    if (a < 0 || b <= 0)
+        printf(",");
+    else
+        printf(",%.4f", a / b);
+}
+
+/**
+ * Print the statistics of every container as CSV once a second for
+ * duration_s seconds, next to a benchmark running in another process.
+ */
+int stats_benchmark(void)
+{
+    struct pcontainer_stats_page *page = pcontainer_stats_map(devfd);
+    struct pcontainer_stats stats;
+    int second, i;
+
+    if (page == NULL)
+    {
+        fprintf(stderr, "Stats mmap failed\n");
+        return 1;
+    }
+    printf("second,nsid,cid,cpu_ns,switches,runnable,sleeping,wait_ns,wakeups,wakeup_avg_ns,wakeup_max_ns,throttled,throttled_ns,slice_ns,reaped,blocks,instructions,cycles,llc_misses,branch_misses,ipc,llc_mpki,branch_mpki\n");
+    for (second = 0; second < duration_s; second++)
+    {
+        for (i = 0; i < PCONTAINER_STATS_SLOTS; i++)
+        {
+            if (!pcontainer_stats_read(page, i, &stats))
+                continue;
+            printf("%d,%llu,%llu,%llu,%llu,%u,%u,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu", second,
+                   (unsigned long long) stats.nsid, (unsigned long long) stats.cid, (unsigned long long) stats.cpu_ns,
+                   (unsigned long long) stats.switches, stats.nr_runnable, stats.nr_sleeping,
+                   (unsigned long long) stats.wait_ns, (unsigned long long) stats.wakeups,
+                   (unsigned long long) (stats.wakeups ? stats.wakeup_latency_sum_ns / stats.wakeups : 0),
+                   (unsigned long long) stats.wakeup_latency_max_ns,
+                   (unsigned long long) stats.nr_throttled, (unsigned long long) stats.throttled_ns,
+                   (unsigned long long) stats.slice_ns, (unsigned long long) stats.nr_reaped,
+                   (unsigned long long) stats.nr_blocks, (unsigned long long) stats.instructions,
+                   (unsigned long long) stats.cycles, (unsigned long long) stats.llc_misses,
+                   (unsigned long long) stats.branch_misses);
+            print_rate(stats.instructions, stats.cycles);
+            print_rate(stats.llc_misses * 1000.0, stats.instructions);
+            print_rate(stats.branch_misses * 1000.0, stats.instructions);
+            printf("\n");
+        }
+        fflush(stdout);
+        sleep(1);
+    }
+    pcontainer_stats_unmap(page);
+    return 0;
+}
+
+// state shared by the quota benchmark (-m quota)
+#define QUOTA_CID 1
+#define QUOTA_TOLERANCE 0.05 // accepted error of the utilization, relative to the quota
+int quota_us, period_us;
+
+/**
+ * Result of the thread of the quota benchmark.
+ */
+struct quota_result
+{
+    int ret; // errno of setting the quota
+    long long cpu_ns;
+    long long wall_ns;
+    struct pcontainer_stats stats;
+};
+
+/**
+ * Thread body that owns container QUOTA_CID with the quota under test and
+ * spins until the benchmark stops, measuring the cpu time it got.
+ */
+void *quota_body(void *x)
+{
+    struct quota_result *result = (struct quota_result *) x;
+    struct pcontainer_stats_page *page;
+    long long cpu_start, wall_start;
+    double sum = 0;
+    int i;
+
+    pcontainer_create(devfd, QUOTA_CID);
+    if (pcontainer_set_quota(devfd, QUOTA_CID, quota_us, period_us) != 0)
+        result->ret = errno;
+    cpu_start = thread_cpu_ns();
+    wall_start = now_ns();
+    while (!stop && result->ret == 0)
+    {
+        for (i = 0; i < 10000; i++)
+            sum += 1.0 / (1.2 + i);
+    }
+    result->cpu_ns = thread_cpu_ns() - cpu_start;
+    result->wall_ns = now_ns() - wall_start;
+    // the slot of the container is freed by the delete
+    page = pcontainer_stats_map(devfd);
+    if (page != NULL)
+    {
+        pcontainer_stats_find(page, QUOTA_CID, &result->stats);
+        pcontainer_stats_unmap(page);
+    }
+    pcontainer_delete(devfd, QUOTA_CID);
+    return NULL;
+}
+
+/**
+ * Run one CPU-bound thread in a container limited to quota_us of every
+ * period_us for duration_s seconds and check that the share of the cpu it
+ * got stays within QUOTA_TOLERANCE of quota_us / period_us.
+ */
+int quota_benchmark(void)
+{
+    struct quota_result result;
+    pthread_t thread;
+    double expected, achieved;
+
+    memset(&result, 0, sizeof(result));
+    pthread_create(&thread, NULL, quota_body, &result);
+    sleep(duration_s);
+    stop = 1;
+    pthread_join(thread, NULL);
+    if (result.ret != 0)
+    {
+        fprintf(stderr, "Setting the quota failed: %s\n", strerror(result.ret));
+        return 1;
+    }
+
+    // one thread uses at most one cpu whatever the quota
+    expected = (double)quota_us / period_us;
+    if (expected > 1)
+        expected = 1;
+    achieved = (double)result.cpu_ns / result.wall_ns;
+    printf("quota_us,period_us,expected,achieved,error,throttled,throttled_ns\n");
+    printf("%d,%d,%.4f,%.4f,%.4f,%llu,%llu\n", quota_us, period_us, expected, achieved, achieved - expected,
+           (unsigned long long) result.stats.nr_throttled, (unsigned long long) result.stats.throttled_ns);
+    if (fabs(achieved - expected) > QUOTA_TOLERANCE * expected)
+    {
+        fprintf(stderr, "utilization %.4f is off the quota %.4f by more than %.0f%%\n",
+                achieved, expected, QUOTA_TOLERANCE * 100);
+        return 1;
+    }
+    return 0;
+}
+
+// state shared by the benchmark suite (-m suite)
+enum suite_profile { PROFILE_CPU, PROFILE_MIXED, PROFILE_LOCK };
+const char *profile_names[] = { "cpu", "mixed", "lock" };
+#define SUITE_CHUNK 10000 // iterations of work between two samples
+#define SUITE_SAMPLES 8192 // switch latency samples kept per thread
+int json = 0;
+int suite_rows = 0; // results printed so far, JSON separates them with commas
+
+/**
+ * A thread of the suite: runs one profile in container cid, or outside of
+ * any container for the baseline, and samples how long it was switched out.
+ */
+struct suite_worker
+{
+    int cid;
+    enum suite_profile profile;
+    int in_module;
+    pcontainer_lock_t *lock; // shared by the threads of the container
+    pthread_mutex_t *mutex; // the same for the baseline
+    volatile long work;
+    long long samples[SUITE_SAMPLES];
+    long nr_gaps; // gaps seen, only SUITE_SAMPLES of them are kept
+    unsigned int seed;
+    pthread_t thread;
+};
+
+/**
+ * Keep a uniform sample of the gaps of a thread (reservoir sampling).
+ */
+static void suite_sample(struct suite_worker *w, long long gap)
+{
+    long slot;
+
+    if (w->nr_gaps < SUITE_SAMPLES)
+        slot = w->nr_gaps;
+    else
+        slot = rand_r(&w->seed) % (w->nr_gaps + 1);
+    if (slot < SUITE_SAMPLES)
+        w->samples[slot] = gap;
+    w->nr_gaps++;
+}
+
+/**
+ * Thread body of the suite. The wall clock time of a chunk of work that is
+ * not cpu time of the thread is time it was switched out; every such gap
+ * counts as one switch.
+ */
+void *suite_body(void *x)
+{
+    struct suite_worker *w = (struct suite_worker *)x;
+    long long wall, cpu, gap;
+    double sum = 0;
+    int i;
+
+    if (w->in_module)
+        pcontainer_create(devfd, w->cid);
+    pthread_barrier_wait(&lock_barrier);
+    while (!stop)
+    {
+        wall = now_ns();
+        cpu = thread_cpu_ns();
+        if (w->profile == PROFILE_LOCK)
+        {
+            // a tenth of the work is done under the lock of the container
+            if (w->in_module)
+                pcontainer_lock(devfd, w->lock);
+            else
+                pthread_mutex_lock(w->mutex);
+            for (i = 0; i < SUITE_CHUNK / 10; i++)
+                sum += 1.0 / (1.2 + i);
+            if (w->in_module)
+                pcontainer_unlock(devfd, w->lock);
+            else
+                pthread_mutex_unlock(w->mutex);
+            for (; i < SUITE_CHUNK; i++)
+                sum += 1.0 / (1.2 + i);
+        }
+        else
+        {
+            for (i = 0; i < SUITE_CHUNK; i++)
+                sum += 1.0 / (1.2 + i);
+        }
+        gap = (now_ns() - wall) - (thread_cpu_ns() - cpu);
+        if (gap > 1000)
+            suite_sample(w, gap);
+        w->work += SUITE_CHUNK;
+        // the mixed profile sleeps as long as it computed
+        if (w->profile == PROFILE_MIXED)
+            usleep(50);
+    }
+    if (w->in_module)
+        pcontainer_delete(devfd, w->cid);
+    return (void *)(long)(sum < 0);
+}
+
+static int compare_ll(const void *a, const void *b)
+{
+    long long x = *(const long long *)a, y = *(const long long *)b;
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * Run num_of_containers containers of tasks threads of a profile for
+ * duration_s seconds, in the module or as plain threads, and print one
+ * result. Returns the total work per second.
+ */
+double suite_run(enum suite_profile profile, int in_module, int num_of_containers, int tasks, double baseline)
+{
+    int n = num_of_containers * tasks;
+    int i, c, nr_samples = 0;
+    struct suite_worker *workers = (struct suite_worker *) calloc(n, sizeof(struct suite_worker));
+    pcontainer_lock_t *locks = (pcontainer_lock_t *) calloc(num_of_containers, sizeof(pcontainer_lock_t));
+    pthread_mutex_t *mutexes = (pthread_mutex_t *) calloc(num_of_containers, sizeof(pthread_mutex_t));
+    double *container_work = (double *) calloc(num_of_containers, sizeof(double));
+    long long *samples;
+    long long start, elapsed;
+    double total_work = 0, square_sum = 0, fairness, p50, p99, p999;
+
+    for (c = 0; c < num_of_containers; c++)
+        pthread_mutex_init(&mutexes[c], NULL);
+    stop = 0;
+    pthread_barrier_init(&lock_barrier, NULL, n + 1);
+    for (i = 0; i < n; i++)
+    {
+        workers[i].cid = i / tasks;
+        workers[i].profile = profile;
+        workers[i].in_module = in_module;
+        workers[i].lock = &locks[i / tasks];
+        workers[i].mutex = &mutexes[i / tasks];
+        workers[i].seed = i + 1;
+        pthread_create(&workers[i].thread, NULL, suite_body, &workers[i]);
+    }
+    pthread_barrier_wait(&lock_barrier);
+    start = now_ns();
+    sleep(duration_s);
+
+    // snapshot before the threads that are still parked get their last turn
+    elapsed = now_ns() - start;
+    for (i = 0; i < n; i++)
+        container_work[workers[i].cid] += workers[i].work * 1e9 / elapsed;
+    stop = 1;
+    for (i = 0; i < n; i++)
+        pthread_join(workers[i].thread, NULL);
+
+    // Jain's fairness index of the throughput of the containers
+    for (c = 0; c < num_of_containers; c++)
+    {
+        total_work += container_work[c];
+        square_sum += container_work[c] * container_work[c];
+    }
+    fairness = square_sum > 0 ? total_work * total_work / (num_of_containers * square_sum) : 0;
+
+    samples = (long long *) calloc((size_t)n * SUITE_SAMPLES, sizeof(long long));
+    for (i = 0; i < n; i++)
+    {
+        memcpy(samples + nr_samples, workers[i].samples,
+               (workers[i].nr_gaps < SUITE_SAMPLES ? workers[i].nr_gaps : SUITE_SAMPLES) * sizeof(long long));
+        nr_samples += workers[i].nr_gaps < SUITE_SAMPLES ? workers[i].nr_gaps : SUITE_SAMPLES;
+    }
+    qsort(samples, nr_samples, sizeof(long long), compare_ll);
+    p50 = nr_samples ? samples[nr_samples / 2] / 1e3 : 0;
+    p99 = nr_samples ? samples[(long)(nr_samples * 0.99)] / 1e3 : 0;
+    p999 = nr_samples ? samples[(long)(nr_samples * 0.999)] / 1e3 : 0;
+
+    if (json)
+    {
+        printf("%s  {\"profile\": \"%s\", \"mode\": \"%s\", \"containers\": %d, \"tasks\": %d, "
+               "\"work_per_sec\": %.0f, \"fairness\": %.4f, \"switch_p50_us\": %.1f, "
+               "\"switch_p99_us\": %.1f, \"switch_p999_us\": %.1f, \"overhead\": %.4f, "
+               "\"container_work_per_sec\": [",
+               suite_rows ? ",\n" : "", profile_names[profile], in_module ? "module" : "baseline",
+               num_of_containers, tasks, total_work, fairness, p50, p99, p999,
+               baseline > 0 ? 1 - total_work / baseline : 0);
+        for (c = 0; c < num_of_containers; c++)
+            printf("%s%.0f", c ? ", " : "", container_work[c]);
+        printf("]}");
+    }
+    else
+    {
+        printf("%s,%s,%d,%d,%.0f,%.4f,%.1f,%.1f,%.1f,%.4f,", profile_names[profile],
+               in_module ? "module" : "baseline", num_of_containers, tasks,
+               total_work, fairness, p50, p99, p999, baseline > 0 ? 1 - total_work / baseline : 0);
+        for (c = 0; c < num_of_containers; c++)
+            printf("%s%.0f", c ? ";" : "", container_work[c]);
+        printf("\n");
+    }
+    fflush(stdout);
+    suite_rows++;
+
+    pthread_barrier_destroy(&lock_barrier);
+    for (c = 0; c < num_of_containers; c++)
+        pthread_mutex_destroy(&mutexes[c]);
+    free(samples);
+    free(container_work);
+    free(mutexes);
+    free(locks);
+    free(workers);
+    return total_work;
+}
+
+/**
+ * The point of the suite after n on the way to max: 4 times n, or max
+ * itself when that would skip it.
+ */
+static int suite_next(int n, int max)
+{
+    return n < max && n * 4 > max ? max : n * 4;
+}
+
+/**
+ * Sweep every profile over 1, 4, 16, ... max_containers containers of 1, 4,
+ * 16, ... max_tasks threads, from many tiny containers to a few huge ones.
+ * The maxima are always the last points of the sweep.
+ * Every configuration first runs as plain threads for the baseline, then in
+ * the module; the overhead is the work the module run lost against it.
+ * Only the baseline runs when the module is not loaded.
+ */
+int suite_benchmark(int max_containers, int max_tasks)
+{
+    int profile, c, t;
+    double baseline;
+
+    if (devfd >= 0)
+        pcontainer_init_kernel_tick(devfd, quantum_us);
+    if (json)
+        printf("[\n");
+    else
+        printf("profile,mode,containers,tasks,work_per_sec,fairness,switch_p50_us,switch_p99_us,switch_p999_us,overhead,container_work_per_sec\n");
+    for (profile = PROFILE_CPU; profile <= PROFILE_LOCK; profile++)
+    {
+        for (c = 1; c <= max_containers; c = suite_next(c, max_containers))
+        {
+            for (t = 1; t <= max_tasks; t = suite_next(t, max_tasks))
+            {
+                baseline = suite_run(profile, 0, c, t, 0);
+                if (devfd >= 0)
+                    suite_run(profile, 1, c, t, baseline);
+            }
+        }
+    }
+    if (json)
+        printf("\n]\n");
+    if (devfd >= 0)
+        pcontainer_init_kernel_tick(devfd, 0);
+    return 0;
+}
+
+// state shared by the latency benchmark (-m latency) and the slice benchmark (-m slice)
+#define LATENCY_SLEEP_US 1000 // time between two requests of the latency container
+#define LATENCY_SAMPLES 65536
+const char *class_names[] = { "batch", "latency" };
+volatile long batch_work;
+int slice_min_us = 0, slice_max_us = 0; // quantum of every container, 0 for the global one
+
+/**
+ * The thread of the container under test: sleeps until its next request
+ * is due and samples how late it runs after that.
+ */
+struct latency_worker
+{
+    int sched_class;
+    long long samples[LATENCY_SAMPLES];
+    long nr_samples;
+};
+
+/**
+ * Join the calling thread to container cid on cpu 0 with the quantum under test.
+ */
+static void latency_join(int cid)
+{
+    pcontainer_create(devfd, cid);
+    pcontainer_set_affinity(devfd, cid, 1);
+    if (slice_max_us != 0)
+        pcontainer_set_slice(devfd, cid, slice_min_us, slice_max_us);
+}
+
+/**
+ * Thread body of a batch container cid that spins until the benchmark stops.
+ */
+void *batch_body(void *x)
+{
+    int cid = *((int *)x);
+    double sum = 0;
+    int i;
+
+    latency_join(cid);
+    while (!stop)
+    {
+        for (i = 0; i < 10000; i++)
+            sum += 1.0 / (1.2 + i);
+        __sync_fetch_and_add(&batch_work, 10000);
+    }
+    pcontainer_delete(devfd, cid);
+    return NULL;
+}
+
+/**
+ * Thread body of container 0 in the class of the worker, which wakes up
+ * every LATENCY_SLEEP_US until the benchmark stops.
+ */
+void *latency_body(void *x)
+{
+    struct latency_worker *w = (struct latency_worker *) x;
+    struct timespec ts = { 0, LATENCY_SLEEP_US * 1000 };
+    long long due;
+
+    latency_join(0);
+    pcontainer_set_class(devfd, 0, w->sched_class);
+    while (!stop && w->nr_samples < LATENCY_SAMPLES)
+    {
+        due = now_ns() + LATENCY_SLEEP_US * 1000LL;
+        nanosleep(&ts, NULL);
+        w->samples[w->nr_samples++] = now_ns() - due;
+    }
+    pcontainer_delete(devfd, 0);
+    return NULL;
+}
+
+/**
+ * Run container 0 of the worker against num_of_batch CPU-bound batch
+ * containers on cpu 0 for duration_s seconds and sort its samples.
+ * Returns the work per second of the batch containers.
+ */
+double latency_run(struct latency_worker *w, int num_of_batch)
+{
+    pthread_t *threads = (pthread_t *) calloc(num_of_batch + 1, sizeof(pthread_t));
+    int *cid = (int *) calloc(num_of_batch, sizeof(int));
+    long work;
+    int i;
+
+    stop = 0;
+    batch_work = 0;
+    w->nr_samples = 0;
+    for (i = 0; i < num_of_batch; i++)
+    {
+        cid[i] = i + 1;
+        pthread_create(&threads[i], NULL, batch_body, &cid[i]);
+    }
+    pthread_create(&threads[num_of_batch], NULL, latency_body, w);
+    sleep(duration_s);
+    work = batch_work;
+    stop = 1;
+    for (i = 0; i <= num_of_batch; i++)
+        pthread_join(threads[i], NULL);
+    qsort(w->samples, w->nr_samples, sizeof(long long), compare_ll);
+
+    free(cid);
+    free(threads);
+    return (double)work / duration_s;
+}
+
+/**
+ * Sample p (0.5 for the median) of the sorted samples of a worker in us.
+ */
+static double latency_percentile(struct latency_worker *w, double p)
+{
+    return w->nr_samples ? w->samples[(long)(w->nr_samples * p)] / 1e3 : 0;
+}
+
+/**
+ * Measure the wakeup latency of a container that sleeps between requests
+ * while num_of_batch CPU-bound batch containers compete with it for the
+ * slots of cpu 0, once as a batch container and once as a latency container.
+ */
+int latency_benchmark(int num_of_batch)
+{
+    struct latency_worker *w = (struct latency_worker *) malloc(sizeof(*w));
+    int sched_class;
+
+    pcontainer_init_kernel_tick(devfd, quantum_us);
+    printf("class,batch_containers,samples,p50_us,p99_us,p999_us,max_us\n");
+    for (sched_class = PCONTAINER_CLASS_BATCH; sched_class <= PCONTAINER_CLASS_LATENCY; sched_class++)
+    {
+        w->sched_class = sched_class;
+        latency_run(w, num_of_batch);
+        printf("%s,%d,%ld,%.1f,%.1f,%.1f,%.1f\n", class_names[sched_class], num_of_batch, w->nr_samples,
+               latency_percentile(w, 0.5), latency_percentile(w, 0.99), latency_percentile(w, 0.999),
+               w->nr_samples ? w->samples[w->nr_samples - 1] / 1e3 : 0);
+        fflush(stdout);
+    }
+    pcontainer_init_kernel_tick(devfd, 0);
+
+    free(w);
+    return 0;
+}
+
+/**
+ * Compare a fixed quantum of min_us, a fixed quantum of max_us and one that
+ * adapts between them on the throughput of num_of_batch CPU-bound containers
+ * and the wakeup latency of a container that sleeps between requests.
+ */
+int slice_benchmark(int num_of_batch, int min_us, int max_us)
+{
+    struct latency_worker *w = (struct latency_worker *) calloc(1, sizeof(*w));
+    const char *names[] = { "fixed_min", "fixed_max", "adaptive" };
+    int bounds[][2] = { { min_us, min_us }, { max_us, max_us }, { min_us, max_us } };
+    double work_per_sec;
+    int i;
+
+    printf("slice,min_us,max_us,batch_containers,work_per_sec,p50_us,p99_us,p999_us\n");
+    for (i = 0; i < 3; i++)
+    {
+        slice_min_us = bounds[i][0];
+        slice_max_us = bounds[i][1];
+        work_per_sec = latency_run(w, num_of_batch);
+        printf("%s,%d,%d,%d,%.0f,%.1f,%.1f,%.1f\n", names[i], slice_min_us, slice_max_us, num_of_batch,
+               work_per_sec, latency_percentile(w, 0.5), latency_percentile(w, 0.99), latency_percentile(w, 0.999));
+        fflush(stdout);
+    }
+    slice_min_us = slice_max_us = 0;
+
+    free(w);
+    return 0;
+}
+
+// state shared by the placement benchmark (-m placement)
+#define PLACEMENT_CID 1
+#define PLACEMENT_BUFFER (1 << 20) // working set shared by the threads of the container
+const char *placement_names[] = { "off", "preferred", "strict" };
+int placement;
+volatile long placement_work;
+volatile char *placement_buffer;
+
+/**
+ * A hardware counter of the whole process, inherited by the threads it creates.
+ */
+struct perf_counter
+{
+    const char *name;
+    __u32 type;
+    __u64 config;
+    int fd; // -1 if the cpu or the kernel does not count it
+};
+
+#define PERF_CACHE(cache, result) \
+    ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | ((result) << 16))
+
+struct perf_counter placement_counters[] = {
+    { "cache_refs", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES, -1 },
+    { "cache_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, -1 },
+    { "llc_loads", PERF_TYPE_HW_CACHE, PERF_CACHE(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_RESULT_ACCESS), -1 },
+    { "llc_load_misses", PERF_TYPE_HW_CACHE, PERF_CACHE(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_RESULT_MISS), -1 },
+    { "node_loads", PERF_TYPE_HW_CACHE, PERF_CACHE(PERF_COUNT_HW_CACHE_NODE, PERF_COUNT_HW_CACHE_RESULT_ACCESS), -1 },
+    { "remote_node_loads", PERF_TYPE_HW_CACHE, PERF_CACHE(PERF_COUNT_HW_CACHE_NODE, PERF_COUNT_HW_CACHE_RESULT_MISS), -1 },
+};
+#define NR_PLACEMENT_COUNTERS (int)(sizeof(placement_counters) / sizeof(placement_counters[0]))
+
+/**
+ * Start counting an event in user space for the calling thread and the
+ * threads it creates from now on.
+ */
+static int perf_open(__u32 type, __u64 config)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/**
+ * Count of an event, scaled up for the time it shared the counters with
+ * others. -1 if it was not counted.
+ */
+static double perf_read(int fd)
+{
+    __u64 values[3]; // value, time enabled, time running
+
+    if (fd < 0 || read(fd, values, sizeof(values)) != sizeof(values) || values[2] == 0)
+        return -1;
+    return (double)values[0] * values[1] / values[2];
+}
+
+/**
+ * Thread body that walks the working set of container PLACEMENT_CID until
+ * the benchmark stops.
+ */
+void *placement_body(void *x)
+{
+    int i;
+
+    (void)x;
+    pcontainer_create(devfd, PLACEMENT_CID);
+    pcontainer_set_placement(devfd, PLACEMENT_CID, placement);
+    while (!stop)
+    {
+        for (i = 0; i < PLACEMENT_BUFFER; i += 64)
+            placement_buffer[i]++;
+        __sync_fetch_and_add(&placement_work, 1);
+    }
+    pcontainer_delete(devfd, PLACEMENT_CID);
+    return NULL;
+}
+
+/**
+ * Run num_of_threads threads taking turns in one container over a shared
+ * working set, with each placement, and compare the passes over the working
+ * set per second and the cache misses and remote NUMA loads of the process.
+ */
+int placement_benchmark(int num_of_threads)
+{
+    pthread_t *threads = (pthread_t *) calloc(num_of_threads, sizeof(pthread_t));
+    double counts[NR_PLACEMENT_COUNTERS];
+    long work;
+    int i;
+
+    placement_buffer = (volatile char *) calloc(PLACEMENT_BUFFER, 1);
+    pcontainer_init_kernel_tick(devfd, quantum_us);
+    printf("placement,threads,passes_per_sec");
+    for (i = 0; i < NR_PLACEMENT_COUNTERS; i++)
+        printf(",%s", placement_counters[i].name);
+    printf(",cache_miss_rate,llc_miss_rate,remote_rate\n");
+    for (placement = PCONTAINER_PLACE_OFF; placement <= PCONTAINER_PLACE_STRICT; placement++)
+    {
+        stop = 0;
+        placement_work = 0;
+        for (i = 0; i < NR_PLACEMENT_COUNTERS; i++)
+        {
+            placement_counters[i].fd = perf_open(placement_counters[i].type, placement_counters[i].config);
+            if (placement_counters[i].fd < 0 && placement == PCONTAINER_PLACE_OFF)
+                fprintf(stderr, "%s is not counted\n", placement_counters[i].name);
+        }
+        for (i = 0; i < num_of_threads; i++)
+            pthread_create(&threads[i], NULL, placement_body, NULL);
+        sleep(duration_s);
+        work = placement_work;
+        stop = 1;
+        for (i = 0; i < num_of_threads; i++)
+            pthread_join(threads[i], NULL);
+        for (i = 0; i < NR_PLACEMENT_COUNTERS; i++)
+        {
+            counts[i] = perf_read(placement_counters[i].fd);
+            if (placement_counters[i].fd >= 0)
+                close(placement_counters[i].fd);
+        }
+
+        printf("%s,%d,%.1f", placement_names[placement], num_of_threads, (double)work / duration_s);
+        for (i = 0; i < NR_PLACEMENT_COUNTERS; i++)
+        {
+            if (counts[i] < 0)
+                printf(",");
+            else
+                printf(",%.0f", counts[i]);
+        }
+        print_rate(counts[1], counts[0]);
+        print_rate(counts[3], counts[2]);
+        print_rate(counts[5], counts[4]);
+        printf("\n");
+        fflush(stdout);
+    }
+    pcontainer_init_kernel_tick(devfd, 0);
+
+    free((void *)placement_buffer);
+    free(threads);
+    return 0;
+}
+
+// state shared by the balance benchmark (-m balance)
+#define BALANCE_JOBS 64 // containers created one after the other by each thread
+#define BALANCE_UNIT 100000 // iterations of one unit of work
+#define STEAL_PARAM "/sys/module/processor_container/parameters/steal"
+volatile long balance_work;
+
+/**
+ * Thread body that runs BALANCE_JOBS jobs, each in a container of its own
+ * that lives as long as the job. Job sizes are skewed: 1 to 32 units, the
+ * same sequence for the same thread in every run.
+ */
+void *balance_body(void *x)
+{
+    int id = *((int *)x);
+    unsigned int seed = id + 1;
+    double sum = 0;
+    int job, units, u, i;
+
+    for (job = 0; job < BALANCE_JOBS; job++)
+    {
+        units = 1 << (rand_r(&seed) % 6);
+        pcontainer_create(devfd, id * BALANCE_JOBS + job + 1);
+        for (u = 0; u < units; u++)
+        {
+            for (i = 0; i < BALANCE_UNIT; i++)
+                sum += 1.0 / (1.2 + i);
+        }
+        __sync_fetch_and_add(&balance_work, units);
+        pcontainer_delete(devfd, id * BALANCE_JOBS + job + 1);
+    }
+    return NULL;
+}
+
+/**
+ * Run the jobs of num_of_threads threads and print the makespan and the
+ * units of work per second. steal is the setting of the module, -1 if unknown.
+ */
+void balance_run(int num_of_threads, int steal)
+{
+    pthread_t *threads = (pthread_t *) calloc(num_of_threads, sizeof(pthread_t));
+    int *ids = (int *) calloc(num_of_threads, sizeof(int));
+    long long start, makespan;
+    int i;
+
+    balance_work = 0;
+    start = now_ns();
+    for (i = 0; i < num_of_threads; i++)
+    {
+        ids[i] = i;
+        pthread_create(&threads[i], NULL, balance_body, &ids[i]);
+    }
+    for (i = 0; i < num_of_threads; i++)
+        pthread_join(threads[i], NULL);
+    makespan = now_ns() - start;
+
+    if (steal < 0)
+        printf("unknown");
+    else
+        printf("%s", steal ? "on" : "off");
+    printf(",%d,%.3f,%.1f\n", num_of_threads, makespan / 1e9, balance_work / (makespan / 1e9));
+    fflush(stdout);
+    free(ids);
+    free(threads);
+}
+
+/**
+ * Set the steal parameter of the module, returns -1 if it cannot be written.
+ */
+static int set_steal(int on)
+{
+    FILE *param = fopen(STEAL_PARAM, "w");
+
+    if (param == NULL)
+        return -1;
+    fprintf(param, "%c\n", on ? 'Y' : 'N');
+    return fclose(param) == 0 ? 0 : -1;
+}
+
+/**
+ * Run num_of_threads threads that churn through containers of skewed sizes
+ * with work stealing between the run queues off and on. Only the current
+ * setting is measured if the parameter of the module cannot be written.
+ */
+int balance_benchmark(int num_of_threads)
+{
+    FILE *param;
+    int steal = -1;
+
+    pcontainer_init_kernel_tick(devfd, quantum_us);
+    printf("steal,threads,makespan_s,units_per_sec\n");
+    if (set_steal(0) == 0)
+    {
+        balance_run(num_of_threads, 0);
+        set_steal(1);
+        balance_run(num_of_threads, 1);
+    }
+    else
+    {
+        fprintf(stderr, "Cannot write %s, measuring the current setting only\n", STEAL_PARAM);
+        param = fopen(STEAL_PARAM, "r");
+        if (param != NULL)
+        {
+            steal = fgetc(param) == 'Y';
+            fclose(param);
+        }
+        balance_run(num_of_threads, steal);
+    }
+    pcontainer_init_kernel_tick(devfd, 0);
+    return 0;
+}
+
+// state shared by the turn page benchmark (-m turn)
+#define TURN_CID 3000 // first container, each thread has one of its own
+volatile long turn_work;
+volatile long turn_polls; // pcontainer_turn_left() calls of the cooperative threads
+volatile long turn_yields; // switches they made when it returned 0
+int turn_cooperative;
+
+/**
+ * Thread body that computes in container TURN_CID + id until the benchmark
+ * stops. A cooperative thread asks the turn page after every unit of work
+ * and switches only when its quantum is over.
+ */
+void *turn_body(void *x)
+{
+    int id = *((int *)x);
+    double sum = 0;
+    int i;
+
+    pcontainer_create(devfd, TURN_CID + id);
+    while (!stop)
+    {
+        for (i = 0; i < 1000; i++)
+            sum += 1.0 / (1.2 + i);
+        __sync_fetch_and_add(&turn_work, 1);
+        if (!turn_cooperative)
+            continue;
+        __sync_fetch_and_add(&turn_polls, 1);
+        if (pcontainer_turn_left() == 0)
+        {
+            pcontainer_context_switch_handler(devfd, 0);
+            __sync_fetch_and_add(&turn_yields, 1);
+        }
+    }
+    pcontainer_delete(devfd, TURN_CID + id);
+    return NULL;
+}
+
+/**
+ * Run num_of_threads threads for duration_s seconds, switched by the SIGPROF
+ * alarm of pcontainer_init() or cooperatively under the kernel tick, and
+ * print the system calls per second the turn page saved.
+ */
+void turn_run(int num_of_threads, int cooperative)
+{
+    pthread_t *threads = (pthread_t *) calloc(num_of_threads, sizeof(pthread_t));
+    int *ids = (int *) calloc(num_of_threads, sizeof(int));
+    unsigned long long signals0, skipped0, signals, skipped;
+    long long start, elapsed;
+    double seconds;
+    long ioctls, saved;
+    int i;
+
+    stop = 0;
+    turn_work = turn_polls = turn_yields = 0;
+    turn_cooperative = cooperative;
+    if (cooperative)
+        pcontainer_init_kernel_tick(devfd, quantum_us);
+    else
+        pcontainer_init(devfd);
+    pcontainer_switch_counts(&signals0, &skipped0);
+    start = now_ns();
+    for (i = 0; i < num_of_threads; i++)
+    {
+        ids[i] = i;
+        pthread_create(&threads[i], NULL, turn_body, &ids[i]);
+    }
+    sleep(duration_s);
+    stop = 1;
+    for (i = 0; i < num_of_threads; i++)
+        pthread_join(threads[i], NULL);
+    elapsed = now_ns() - start;
+    pcontainer_switch_counts(&signals, &skipped);
+    pcontainer_init_kernel_tick(devfd, 0);
+
+    seconds = elapsed / 1e9;
+    signals -= signals0;
+    skipped -= skipped0;
+    if (cooperative)
+    {
+        ioctls = turn_yields;
+        saved = turn_polls - turn_yields;
+    }
+    else
+    {
+        ioctls = signals - skipped;
+        saved = skipped;
+    }
+    printf("%s,%d,%.0f,%.0f,%.0f,%.0f\n", cooperative ? "cooperative" : "signal", num_of_threads,
+           signals / seconds, ioctls / seconds, saved / seconds, turn_work / seconds);
+    fflush(stdout);
+    free(ids);
+    free(threads);
+}
+
+/**
+ * Run one thread per container, first switched by SIGPROF and then
+ * cooperatively, and compare the switch system calls made and saved.
+ */
+int turn_benchmark(int num_of_threads)
+{
+    struct pcontainer_turn_page *page = pcontainer_turn_map(devfd);
+
+    if (page == NULL)
+        fprintf(stderr, "Turn page mmap failed, every switch is a system call\n");
+    else
+        pcontainer_turn_unmap(page);
+    printf("mode,threads,signals_per_sec,ioctls_per_sec,saved_per_sec,work_per_sec\n");
+    turn_run(num_of_threads, 0);
+    turn_run(num_of_threads, 1);
+    return 0;
+}
+
+// state shared by the blocking benchmark (-m iomix)
+#define IOMIX_CID 3500 // container of all the threads
+#define IOMIX_SLEEP_US 200 // how long an I/O thread blocks per request
+#define HANDOFF_PARAM "/sys/module/processor_container/parameters/handoff"
+volatile long iomix_work;
+volatile long iomix_requests;
+
+/**
+ * Thread body in container IOMIX_CID until the benchmark stops. An I/O thread
+ * blocks for IOMIX_SLEEP_US after every short unit of work, like a thread
+ * waiting for its next request; the others only compute.
+ */
+void *iomix_body(void *x)
+{
+    int io = *((int *)x);
+    struct timespec pause = { 0, IOMIX_SLEEP_US * 1000L };
+    double sum = 0;
+    int i;
+
+    pcontainer_create(devfd, IOMIX_CID);
+    while (!stop)
+    {
+        for (i = 0; i < 1000; i++)
+            sum += 1.0 / (1.2 + i);
+        if (!io)
+        {
+            __sync_fetch_and_add(&iomix_work, 1);
+            continue;
+        }
+        nanosleep(&pause, NULL);
+        __sync_fetch_and_add(&iomix_requests, 1);
+    }
+    pcontainer_delete(devfd, IOMIX_CID);
+    return NULL;
+}
+
+/**
+ * Run num_of_threads computing threads and as many I/O threads in one
+ * container for duration_s seconds and print the work and requests per
+ * second. handoff is the setting of the module, -1 if unknown, and baseline
+ * the work per second without I/O threads, 0 to measure it.
+ */
+double iomix_run(int num_of_threads, int handoff, double baseline)
+{
+    int total_threads = baseline != 0 ? 2 * num_of_threads : num_of_threads;
+    pthread_t *threads = (pthread_t *) calloc(total_threads, sizeof(pthread_t));
+    int *io = (int *) calloc(total_threads, sizeof(int));
+    double seconds, work;
+    long long start;
+    int i;
+
+    stop = 0;
+    iomix_work = iomix_requests = 0;
+    start = now_ns();
+    for (i = 0; i < total_threads; i++)
+    {
+        io[i] = i >= num_of_threads;
+        pthread_create(&threads[i], NULL, iomix_body, &io[i]);
+    }
+    sleep(duration_s);
+    stop = 1;
+    for (i = 0; i < total_threads; i++)
+        pthread_join(threads[i], NULL);
+    seconds = (now_ns() - start) / 1e9;
+    work = iomix_work / seconds;
+
+    if (baseline == 0)
+        printf("cpu_only");
+    else if (handoff < 0)
+        printf("unknown");
+    else
+        printf("%s", handoff ? "on" : "off");
+    printf(",%d,%.0f,%.0f,%.3f\n", num_of_threads, work, iomix_requests / seconds,
+           baseline != 0 ? work / baseline : 1.0);
+    fflush(stdout);
+    free(io);
+    free(threads);
+    return work;
+}
+
+/**
+ * Set the handoff parameter of the module, returns -1 if it cannot be written.
+ */
+static int set_handoff(int on)
+{
+    FILE *param = fopen(HANDOFF_PARAM, "w");
+
+    if (param == NULL)
+        return -1;
+    fprintf(param, "%c\n", on ? 'Y' : 'N');
+    return fclose(param) == 0 ? 0 : -1;
+}
+
+/**
+ * Measure the work of num_of_threads computing threads alone, then next to
+ * as many threads that block in every turn, with the handoff of the turns of
+ * blocked threads off and on. The fraction of the work left shows how much
+ * of the share of the container the handoff recovers.
+ */
+int iomix_benchmark(int num_of_threads)
+{
+    FILE *param;
+    double baseline;
+    int handoff = -1;
+
+    pcontainer_init_kernel_tick(devfd, quantum_us);
+    printf("handoff,threads,work_per_sec,requests_per_sec,work_fraction\n");
+    baseline = iomix_run(num_of_threads, -1, 0);
+    if (set_handoff(0) == 0)
+    {
+        iomix_run(num_of_threads, 0, baseline);
+        set_handoff(1);
+        iomix_run(num_of_threads, 1, baseline);
+    }
+    else
+    {
+        fprintf(stderr, "Cannot write %s, measuring the current setting only\n", HANDOFF_PARAM);
+        param = fopen(HANDOFF_PARAM, "r");
+        if (param != NULL)
+        {
+            handoff = fgetc(param) == 'Y';
+            fclose(param);
+        }
+        iomix_run(num_of_threads, handoff, baseline);
+    }
+    pcontainer_init_kernel_tick(devfd, 0);
+    return 0;
+}
+
+// state shared by the nested share benchmark (-m nested)
+#define NESTED_CID 4000 // first leaf container
+#define NESTED_POOLS 4 // pool p is group nested_gid[p] in tenant p / 2
+static const int nested_gid[NESTED_POOLS] = { 11, 12, 21, 22 };
+static const int nested_pool_shares[NESTED_POOLS] = { 1024, 3072, 1024, 3072 };
+static const int nested_tenant_shares[2] = { 1024, 2048 };
+volatile long nested_work[NESTED_POOLS];
+
+/**
+ * Thread body that owns leaf container NESTED_CID + id in pool id % NESTED_POOLS
+ * and counts the work of the pool until the benchmark stops.
+ */
+void *nested_body(void *x)
+{
+    int id = *((int *)x);
+    int pool = id % NESTED_POOLS;
+    double sum = 0;
+    int i;
+
+    if (pcontainer_create_child(devfd, NESTED_CID + id, nested_gid[pool]) != 0)
+        return NULL;
+    // compete on the run queue of cpu 0, every cpu has its own slots
+    pcontainer_set_affinity(devfd, NESTED_CID + id, 1);
+    while (!stop)
+    {
+        for (i = 0; i < 10000; i++)
+            sum += 1.0 / (1.2 + i);
+        __sync_fetch_and_add(&nested_work[pool], 10000);
+    }
+    pcontainer_delete(devfd, NESTED_CID + id);
+    return NULL;
+}
+
+/**
+ * Run num_of_leaves CPU-bound leaf containers spread over the pools for
+ * duration_s seconds and print the share of the work each pool got next to
+ * its share of the tree. Returns the largest error.
+ */
+double nested_run(int num_of_leaves)
+{
+    pthread_t *threads = (pthread_t *) calloc(num_of_leaves, sizeof(pthread_t));
+    int *ids = (int *) calloc(num_of_leaves, sizeof(int));
+    long start[NESTED_POOLS], work[NESTED_POOLS], total_work = 0;
+    double expected, achieved, max_error = 0;
+    pthread_attr_t attr;
+    int tenant, p, i;
+
+    // thousands of threads that only compute need little stack
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, 64 * 1024);
+    stop = 0;
+    for (i = 0; i < num_of_leaves; i++)
+    {
+        ids[i] = i;
+        pthread_create(&threads[i], &attr, nested_body, &ids[i]);
+    }
+    for (p = 0; p < NESTED_POOLS; p++)
+        start[p] = nested_work[p];
+    sleep(duration_s);
+    // snapshot before the threads that are still parked get their last turn
+    for (p = 0; p < NESTED_POOLS; p++)
+    {
+        work[p] = nested_work[p] - start[p];
+        total_work += work[p];
+    }
+    stop = 1;
+    for (i = 0; i < num_of_leaves; i++)
+        pthread_join(threads[i], NULL);
+    pthread_attr_destroy(&attr);
+
+    for (p = 0; p < NESTED_POOLS; p++)
+    {
+        tenant = p / 2;
+        expected = (double)nested_tenant_shares[tenant] / (nested_tenant_shares[0] + nested_tenant_shares[1]) *
+                   nested_pool_shares[p] / (nested_pool_shares[2 * tenant] + nested_pool_shares[2 * tenant + 1]);
+        achieved = total_work ? (double)work[p] / total_work : 0;
+        printf("%d,%d,%d,%.4f,%.4f,%.4f\n", num_of_leaves, nested_gid[p], num_of_leaves / NESTED_POOLS + (p < num_of_leaves % NESTED_POOLS),
+               expected, achieved, achieved - expected);
+        if (fabs(achieved - expected) > max_error)
+            max_error = fabs(achieved - expected);
+    }
+    fflush(stdout);
+    free(ids);
+    free(threads);
+    return max_error;
+}
+
+/**
+ * Build two tenants with shares 1:2, each with two pools with shares 1:3, and
+ * check that the pools get 1/12, 3/12, 2/12 and 6/12 of cpu 0 however many
+ * leaf containers they hold, for NESTED_POOLS, 10 times as many, ... up to
+ * max_leaves.
+ */
+int nested_benchmark(int max_leaves)
+{
+    int tenant, p, n;
+
+    for (tenant = 0; tenant < 2; tenant++)
+    {
+        if (pcontainer_set_group(devfd, tenant + 1, 0, nested_tenant_shares[tenant]) != 0)
+        {
+            perror("Nested containers are not available");
+            return 1;
+        }
+    }
+    for (p = 0; p < NESTED_POOLS; p++)
+        pcontainer_set_group(devfd, nested_gid[p], p / 2 + 1, nested_pool_shares[p]);
+    pcontainer_init_kernel_tick(devfd, quantum_us);
+    printf("leaves,pool,pool_leaves,expected_ratio,achieved_ratio,error\n");
+    for (n = NESTED_POOLS; n <= max_leaves; n *= 10)
+        fprintf(stderr, "%d leaves: max ratio error %.4f\n", n, nested_run(n));
+    pcontainer_init_kernel_tick(devfd, 0);
+    return 0;
+}
+
+// state shared by the hardware counter benchmark (-m counters)
+#define COUNTERS_CID 4500 // the compute container, COUNTERS_CID + 1 walks the buffer
+#define COUNTERS_BUFFER (64 << 20) // working set of the second container, larger than the LLC
+#define PERF_PARAM "/sys/module/processor_container/parameters/perf"
+volatile char *counters_buffer;
+
+/**
+ * Set the perf parameter of the module, returns -1 if it cannot be written.
+ */
+static int set_perf(int on)
+{
+    FILE *param = fopen(PERF_PARAM, "w");
+
+    if (param == NULL)
+        return -1;
+    fprintf(param, "%c\n", on ? 'Y' : 'N');
+    return fclose(param) == 0 ? 0 : -1;
+}
+
+/**
+ * Thread body of container cid until the benchmark stops. COUNTERS_CID
+ * computes in registers, the other one misses the cache on every line.
+ */
+void *counters_body(void *x)
+{
+    int cid = *((int *)x);
+    double sum = 0;
+    int i;
+
+    pcontainer_create(devfd, cid);
+    pcontainer_set_affinity(devfd, cid, 1);
+    while (!stop)
+    {
+        if (cid == COUNTERS_CID)
+        {
+            for (i = 0; i < 100000; i++)
+                sum += 1.0 / (1.2 + i);
+        }
+        else
+        {
+            for (i = 0; i < COUNTERS_BUFFER; i += 64)
+                counters_buffer[(i * 7919L) % COUNTERS_BUFFER]++;
+        }
+    }
+    pcontainer_delete(devfd, cid);
+    return NULL;
+}
+
+/**
+ * Print the hardware events the module charged to the containers of
+ * counters_body() as CSV, with the IPC and misses per 1000 instructions.
+ */
+static void counters_print(struct pcontainer_stats_page *page)
+{
+    struct pcontainer_stats stats;
+    int cid;
+
+    printf("cid,workload,switches,instructions,cycles,llc_misses,branch_misses,ipc,llc_mpki,branch_mpki,perf_ns_per_switch\n");
+    for (cid = COUNTERS_CID; cid <= COUNTERS_CID + 1; cid++)
+    {
+        if (!pcontainer_stats_find(page, cid, &stats))
+            continue;
+        printf("%d,%s,%llu,%llu,%llu,%llu,%llu", cid, cid == COUNTERS_CID ? "compute" : "cache_walk",
+               (unsigned long long) stats.switches, (unsigned long long) stats.instructions,
+               (unsigned long long) stats.cycles, (unsigned long long) stats.llc_misses,
+               (unsigned long long) stats.branch_misses);
+        print_rate(stats.instructions, stats.cycles);
+        print_rate(stats.llc_misses * 1000.0, stats.instructions);
+        print_rate(stats.branch_misses * 1000.0, stats.instructions);
+        print_rate(stats.perf_ns, stats.switches);
+        printf("\n");
+    }
+}
+
+/**
+ * Measure what counting the hardware events of every container costs, as
+ * the time of a switch of num_of_pairs pairs with the perf parameter of the
+ * module off and on. Then run a computing container and a container that
+ * walks a buffer larger than the last level cache on CPU 0 for duration_s
+ * seconds and print what the module counted for each.
+ */
+int counters_benchmark(int num_of_pairs)
+{
+    struct pcontainer_stats_page *page = pcontainer_stats_map(devfd);
+    int cid[2] = { COUNTERS_CID, COUNTERS_CID + 1 };
+    pthread_t threads[2];
+    pthread_attr_t attr;
+    double off_ns, on_ns;
+    int i;
+
+    if (page == NULL)
+    {
+        fprintf(stderr, "Stats mmap failed\n");
+        return 1;
+    }
+    if (set_perf(0) != 0)
+    {
+        fprintf(stderr, "Cannot write %s\n", PERF_PARAM);
+        pcontainer_stats_unmap(page);
+        return 1;
+    }
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, 64 * 1024);
+    printf("perf,pairs,ns_per_switch,overhead\n");
+    off_ns = (double)run_pairs(num_of_pairs, 0, &attr) / (2 * switches_per_thread);
+    printf("off,%d,%.1f,0\n", num_of_pairs, off_ns);
+    set_perf(1);
+    on_ns = (double)run_pairs(num_of_pairs, 0, &attr) / (2 * switches_per_thread);
+    printf("on,%d,%.1f,%.3f\n", num_of_pairs, on_ns, on_ns / off_ns - 1);
+    pthread_attr_destroy(&attr);
+
+    counters_buffer = (volatile char *) calloc(COUNTERS_BUFFER, 1);
+    pcontainer_init_kernel_tick(devfd, quantum_us);
+    stop = 0;
+    for (i = 0; i < 2; i++)
+        pthread_create(&threads[i], NULL, counters_body, &cid[i]);
+    sleep(duration_s);
+    // the statistics of a container go away with its last thread
+    counters_print(page);
+    stop = 1;
+    for (i = 0; i < 2; i++)
+        pthread_join(threads[i], NULL);
+    pcontainer_init_kernel_tick(devfd, 0);
+    set_perf(0);
+    free((void *)counters_buffer);
+    pcontainer_stats_unmap(page);
+    return 0;
+}
+
+/**
+ * print usage of the benchmark.
+ */
+void usage(void)
+{
+    fprintf(stderr, "usage: ./benchmark <num_container> [<num_task_in_container> ...]\n");
+    fprintf(stderr, "       ./benchmark -m lookup [-s <switches_per_thread>] <max_num_container>\n");
+    fprintf(stderr, "       ./benchmark -m scale [-s <switches_per_thread>] <max_num_container>\n");
+    fprintf(stderr, "       ./benchmark -m tenants [-s <switches_per_thread>] [-q <quantum_us>] <max_num_container_of_other_process>\n");
+    fprintf(stderr, "       ./benchmark -m width [-q <quantum_us>] <max_width>\n");
+    fprintf(stderr, "       ./benchmark -m lock [-s <locks_per_thread>] [-q <quantum_us>] <max_threads>\n");
+    fprintf(stderr, "       ./benchmark -m ring <num_ops>\n");
+    fprintf(stderr, "       ./benchmark -m churn [-s <creates_per_thread>] <max_threads>\n");
+    fprintf(stderr, "       ./benchmark -m tick [-q <quantum_us>] <num_container> [<num_task_in_container> ...]\n");
+    fprintf(stderr, "       ./benchmark -m shares [-q <quantum_us>] [-d <seconds>] <num_container> [<shares_of_container> ...]\n");
+    fprintf(stderr, "       ./benchmark -m stats [-d <seconds>]\n");
+    fprintf(stderr, "       ./benchmark -m quota [-d <seconds>] <quota_us> <period_us>\n");
+    fprintf(stderr, "       ./benchmark -m latency [-q <quantum_us>] [-d <seconds>] <num_batch_container>\n");
+    fprintf(stderr, "       ./benchmark -m slice [-d <seconds>] <num_batch_container> <min_slice_us> <max_slice_us>\n");
+    fprintf(stderr, "       ./benchmark -m placement [-q <quantum_us>] [-d <seconds>] <num_threads>\n");
+    fprintf(stderr, "       ./benchmark -m balance [-q <quantum_us>] <num_threads>\n");
+    fprintf(stderr, "       ./benchmark -m turn [-q <quantum_us>] [-d <seconds>] <num_threads>\n");
+    fprintf(stderr, "       ./benchmark -m iomix [-q <quantum_us>] [-d <seconds>] <num_threads>\n");
+    fprintf(stderr, "       ./benchmark -m nested [-q <quantum_us>] [-d <seconds>] <max_leaf_containers>\n");
+    fprintf(stderr, "       ./benchmark -m counters [-q <quantum_us>] [-d <seconds>] <num_pairs>\n");
+    fprintf(stderr, "       ./benchmark -m suite [-q <quantum_us>] [-d <seconds>] [-j] <max_num_container> <max_num_task_in_container>\n");
+}
+
+/**
+ * main function to create/run/delete threads in different containers 
+ */
+int main(int argc, char *argv[])
+{
+    int i, num_of_containers, tasks;
+    int total_tasks = 0; 
+    int *tasks_in_containers;
+    int *cid;
+    const char *mode = "fair";
+    int opt;
+
+    while ((opt = getopt(argc, argv, "m:s:q:d:j")) != -1)
+    {
+        switch (opt)
+        {
+        case 'm':
+            mode = optarg;
+            break;
+        case 's':
+            switches_per_thread = atol(optarg);
+            break;
+        case 'q':
+            quantum_us = atoi(optarg);
+            break;
+        case 'd':
+            duration_s = atoi(optarg);
+            break;
+        case 'j':
+            json = 1;
+            break;
+        default:
+            usage();
+            exit(1);
+        }
+    }
+    // shift the options away so that argv[1] is the first positional argument
+    argv += optind - 1;
+    argc -= optind - 1;
+
+    // check num of arguments.
+    if (strcmp(mode, "stats") != 0 && (argc < 2 || (strcmp(mode, "lookup") != 0 && strcmp(mode, "scale") != 0 && strcmp(mode, "tenants") != 0 && strcmp(mode, "width") != 0 && strcmp(mode, "lock") != 0 && strcmp(mode, "ring") != 0 && strcmp(mode, "churn") != 0 && strcmp(mode, "latency") != 0 && strcmp(mode, "placement") != 0 && strcmp(mode, "balance") != 0 && strcmp(mode, "turn") != 0 && strcmp(mode, "iomix") != 0 && strcmp(mode, "nested") != 0 && strcmp(mode, "counters") != 0 && argc < 3)))
+    {
+        fprintf(stderr, "Not enough parameters\n");
+        usage();
+        exit(1);
+    }
+    
+    // open the kernel module
+    devfd = pcontainer_open();
+    if (devfd < 0 && strcmp(mode, "suite") == 0)
+        fprintf(stderr, "Device open failed, running the baseline only\n");
+    else if (devfd < 0)
+    {
+        fprintf(stderr, "Device open failed\n");
+        exit(1);
+    }
+
+    if (strcmp(mode, "stats") == 0)
+        return stats_benchmark();
+    else if (strcmp(mode, "suite") == 0)
+        return suite_benchmark(atoi(argv[1]), atoi(argv[2]));
+    else if (strcmp(mode, "quota") == 0)
+    {
+        quota_us = atoi(argv[1]);
+        period_us = atoi(argv[2]);
+        return quota_benchmark();
+    }
+    else if (strcmp(mode, "lookup") == 0)
+        return lookup_benchmark(atoi(argv[1]));
+    else if (strcmp(mode, "scale") == 0)
+        return scale_benchmark(atoi(argv[1]));
+    else if (strcmp(mode, "tenants") == 0)
+        return tenants_benchmark(atoi(argv[1]));
+    else if (strcmp(mode, "width") == 0)
+        return width_benchmark(atoi(argv[1]));
+    else if (strcmp(mode, "lock") == 0)
+        return lock_benchmark(atoi(argv[1]));
+    else if (strcmp(mode, "ring") == 0)
+        return ring_benchmark(atol(argv[1]));
+    else if (strcmp(mode, "churn") == 0)
+        return churn_benchmark(atoi(argv[1]));
+    else if (strcmp(mode, "latency") == 0)
+        return latency_benchmark(atoi(argv[1]));
+    else if (strcmp(mode, "placement") == 0)
+        return placement_benchmark(atoi(argv[1]));
+    else if (strcmp(mode, "balance") == 0)
+        return balance_benchmark(atoi(argv[1]));
+    else if (strcmp(mode, "turn") == 0)
+        return turn_benchmark(atoi(argv[1]));
+    else if (strcmp(mode, "iomix") == 0)
+        return iomix_benchmark(atoi(argv[1]));
+    else if (strcmp(mode, "nested") == 0)
+        return nested_benchmark(atoi(argv[1]));
+    else if (strcmp(mode, "counters") == 0)
+        return counters_benchmark(atoi(argv[1]));
+    else if (strcmp(mode, "slice") == 0)
+    {
+        if (argc < 4)
+        {
+            fprintf(stderr, "Not enough parameters\n");
+            usage();
+            exit(1);
+        }
+        return slice_benchmark(atoi(argv[1]), atoi(argv[2]), atoi(argv[3]));
+    }
+    else if (strcmp(mode, "fair") != 0 && strcmp(mode, "tick") != 0 && strcmp(mode, "shares") != 0)
+    {
+        fprintf(stderr, "Unknown mode %s\n", mode);
+        usage();
+        exit(1);
+    }
+
+    // parse number of containers
+    num_of_containers = atoi(argv[1]);
+    fprintf(stderr, "num_of_containers: %d\n", num_of_containers);
+
+    // the number of task arguments should be at least equal to num of container
+    if (argc - 2 < num_of_containers)
+    {
+        fprintf(stderr, "Not enough parameters\n");
+        usage();
+        exit(1);
+    }
+    
+    // generate and store number of tasks and cid for each container.
+    tasks_in_containers = (int *) calloc(num_of_containers, sizeof(int));
+    cid = (int *) calloc(num_of_containers, sizeof(int));
+
+    if (strcmp(mode, "shares") == 0)
+    {
+        // the per-container arguments are shares, one thread per container
+        shares = tasks_in_containers;
+        for (i = 0; i < num_of_containers; i++)
+        {
+            shares[i] = atoi(argv[i+2]);
+            cid[i] = i;
+        }
+        shares_benchmark(num_of_containers, cid);
+        free(tasks_in_containers);
+        free(cid);
+        return 0;
+    }
+
+    for (i = 0; i < num_of_containers; i++)
+    {
+        tasks = atoi(argv[i+2]);
+        fprintf(stderr, "task for container %d: %d\n", i, tasks);
+        total_tasks += tasks;
+        tasks_in_containers[i] = tasks;
+        cid[i] = i;
+    }
+    
+    fprintf(stderr, "num_of_total_tasks: %d\n\n", total_tasks);
+
+    if (strcmp(mode, "tick") == 0)
+        tick_benchmark(num_of_containers, tasks_in_containers, cid, total_tasks);
+    else
+    {
+        // alarm initialization
+        pcontainer_init(devfd);
+        run_tasks(num_of_containers, tasks_in_containers, cid, total_tasks);
+    }
+
+    // cleanup
+    free(tasks_in_containers);
     free(cid);
     return 0;
 }
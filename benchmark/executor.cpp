@@ -0,0 +1,136 @@
+#include <pcontainer.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#define EXECUTOR_CID 5000 // container of the executor, EXECUTOR_CID + 1 of the thread per task
+#define THREAD_WAVE 256 // threads of one task each that exist at the same time
+
+static int work_per_task = 10000; // iterations of a task before and after its switch
+static std::atomic<long> finished;
+
+/**
+ * A short task: compute, hand the processor on once, compute again.
+ */
+template <typename Yield>
+static void task_body(Yield yield)
+{
+    volatile double sum = 0;
+    int i;
+
+    for (i = 0; i < work_per_task; i++)
+        sum += 1.0 / (1.2 + i);
+    yield();
+    for (i = 0; i < work_per_task; i++)
+        sum += 1.0 / (1.2 + i);
+    finished++;
+}
+
+static double seconds_since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * Run num_of_tasks tasks as fibers of an executor with num_of_threads threads
+ * and return the tasks per second.
+ */
+static double run_executor(const pcontainer::device &dev, int num_of_tasks, int num_of_threads)
+{
+    auto start = std::chrono::steady_clock::now();
+    pcontainer::executor exec(dev, EXECUTOR_CID, num_of_threads);
+    int i;
+
+    for (i = 0; i < num_of_tasks; i++)
+        exec.spawn([] { task_body(pcontainer::executor::yield); });
+    exec.wait();
+    return num_of_tasks / seconds_since(start);
+}
+
+/**
+ * Run num_of_tasks tasks with a kernel thread each that joins the container
+ * with pcontainer_create() and switches with the switch ioctl, num_of_threads
+ * of them running at the same time, and return the tasks per second.
+ */
+static double run_threads(const pcontainer::device &dev, int num_of_tasks, int num_of_threads)
+{
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    bool widened = false;
+    int i, n;
+
+    finished = 0;
+    for (i = 0; i < num_of_tasks; i += n)
+    {
+        n = std::min(THREAD_WAVE, num_of_tasks - i);
+        for (int t = 0; t < n; t++)
+        {
+            threads.emplace_back([&dev] {
+                pcontainer::membership member(dev, EXECUTOR_CID + 1);
+                task_body([&member] { member.yield(); });
+            });
+        }
+        if (!widened)
+        {
+            // the container exists once the first thread is in it
+            while (pcontainer_set_width(dev.fd(), EXECUTOR_CID + 1, num_of_threads) != 0 && finished == 0)
+                std::this_thread::yield();
+            widened = true;
+        }
+        for (auto &t : threads)
+            t.join();
+        threads.clear();
+    }
+    return num_of_tasks / seconds_since(start);
+}
+
+int main(int argc, char **argv)
+{
+    int num_of_threads = 4;
+    int opt, num_of_tasks;
+    double fibers, kernel_threads;
+
+    while ((opt = getopt(argc, argv, "t:w:")) != -1)
+    {
+        switch (opt)
+        {
+        case 't':
+            num_of_threads = atoi(optarg);
+            break;
+        case 'w':
+            work_per_task = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: ./executor [-t <threads>] [-w <work_per_task>] <num_tasks>\n");
+            return 1;
+        }
+    }
+    if (optind >= argc || (num_of_tasks = atoi(argv[optind])) <= 0 || num_of_threads <= 0)
+    {
+        fprintf(stderr, "usage: ./executor [-t <threads>] [-w <work_per_task>] <num_tasks>\n");
+        return 1;
+    }
+    try
+    {
+        pcontainer::device dev;
+
+        printf("mode,tasks,threads,tasks_per_sec,speedup\n");
+        kernel_threads = run_threads(dev, num_of_tasks, num_of_threads);
+        printf("thread_per_task,%d,%d,%.0f,1.00\n", num_of_tasks, num_of_threads, kernel_threads);
+        fflush(stdout);
+        fibers = run_executor(dev, num_of_tasks, num_of_threads);
+        printf("executor,%d,%d,%.0f,%.2f\n", num_of_tasks, num_of_threads, fibers, fibers / kernel_threads);
+    }
+    catch (const std::system_error &e)
+    {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,48 @@
+#!/bin/bash
+#
+# Summarize the CSV of ./benchmark -m suite and, given the CSV of an earlier
+# module version, flag regressions: 5% less work per second, a fairness index
+# lower by 0.05 or a 20% higher p99 switch latency.
+#
+# usage: ./report.sh <bench.csv> [<previous_bench.csv>]
+
+if [ $# -lt 1 ]; then
+    echo "usage: $0 <bench.csv> [<previous_bench.csv>]" >&2
+    exit 1
+fi
+
+awk -F, '
+FNR == 1 { file++; next }
+{
+    key = $1 "," $2 "," $3 "," $4;
+    if (file == 1) {
+        keys[++n] = key;
+        work[key] = $5; fair[key] = $6; p50[key] = $7; p99[key] = $8; p999[key] = $9; over[key] = $10;
+    } else {
+        old_work[key] = $5; old_fair[key] = $6; old_p99[key] = $8;
+    }
+}
+END {
+    printf("%-6s %-8s %10s %5s %14s %8s %9s %9s %9s %8s  %s\n", "prof", "mode", "containers", "tasks",
+           "work/s", "fairness", "p50_us", "p99_us", "p999_us", "overhead", "vs previous");
+    for (i = 1; i <= n; i++) {
+        key = keys[i];
+        split(key, k, ",");
+        note = "";
+        if (key in old_work) {
+            note = sprintf("work %+.1f%%", old_work[key] > 0 ? 100 * (work[key] / old_work[key] - 1) : 0);
+            if (work[key] < 0.95 * old_work[key] || fair[key] < old_fair[key] - 0.05 ||
+                (old_p99[key] > 0 && p99[key] > 1.2 * old_p99[key])) {
+                note = note " REGRESSION";
+                regressions++;
+            }
+        }
+        printf("%-6s %-8s %10d %5d %14.0f %8.4f %9.1f %9.1f %9.1f %8.4f  %s\n", k[1], k[2], k[3], k[4],
+               work[key], fair[key], p50[key], p99[key], p999[key], over[key], note);
+    }
+    if (regressions) {
+        printf("%d regressions\n", regressions);
+        exit 1;
+    }
+}
+' "$@"
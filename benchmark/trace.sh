@@ -0,0 +1,92 @@
+#!/bin/bash
+#
+# Record the pcontainer tracepoints during one run of the benchmark and turn
+# them into per-container timelines and switch latency histograms.
+#
+# usage: ./benchmark/trace.sh <out_dir> <benchmark arguments ...>
+#   <out_dir>/trace.txt     raw ftrace output
+#   <out_dir>/timeline.csv  cid,pid,cpu,start_s,end_s of every turn of a thread
+#   <out_dir>/latency.txt   per container histogram of the time threads waited
+#                           for their turn, in power of 2 microsecond buckets
+
+if [ $# -lt 2 ]; then
+    echo "usage: $0 <out_dir> <benchmark arguments ...>" >&2
+    exit 1
+fi
+out=$1
+shift
+mkdir -p "$out"
+
+tracing=/sys/kernel/tracing
+[ -d $tracing/events ] || tracing=/sys/kernel/debug/tracing
+
+sudo insmod kernel_module/processor_container.ko
+sudo chmod 777 /dev/pcontainer
+echo 0 | sudo tee $tracing/tracing_on > /dev/null
+echo | sudo tee $tracing/trace > /dev/null
+echo 16384 | sudo tee $tracing/buffer_size_kb > /dev/null
+echo 1 | sudo tee $tracing/events/pcontainer/enable > /dev/null
+echo 1 | sudo tee $tracing/tracing_on > /dev/null
+./benchmark/benchmark "$@"
+echo 0 | sudo tee $tracing/tracing_on > /dev/null
+echo 0 | sudo tee $tracing/events/pcontainer/enable > /dev/null
+sudo cat $tracing/trace > "$out/trace.txt"
+sudo rmmod processor_container
+
+# a turn starts when a thread switches in and ends when it switches out or leaves
+awk '
+function field(name,    i) {
+    for (i = 1; i <= NF; i++)
+        if (index($i, name "=") == 1)
+            return substr($i, length(name) + 2);
+    return "";
+}
+{
+    for (e = 1; e <= NF && $e !~ /^pcontainer_/; e++)
+        ;
+    if (e > NF)
+        next;
+    event = $e;
+    sub(/:$/, "", event);
+    ts = $(e - 1);
+    sub(/:$/, "", ts);
+    pid = field("pid");
+    if (event == "pcontainer_switch_in") {
+        start[pid] = ts;
+        cid[pid] = field("cid");
+        cpu[pid] = field("cpu");
+    } else if ((event == "pcontainer_switch_out" || event == "pcontainer_delete") && pid in start) {
+        print cid[pid] "," pid "," cpu[pid] "," start[pid] "," ts;
+        delete start[pid];
+    }
+}
+BEGIN { print "cid,pid,cpu,start_s,end_s" }
+' "$out/trace.txt" > "$out/timeline.csv"
+
+awk '
+function field(name,    i) {
+    for (i = 1; i <= NF; i++)
+        if (index($i, name "=") == 1)
+            return substr($i, length(name) + 2);
+    return "";
+}
+/pcontainer_switch_in:/ {
+    c = field("cid");
+    us = field("wait_ns") / 1000;
+    for (b = 1; b < us; b *= 2)
+        ;
+    count[c, b]++;
+    cids[c] = 1;
+    if (b > max[c])
+        max[c] = b;
+}
+END {
+    for (c in cids) {
+        print "cid " c ": wait for the turn (us)";
+        for (b = 1; b <= max[c]; b *= 2)
+            printf("  <= %8d %10d\n", b, count[c, b]);
+    }
+}
+' "$out/trace.txt" > "$out/latency.txt"
+
+cat "$out/latency.txt"
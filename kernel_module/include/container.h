@@ -0,0 +1,399 @@
+//////////////////////////////////////////////////////////////////////
+//                      North Carolina State University
+//
+//
+//
+//                             Copyright 2016
+//
+////////////////////////////////////////////////////////////////////////
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms and conditions of the GNU General Public License,
+// version 2, as published by the Free Software Foundation.
+//
+// This program is distributed in the hope it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+//
+////////////////////////////////////////////////////////////////////////
+//
+//   Author:  Hung-Wei Tseng, Yu-Chia Liu
+//
+//   Description:
+//     Internal data structures of Processor Container shared by the
+//     kernel module sources (not installed for user space)
+//
+////////////////////////////////////////////////////////////////////////
+
+#ifndef CONTAINER_H
+#define CONTAINER_H
+
+#include <linux/types.h>
+#include <linux/list.h>
+#include <linux/rculist.h>
+#include <linux/hash.h>
+#include <linux/spinlock.h>
+#include <linux/sched.h>
+#include <linux/hrtimer.h>
+#include <linux/rbtree.h>
+#include <linux/task_work.h>
+#include <linux/cpumask.h>
+#include <linux/percpu.h>
+#include <linux/mutex.h>
+#include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/refcount.h>
+#include <linux/uidgid.h>
+#include <linux/preempt.h>
+#include <linux/irq_work.h>
+#include <linux/llist.h>
+
+#include "processor_container.h"
+
+// number of buckets (as a power of 2) of the task table
+#define PCONTAINER_HASH_BITS 12
+// number of buckets (as a power of 2) of the container table of a namespace
+#define PCONTAINER_NS_HASH_BITS 8
+// number of buckets (as a power of 2) of the groups of a namespace
+#define PCONTAINER_GROUP_HASH_BITS 6
+// hardware events counted for every thread, in the order of their statistics
+#define PCONTAINER_PERF_INSTRUCTIONS 0
+#define PCONTAINER_PERF_CYCLES 1
+#define PCONTAINER_PERF_LLC_MISSES 2
+#define PCONTAINER_PERF_BRANCH_MISSES 3
+#define PCONTAINER_PERF_EVENTS 4
+
+struct pcontainer_group;
+struct pcontainer_perf;
+struct pcontainer_group_rq;
+struct pcontainer_stats_area;
+
+struct pcontainer_timeline // entities waiting for a slot ordered by virtual time
+{
+    struct rb_root root;
+    struct rb_node* leftmost; // waiting entity with the smallest virtual time
+    unsigned int nr_queued; // entities in root
+    u64 min_vruntime; // virtual time of the last entity picked, new entities start there
+};
+
+struct pcontainer_entity // a container, or a group on one run queue, in a timeline
+{
+    u64 vruntime; // runtime scaled by PCONTAINER_DEFAULT_SHARES / shares
+    unsigned int sched_class; // PCONTAINER_CLASS_*, groups are batch
+    unsigned int depth; // groups above it
+    struct rb_node run_node; // entry in the timeline of parent, or of the run queue at the top
+    struct pcontainer_group_rq* parent; // group on the same run queue, NULL at the top
+    struct pcontainer_group_rq* group; // the group the entity stands for, NULL for a container
+};
+
+struct container_list // datastructure to maintain list of containers
+{
+    __u64 cid;
+    spinlock_t lock; // protects the run queue, nr_threads, width and dead
+    struct list_head threads; // run queue in rotation order, the active threads are at the head
+    unsigned int nr_threads; // number of threads on the run queue
+    struct list_head blocked; // threads that went to sleep during their turn, off the run queue
+    unsigned int nr_blocked;
+    unsigned int width; // threads at the head of the run queue that run at the same time
+    unsigned int nr_boosted; // threads that own a contended lock, the run queue does not rotate
+    u64 boost_start; // when nr_boosted became non-zero, the slot is only kept for a while after it
+    bool dead; // last thread left, the container is being unhashed
+    struct hrtimer tick; // kernel driven quantum, armed while there is something to switch to
+    u64 slice_ns; // quantum of the container, 0 to use the one of its namespace
+    u64 slice_min_ns; // bounds of slice_ns, it adapts to the threads while they differ
+    u64 slice_max_ns;
+    unsigned int shares; // weight of the container against the other containers
+    struct pcontainer_entity se; // changed under rq->lock and lock
+    u64 exec_start; // when the runtime was last charged to se.vruntime
+    struct pcontainer_group* group; // parent in the tree of its namespace, NULL at the top
+    u64 group_delta; // runtime not charged to the groups above yet
+    bool running; // holds a slot so the active threads may run, changed under rq->lock and lock
+    struct pcontainer_rq* rq; // home run queue, changed under its lock and lock
+    struct list_head run_entry; // entry in rq->running while holding a slot
+    struct pcontainer_stats* stats; // slot in the statistics, NULL if none was free
+    u64 quota_ns; // cpu time the container may use each period, 0 for no limit
+    u64 period_ns;
+    u64 quota_used; // cpu time used in the current period
+    u64 runtime_pending; // cpu time of threads that stopped being active, not charged yet
+    bool throttled; // used up its quota, stays off its run queue until the refill
+    u64 throttle_start; // when it was throttled
+    struct hrtimer period; // refills the quota, armed while there is a quota
+    cpumask_t allowed; // cpus of the home run queue and of the threads
+    unsigned int placement; // PCONTAINER_PLACE_*, how the threads stay in home
+    cpumask_t home; // allowed cpus sharing the cache and NUMA node of the home run queue
+    unsigned int affinity_seq; // bumped when the cpus the threads should use change
+    struct pcontainer_namespace* nspace; // holds a reference while the container lives
+    struct hlist_node hnode; // entry in the table of nspace, keyed by cid
+    struct rcu_head rcu;
+};
+
+struct thread_list // datastructure to maintain list of threads
+{
+    struct task_struct* thread;
+    struct container_list* container; // container the thread belongs to
+    struct list_head entry; // entry in the run queue of the container
+    bool active; // among the first width threads of the run queue
+    unsigned int affinity_seq; // the cpus of the container were applied to the thread at this seq
+    bool lock_boost; // owns a lock others wait for, not rotated out until it unlocks
+    bool evict; // another thread took it out of the container, it leaves on its next wait
+    u64 wake_ns; // when it was last woken for its turn
+    unsigned long nvcsw; // voluntary context switches of the thread when its quantum started
+    u64 runtime_seen; // se.sum_exec_runtime of the thread when its cpu time was last charged
+    struct hlist_node hnode; // entry in task_table, keyed by task
+    struct callback_head park_work; // parks the thread on its way back to user space
+    bool park_pending; // park_work is queued on the thread, under the container lock
+    bool orphan; // the thread left while park_work was queued, park_work frees the node; set under the container lock
+#ifdef PCONTAINER_HAVE_PREEMPT_NOTIFIERS
+    struct preempt_notifier notifier; // tells when the thread goes to sleep and runs again
+    struct irq_work block_work; // hands the turn on once the scheduler dropped its locks
+#endif
+    bool notify; // notifier is registered, only the thread itself may take it out
+    bool blocked; // on the blocked list of the container, changed under its lock
+    bool sleeping; // went to sleep during its turn and did not run since
+    struct pcontainer_perf* perf; // hardware counters of the thread, NULL until its first charge
+    struct rcu_head rcu;
+};
+
+struct pcontainer_bucket // hash bucket, lookups walk the chain under RCU, updates take lock
+{
+    spinlock_t lock;
+    struct hlist_head chain;
+};
+
+struct pcontainer_group_rq // the part of a group on one run queue, under rq->lock
+{
+    struct pcontainer_entity se; // waits in its parent timeline while a container below waits
+    struct pcontainer_timeline timeline; // waiting children on the run queue
+    struct pcontainer_group* tg;
+};
+
+struct pcontainer_group // inner node of the container tree of a namespace
+{
+    __u64 gid;
+    unsigned int shares; // weight against its siblings, split among its children
+    unsigned int depth; // groups above it
+    struct pcontainer_group* parent; // NULL at the top
+    struct pcontainer_group_rq __percpu* rqs;
+    struct hlist_node hnode; // entry in the groups of the namespace, keyed by gid
+};
+
+struct pcontainer_namespace // cids of one open file, or of the files that share a key
+{
+    refcount_t ref; // held by the open files using it and by its containers
+    u64 id; // unique, published with the statistics of its containers
+    u64 key; // 0 for the namespace of a single file
+    kuid_t owner; // user whose open files may share it
+    struct list_head entry; // in the list of namespaces, under namespace_lock
+    struct llist_node free_node; // queued to be freed where sleeping is allowed
+    struct pid_namespace* pid_ns; // of the creator, the turns publish tids as its processes see them
+    struct pcontainer_stats_area* stats; // NULL until a container or a mapping needs it
+    u64 tick_ns; // kernel driven quantum of its containers, 0 while user space drives the switches
+    struct pcontainer_bucket table[1 << PCONTAINER_NS_HASH_BITS]; // containers keyed by cid
+    struct mutex group_lock; // protects groups, they live as long as the namespace
+    struct hlist_head groups[1 << PCONTAINER_GROUP_HASH_BITS]; // keyed by gid
+    unsigned int nr_groups; // under group_lock, at most PCONTAINER_MAX_GROUPS
+};
+
+// shortest kernel driven quantum accepted by PCONTAINER_IOCTL_TICK
+#define PCONTAINER_MIN_TICK_NS 1000
+
+struct pcontainer_rq // containers of a cpu competing for the slots in which their active threads may run
+{
+    spinlock_t lock; // taken before the lock of any container on the run queue
+    int cpu;
+    struct pcontainer_timeline timeline; // containers and groups at the top of the tree
+    struct list_head running; // containers holding a slot
+    unsigned int nr_running;
+    unsigned int nr_queued; // containers waiting for a slot, at any depth
+    unsigned int nr_slots;
+};
+
+struct pcontainer_file // state of an open /dev/pcontainer, filp->private_data
+{
+    struct mutex ring_lock; // serializes setting up and draining the ring
+    struct pcontainer_ring* ring; // shared with user space, NULL until mmap()
+    u32 sq_head; // private copies, user space may scribble over the shared ones
+    u32 cq_tail;
+    struct pid* tgid; // process that mapped the ring, the tids of entries are its threads
+    struct pid_namespace* ns;
+    struct mutex sqpoll_lock; // serializes starting and stopping sqpoll
+    struct task_struct* sqpoll; // drains the ring while user space only fills it
+    unsigned int sq_idle_us;
+    struct pcontainer_namespace* nspace; // set once, by the first command that needs it
+};
+
+extern struct pcontainer_bucket task_table[1 << PCONTAINER_HASH_BITS];
+DECLARE_PER_CPU(struct pcontainer_rq, pcontainer_rqs);
+
+// alloc.c
+int alloc_init(void);
+void alloc_exit(void);
+struct container_list* container_node_alloc(void);
+void container_node_free(struct container_list* c);
+void container_node_free_rcu(struct container_list* c);
+struct thread_list* thread_node_alloc(void);
+void thread_node_free(struct thread_list* t);
+void thread_node_free_rcu(struct thread_list* t);
+int processor_container_prealloc(struct processor_container_cmd __user *user_cmd);
+
+// block.c
+void block_init(void);
+void block_exit(void);
+void container_block_init(struct thread_list* t);
+void container_block_watch(struct thread_list* t);
+void container_block_unwatch(struct thread_list* t);
+
+// exit.c
+void exit_init(void);
+void exit_exit(void);
+bool exit_hooked(void);
+
+// group.c
+void group_free_all(struct pcontainer_namespace* ns);
+int container_set_group(struct pcontainer_namespace* ns, __u64 gid, __u64 parent, __u64 shares);
+int processor_container_group(struct pcontainer_namespace* ns, struct processor_container_cmd __user *user_cmd);
+int processor_container_create_child(struct pcontainer_namespace* ns, struct processor_container_cmd __user *user_cmd);
+
+// ioctl.c
+void container_wait_turn(struct container_list* c, struct thread_list* t);
+void container_leave(void);
+void container_reap(struct task_struct* task);
+int container_create(struct pcontainer_namespace* ns, __u64 cid, struct pcontainer_group* group);
+int container_enroll(struct pcontainer_namespace* ns, struct task_struct* task, __u64 cid);
+int container_evict(struct task_struct* task);
+int container_switch_cid(struct pcontainer_namespace* ns, __u64 cid);
+
+// lock.c
+void lock_init(void);
+long processor_container_lock(struct processor_container_cmd __user *user_cmd);
+long processor_container_unlock(struct processor_container_cmd __user *user_cmd);
+
+// namespace.c
+struct pcontainer_namespace* file_namespace(struct pcontainer_file* f);
+void namespace_put(struct pcontainer_namespace* ns);
+void namespace_for_each_container(struct pcontainer_namespace* ns, void (*fn)(struct container_list* c));
+void namespace_for_each(void (*fn)(struct pcontainer_namespace* ns, void* data), void* data);
+void namespace_exit(void);
+void namespace_reap(struct pcontainer_namespace* ns);
+int processor_container_namespace(struct file* filp, struct processor_container_cmd __user *user_cmd);
+
+// perf.c
+void container_perf_init(struct thread_list* t);
+void container_perf_charge(struct thread_list* t);
+void container_perf_release(struct thread_list* t);
+void perf_exit(void);
+
+// place.c
+void container_set_home(struct container_list* c);
+void container_place_thread(struct container_list* c, struct thread_list* t, bool waited);
+int container_set_placement(struct pcontainer_namespace* ns, __u64 cid, __u64 placement);
+int processor_container_placement(struct pcontainer_namespace* ns, struct processor_container_cmd __user *user_cmd);
+
+// ring.c
+int processor_container_open(struct inode* inode, struct file* filp);
+int processor_container_release(struct inode* inode, struct file* filp);
+int processor_container_mmap(struct file* filp, struct vm_area_struct* vma);
+int processor_container_enter(struct file* filp, struct processor_container_cmd __user *user_cmd);
+int processor_container_sqpoll(struct file* filp, struct processor_container_cmd __user *user_cmd);
+
+// sched.c
+void sched_init(void);
+void timeline_init(struct pcontainer_timeline* tl);
+void sched_container_enter(struct container_list* c);
+void sched_container_exit(struct container_list* c);
+struct pcontainer_rq* sched_select_rq(struct container_list* c);
+void sched_tick(struct container_list* c);
+void container_park_active(struct container_list* c);
+void container_refill(struct container_list* c);
+void container_runtime_stop(struct container_list* c, struct thread_list* t);
+void container_yield(struct container_list* c, struct thread_list* t);
+void container_rotate(struct container_list* c);
+int container_set_shares(struct pcontainer_namespace* ns, __u64 cid, __u64 shares);
+int container_set_affinity(struct pcontainer_namespace* ns, __u64 cid, __u64 cpus);
+int container_set_width(struct pcontainer_namespace* ns, __u64 cid, __u64 width);
+int processor_container_shares(struct pcontainer_namespace* ns, struct processor_container_cmd __user *user_cmd);
+int processor_container_affinity(struct pcontainer_namespace* ns, struct processor_container_cmd __user *user_cmd);
+int processor_container_width(struct pcontainer_namespace* ns, struct processor_container_cmd __user *user_cmd);
+void sched_quota_init(struct container_list* c);
+int container_set_quota(struct pcontainer_namespace* ns, __u64 cid, __u64 quota);
+int processor_container_quota(struct pcontainer_namespace* ns, struct processor_container_cmd __user *user_cmd);
+int container_set_class(struct pcontainer_namespace* ns, __u64 cid, __u64 sched_class);
+int processor_container_class(struct pcontainer_namespace* ns, struct processor_container_cmd __user *user_cmd);
+
+// stats.c
+int stats_init(void);
+void stats_exit(void);
+int stats_mmap(struct pcontainer_namespace* ns, struct vm_area_struct* vma);
+void stats_free(struct pcontainer_namespace* ns);
+void stats_attach(struct container_list* c);
+void stats_detach(struct container_list* c);
+void stats_charge(struct container_list* c, u64 delta);
+void stats_switch(struct container_list* c);
+void stats_threads(struct container_list* c);
+void stats_reap(struct container_list* c);
+void stats_block(struct container_list* c);
+void stats_wait(struct container_list* c, struct thread_list* t, u64 start);
+void stats_throttle(struct container_list* c, u64 throttled_ns);
+void stats_slice(struct container_list* c);
+void stats_deadline(struct container_list* c);
+void stats_perf(struct container_list* c, u64* delta, u64 cost_ns);
+
+// tick.c
+void container_tick_init(struct container_list* c);
+bool container_needs_tick(struct container_list* c);
+u64 container_tick_deadline(struct container_list* c);
+void container_tick_start(struct container_list* c);
+void container_park_init(struct thread_list* t);
+void container_park(struct thread_list* t);
+void container_park_kick(struct thread_list* t);
+int processor_container_tick(struct pcontainer_namespace* ns, struct processor_container_cmd __user *user_cmd);
+int container_set_slice(struct pcontainer_namespace* ns, __u64 cid, __u64 slice);
+int processor_container_slice(struct pcontainer_namespace* ns, struct processor_container_cmd __user *user_cmd);
+
+static inline struct pcontainer_bucket* container_bucket(struct pcontainer_namespace* ns, __u64 cid)
+{
+    return &ns->table[hash_64(cid, PCONTAINER_NS_HASH_BITS)];
+}
+
+static inline struct pcontainer_bucket* task_bucket(struct task_struct* task)
+{
+    return &task_table[hash_ptr(task, PCONTAINER_HASH_BITS)];
+}
+
+/**
+ * Find the container with the given cid in namespace ns, NULL if it does not
+ * exist. Caller must be in an RCU read-side critical section or hold the
+ * bucket lock.
+ */
+static inline struct container_list* container_lookup(struct pcontainer_namespace* ns, __u64 cid)
+{
+    struct container_list* c;
+    hlist_for_each_entry_rcu(c, &container_bucket(ns, cid)->chain, hnode)
+    {
+        if(c->cid == cid)
+            return c;
+    }
+    return NULL;
+}
+
+/**
+ * Find the thread node of a task, NULL if the task is in no container.
+ * Caller must be in an RCU read-side critical section or hold the bucket lock.
+ */
+static inline struct thread_list* task_lookup(struct task_struct* task)
+{
+    struct thread_list* t;
+    hlist_for_each_entry_rcu(t, &task_bucket(task)->chain, hnode)
+    {
+        if(t->thread == task)
+            return t;
+    }
+    return NULL;
+}
+
+#endif
@@ -0,0 +1,153 @@
+//////////////////////////////////////////////////////////////////////
+//                      North Carolina State University
+//
+//
+//
+//                             Copyright 2016
+//
+////////////////////////////////////////////////////////////////////////
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms and conditions of the GNU General Public License,
+// version 2, as published by the Free Software Foundation.
+//
+// This program is distributed in the hope it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+//
+////////////////////////////////////////////////////////////////////////
+//
+//   Author:  Hung-Wei Tseng, Yu-Chia Liu
+//
+//
+//   Description:
+//     Scheduling policy of Processor Container: the decisions of the run
+//     queues without their locking or data structures, built both into the
+//     kernel module and into the simulation backend of the library
+//
+////////////////////////////////////////////////////////////////////////
+
+#ifndef PCONTAINER_POLICY_H
+#define PCONTAINER_POLICY_H
+
+#include <linux/types.h>
+
+#include "processor_container.h"
+
+#ifdef __KERNEL__
+#include <linux/math64.h>
+#define pcontainer_div_u64(a, b) div_u64(a, b)
+#else
+#define pcontainer_div_u64(a, b) ((a) / (b))
+#endif
+
+/**
+ * Virtual time of a container with the given shares after it held a slot
+ * for delta ns: it advances at PCONTAINER_DEFAULT_SHARES / shares.
+ */
+static inline __u64 pcontainer_policy_charge(__u64 vruntime, __u64 delta, __u32 shares)
+{
+    return vruntime + pcontainer_div_u64(delta * PCONTAINER_DEFAULT_SHARES, shares);
+}
+
+/**
+ * Whether virtual time a is before b, correct across wrap around.
+ */
+static inline int pcontainer_policy_before(__u64 a, __u64 b)
+{
+    return (__s64)(a - b) < 0;
+}
+
+// virtual time a latency container is treated as being behind its batch peers
+#define PCONTAINER_POLICY_LATENCY_LEAD 3000000ULL
+
+/**
+ * Position of a container in the timeline and against the running ones:
+ * its virtual time, PCONTAINER_POLICY_LATENCY_LEAD earlier for a latency
+ * container. A latency container runs before the batch containers within
+ * that lead, but it is charged as usual and cannot starve them.
+ */
+static inline __u64 pcontainer_policy_key(__u64 vruntime, __u32 sched_class)
+{
+    if(sched_class == PCONTAINER_CLASS_LATENCY)
+        return vruntime - PCONTAINER_POLICY_LATENCY_LEAD;
+    return vruntime;
+}
+
+// longest a container keeps its slot for its threads owning contended locks
+#define PCONTAINER_POLICY_BOOST_MAX_NS 10000000ULL
+
+/**
+ * Whether a container is kept from being preempted because nr_boosted of
+ * its threads own contended locks: only for PCONTAINER_POLICY_BOOST_MAX_NS
+ * after the first of them was boosted at boost_start, so that an owner that
+ * never unlocks cannot hold the slot forever.
+ */
+static inline int pcontainer_policy_boosted(unsigned int nr_boosted, __u64 boost_start, __u64 now)
+{
+    return nr_boosted != 0 && now - boost_start < PCONTAINER_POLICY_BOOST_MAX_NS;
+}
+
+/**
+ * Whether a container that becomes runnable while all slots are taken
+ * takes the slot of a running one right away instead of at its next tick:
+ * only a latency container from a batch container that is behind it and
+ * not boosted.
+ */
+static inline int pcontainer_policy_wakeup_preempt(__u32 running_class, __u64 running, __u32 waking_class, __u64 waking, int boosted)
+{
+    return waking_class == PCONTAINER_CLASS_LATENCY && running_class == PCONTAINER_CLASS_BATCH &&
+           pcontainer_policy_before(pcontainer_policy_key(waking, waking_class), running) && !boosted;
+}
+
+/**
+ * Whether a running container at the end of its quantum gives its slot to
+ * the first waiting container: only when it got ahead of it and is not
+ * boosted.
+ */
+static inline int pcontainer_policy_preempt(__u64 running, __u64 waiting, int boosted)
+{
+    return pcontainer_policy_before(waiting, running) && !boosted;
+}
+
+/**
+ * How far a container that moves to another run queue stays ahead of the
+ * virtual time of the run queue it leaves; being behind earns no credit.
+ */
+static inline __u64 pcontainer_policy_lag(__u64 vruntime, __u64 min_vruntime)
+{
+    __s64 lag = (__s64)(vruntime - min_vruntime);
+
+    return lag > 0 ? lag : 0;
+}
+
+/**
+ * Next quantum of a container whose quantum adapts between min and max:
+ * twice as long if its threads ran through the last one, half as long if
+ * one of them went to sleep before it ended.
+ */
+static inline __u64 pcontainer_policy_slice(__u64 slice, __u64 min, __u64 max, int slept)
+{
+    slice = slept ? slice / 2 : slice * 2;
+    if(slice < min)
+        return min;
+    return slice > max ? max : slice;
+}
+
+/**
+ * How many active threads of a container end their quantum together: as
+ * many as waiting threads can take over, at most its width.
+ */
+static inline unsigned int pcontainer_policy_rotate(unsigned int nr_threads, unsigned int width)
+{
+    if(nr_threads <= width)
+        return 0;
+    return nr_threads - width < width ? nr_threads - width : width;
+}
+
+#endif
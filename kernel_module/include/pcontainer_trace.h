@@ -0,0 +1,130 @@
+//////////////////////////////////////////////////////////////////////
+//                      North Carolina State University
+//
+//
+//
+//                             Copyright 2016
+//
+////////////////////////////////////////////////////////////////////////
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms and conditions of the GNU General Public License,
+// version 2, as published by the Free Software Foundation.
+//
+// This program is distributed in the hope it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+//
+////////////////////////////////////////////////////////////////////////
+//
+//   Author:  Hung-Wei Tseng, Yu-Chia Liu
+//
+//
+//   Description:
+//     Tracepoints of Processor Container, consumed by ftrace and perf
+//     under events/pcontainer (not installed for user space)
+//
+////////////////////////////////////////////////////////////////////////
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM pcontainer
+
+#if !defined(PCONTAINER_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define PCONTAINER_TRACE_H
+
+#include <linux/tracepoint.h>
+#include <linux/sched.h>
+#include <linux/ktime.h>
+
+#include "container.h"
+
+// a thread of a container and the length of the queues it is in
+DECLARE_EVENT_CLASS(pcontainer_thread,
+
+    TP_PROTO(struct container_list* c, struct task_struct* task),
+
+    TP_ARGS(c, task),
+
+    TP_STRUCT__entry(
+        __field(__u64, cid)
+        __field(pid_t, pid)
+        __field(int, cpu)
+        __field(unsigned int, nr_threads)
+        __field(unsigned int, nr_queued)
+    ),
+
+    TP_fast_assign(
+        __entry->cid = c->cid;
+        __entry->pid = task->pid;
+        __entry->cpu = task_cpu(task);
+        __entry->nr_threads = c->nr_threads;
+        __entry->nr_queued = READ_ONCE(c->rq->nr_queued);
+    ),
+
+    TP_printk("cid=%llu pid=%d cpu=%d nr_threads=%u nr_queued=%u",
+              __entry->cid, __entry->pid, __entry->cpu, __entry->nr_threads, __entry->nr_queued)
+);
+
+// a thread joined a container
+DEFINE_EVENT(pcontainer_thread, pcontainer_create,
+    TP_PROTO(struct container_list* c, struct task_struct* task),
+    TP_ARGS(c, task));
+
+// a thread left its container
+DEFINE_EVENT(pcontainer_thread, pcontainer_delete,
+    TP_PROTO(struct container_list* c, struct task_struct* task),
+    TP_ARGS(c, task));
+
+// an active thread went to the tail of the run queue of its container
+DEFINE_EVENT(pcontainer_thread, pcontainer_switch_out,
+    TP_PROTO(struct container_list* c, struct task_struct* task),
+    TP_ARGS(c, task));
+
+// a waiting thread was woken for its turn
+DEFINE_EVENT(pcontainer_thread, pcontainer_wakeup,
+    TP_PROTO(struct container_list* c, struct task_struct* task),
+    TP_ARGS(c, task));
+
+// a thread that waited since start (ktime_get_ns()) for its turn runs again
+TRACE_EVENT(pcontainer_switch_in,
+
+    TP_PROTO(struct container_list* c, struct task_struct* task, u64 start),
+
+    TP_ARGS(c, task, start),
+
+    TP_STRUCT__entry(
+        __field(__u64, cid)
+        __field(pid_t, pid)
+        __field(int, cpu)
+        __field(unsigned int, nr_threads)
+        __field(unsigned int, nr_queued)
+        __field(u64, wait_ns)
+    ),
+
+    TP_fast_assign(
+        __entry->cid = c->cid;
+        __entry->pid = task->pid;
+        __entry->cpu = task_cpu(task);
+        __entry->nr_threads = c->nr_threads;
+        __entry->nr_queued = READ_ONCE(c->rq->nr_queued);
+        __entry->wait_ns = ktime_get_ns() - start;
+    ),
+
+    TP_printk("cid=%llu pid=%d cpu=%d nr_threads=%u nr_queued=%u wait_ns=%llu",
+              __entry->cid, __entry->pid, __entry->cpu, __entry->nr_threads, __entry->nr_queued,
+              __entry->wait_ns)
+);
+
+#endif
+
+// the header is read again from define_trace.h, found through ccflags-y -I$(src)/include
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE pcontainer_trace
+#include <trace/define_trace.h>
@@ -40,10 +40,191 @@ struct processor_container_cmd
     __u64 cid;
 };
 
+// op: address of the 32 bit lock word, which holds the tid of the owner or 0
 #define PCONTAINER_IOCTL_LOCK _IOWR('N', 0x43, struct processor_container_cmd)
 #define PCONTAINER_IOCTL_UNLOCK _IOWR('N', 0x44, struct processor_container_cmd)
 #define PCONTAINER_IOCTL_DELETE _IOWR('N', 0x45, struct processor_container_cmd)
 #define PCONTAINER_IOCTL_CREATE _IOWR('N', 0x46, struct processor_container_cmd)
 #define PCONTAINER_IOCTL_CSWITCH _IOWR('N', 0x47, struct processor_container_cmd)
+// op: length of the kernel driven quantum in ns of the containers in the namespace
+// of the descriptor, 0 to let user space drive switches; at most
+// PCONTAINER_MAX_SLICE_US us
+#define PCONTAINER_IOCTL_TICK _IOWR('N', 0x48, struct processor_container_cmd)
+// op: shares of container cid, it gets op / (sum of all shares) of the processors
+#define PCONTAINER_IOCTL_SHARES _IOWR('N', 0x49, struct processor_container_cmd)
+// op: mask of the cpus 0-63 that container cid may run on, 0 for all cpus
+#define PCONTAINER_IOCTL_AFFINITY _IOWR('N', 0x4a, struct processor_container_cmd)
+// op: number of threads of container cid that run at the same time
+#define PCONTAINER_IOCTL_WIDTH _IOWR('N', 0x4b, struct processor_container_cmd)
+// run the entries queued in the mmap()ed ring, returns how many were consumed
+#define PCONTAINER_IOCTL_ENTER _IOWR('N', 0x4c, struct processor_container_cmd)
+// op: idle time in us after which the poll thread of the ring sleeps, 0 to stop it;
+// at most PCONTAINER_MAX_SQ_IDLE_US
+#define PCONTAINER_IOCTL_SQPOLL _IOWR('N', 0x4d, struct processor_container_cmd)
+// longest time the poll thread of a ring spins without entries, in us
+#define PCONTAINER_MAX_SQ_IDLE_US 10000
+// op: number of container and thread nodes kept preallocated, 0 to free them;
+// needs CAP_SYS_ADMIN
+#define PCONTAINER_IOCTL_PREALLOC _IOWR('N', 0x4e, struct processor_container_cmd)
+// op: PCONTAINER_QUOTA(quota_us, period_us), container cid runs at most quota_us of
+// each period_us, a quota of 0 lifts the limit
+#define PCONTAINER_IOCTL_QUOTA _IOWR('N', 0x4f, struct processor_container_cmd)
+// op: scheduling class of container cid, PCONTAINER_CLASS_BATCH or PCONTAINER_CLASS_LATENCY
+#define PCONTAINER_IOCTL_CLASS _IOWR('N', 0x50, struct processor_container_cmd)
+// op: PCONTAINER_SLICE(min_us, max_us), kernel driven quantum of container cid that adapts
+// to its threads between min_us and max_us, fixed if they are equal, 0 for the global one
+#define PCONTAINER_IOCTL_SLICE _IOWR('N', 0x51, struct processor_container_cmd)
+// op: placement of the threads of container cid, one of PCONTAINER_PLACE_*
+#define PCONTAINER_IOCTL_PLACEMENT _IOWR('N', 0x52, struct processor_container_cmd)
+// op: key of a namespace the open files of one user share, every user has keys of
+// its own; 0 for one of the file's own;
+// before the first container of the file. Stores the id of its namespace in cid
+#define PCONTAINER_IOCTL_NAMESPACE _IOWR('N', 0x53, struct processor_container_cmd)
+// op: PCONTAINER_GROUP(parent, shares), create group cid under group parent, or set
+// the shares of group cid. Groups divide the cpu among their children by shares
+#define PCONTAINER_IOCTL_GROUP _IOWR('N', 0x54, struct processor_container_cmd)
+// like PCONTAINER_IOCTL_CREATE, a new container cid is a child of group op, which is
+// created at the top if it does not exist
+#define PCONTAINER_IOCTL_CREATE_CHILD _IOWR('N', 0x55, struct processor_container_cmd)
+
+// shares of a container that never set them, and the largest accepted value
+#define PCONTAINER_DEFAULT_SHARES 1024
+#define PCONTAINER_MAX_SHARES (1 << 20)
+// scheduling classes: a latency container takes a slot ahead of the batch containers
+#define PCONTAINER_CLASS_BATCH 0
+#define PCONTAINER_CLASS_LATENCY 1
+// placements: threads run anywhere they may, move back to the cache and NUMA node of
+// the home cpu of their container at the start of a turn, or never leave them
+#define PCONTAINER_PLACE_OFF 0
+#define PCONTAINER_PLACE_PREFERRED 1
+#define PCONTAINER_PLACE_STRICT 2
+// the owner has to unlock through the kernel module, threads wait for the lock
+#define PCONTAINER_LOCK_CONTENDED 0x80000000U
+#define PCONTAINER_LOCK_TID_MASK 0x3fffffffU
+
+// largest accepted width of a container
+#define PCONTAINER_MAX_WIDTH 1024
+// largest accepted number of preallocated nodes
+#define PCONTAINER_MAX_PREALLOC 65536
+// accepted periods of a quota in us, and the op of PCONTAINER_IOCTL_QUOTA
+#define PCONTAINER_MIN_PERIOD_US 100
+#define PCONTAINER_MAX_PERIOD_US 1000000
+#define PCONTAINER_QUOTA(quota_us, period_us) (((__u64)(period_us) << 32) | (__u32)(quota_us))
+// longest accepted quantum of a container in us, and the op of PCONTAINER_IOCTL_SLICE
+#define PCONTAINER_MAX_SLICE_US 1000000
+#define PCONTAINER_SLICE(min_us, max_us) (((__u64)(max_us) << 32) | (__u32)(min_us))
+// op of PCONTAINER_IOCTL_GROUP, group ids are nonzero and below 2^32, the
+// deepest group accepted and the most groups of a namespace, -ENOSPC past it
+#define PCONTAINER_GROUP(parent, shares) (((__u64)(shares) << 32) | (__u32)(parent))
+#define PCONTAINER_MAX_DEPTH 16
+#define PCONTAINER_MAX_GROUPS 4096
+
+// opcodes of the entries of the submission queue of the ring
+#define PCONTAINER_OP_CREATE 1 // add thread tid of the process to container cid
+#define PCONTAINER_OP_DELETE 2 // take thread tid of the process out of its container
+#define PCONTAINER_OP_SWITCH 3 // end the quantum of container cid
+#define PCONTAINER_OP_SHARES 4 // set the shares of container cid to op
+#define PCONTAINER_OP_WIDTH 5 // set the width of container cid to op
+#define PCONTAINER_OP_AFFINITY 6 // restrict container cid to cpu mask op
+#define PCONTAINER_OP_QUOTA 7 // set the quota of container cid to op, see PCONTAINER_IOCTL_QUOTA
+#define PCONTAINER_OP_CLASS 8 // set the scheduling class of container cid to op
+#define PCONTAINER_OP_SLICE 9 // set the quantum of container cid to op, see PCONTAINER_IOCTL_SLICE
+#define PCONTAINER_OP_PLACEMENT 10 // set the placement of container cid to op
+
+// entries of each queue of the ring, a power of 2
+#define PCONTAINER_RING_ENTRIES 1024
+// ring flags: the poll thread sleeps, wake it with PCONTAINER_IOCTL_ENTER
+#define PCONTAINER_RING_NEED_WAKEUP 1
+
+struct pcontainer_sqe // an operation queued by user space
+{
+    __u32 opcode;
+    __u32 tid;
+    __u64 cid;
+    __u64 op;
+    __u64 user_data; // copied to the completion
+};
+
+struct pcontainer_cqe // the result of an operation
+{
+    __u64 user_data;
+    __s64 res; // 0 or a negative errno
+};
+
+struct pcontainer_ring // shared with user space by mmap() of the device at offset 0
+{
+    __u32 sq_head; // written by the kernel module
+    __u32 sq_tail; // written by user space
+    __u32 cq_head; // written by user space
+    __u32 cq_tail; // written by the kernel module
+    __u32 flags;
+    __u32 pad;
+    struct pcontainer_sqe sqes[PCONTAINER_RING_ENTRIES];
+    struct pcontainer_cqe cqes[PCONTAINER_RING_ENTRIES];
+};
+
+// mmap() offset of the read-only statistics of the containers in the
+// namespace of the descriptor
+#define PCONTAINER_STATS_OFFSET 0x40000000ULL
+// containers that get a slot in the statistics, the others are not counted
+#define PCONTAINER_STATS_SLOTS 4096
+
+struct pcontainer_stats // counters of one container
+{
+    __u32 seq; // odd while the kernel module updates the slot, read again if it changed
+    __u32 in_use; // the slot belongs to container cid
+    __u64 cid;
+    __u64 cpu_ns; // cpu time its threads used while it held a slot of its run queue
+    __u64 switches; // turns handed to threads or to the container
+    __u32 nr_runnable; // threads that may run now
+    __u32 nr_sleeping; // threads waiting for their turn
+    __u64 wait_ns; // time threads spent waiting for their turn
+    __u64 wakeups; // turns that woke up a waiting thread
+    __u64 wakeup_latency_sum_ns; // from the wakeup to running, average is sum / wakeups
+    __u64 wakeup_latency_max_ns;
+    __u64 nr_throttled; // times the container used up its quota and was taken off
+    __u64 throttled_ns; // time the container waited for its quota to be refilled
+    __u64 slice_ns; // current kernel driven quantum of the container, 0 for the global one
+    __u64 nsid; // namespace of cid, see PCONTAINER_IOCTL_NAMESPACE
+    __u64 nr_reaped; // threads taken out because they exited without deleting themselves
+    __u64 nr_blocks; // turns handed on because the active thread went to sleep
+    __u64 instructions; // hardware events of its threads while the perf parameter is on
+    __u64 cycles;
+    __u64 llc_misses; // last level cache misses
+    __u64 branch_misses;
+    __u64 perf_ns; // time the module spent reading the counters of its threads
+};
+
+struct pcontainer_stats_page // mapped by mmap() at PCONTAINER_STATS_OFFSET
+{
+    struct pcontainer_stats slots[PCONTAINER_STATS_SLOTS];
+};
+
+// mmap() offset of the read-only turn state of the containers in the
+// namespace of the descriptor, slot i belongs to the same container as slot i
+// of the statistics
+#define PCONTAINER_TURN_OFFSET 0x80000000ULL
+// active threads whose tids a slot lists, wider containers list the first ones
+#define PCONTAINER_TURN_TIDS 4
+// deadline_ns of a quantum that nothing waits for to end
+#define PCONTAINER_TURN_FOREVER (~0ULL)
+
+struct pcontainer_turn // who runs in one container and until when
+{
+    __u32 seq; // odd while the kernel module updates the slot, read again if it changed
+    __u32 in_use; // the slot belongs to container cid
+    __u64 cid;
+    __u64 nsid; // namespace of cid, see PCONTAINER_IOCTL_NAMESPACE
+    __u64 generation; // bumped whenever the active threads change or the container gains or loses its slot
+    __u64 deadline_ns; // CLOCK_MONOTONIC end of the quantum, 0 when user space ends it
+    __u32 running; // the container holds a slot of its run queue
+    __u32 nr_active; // threads that hold a turn while it runs
+    __u32 tids[PCONTAINER_TURN_TIDS]; // first nr_active of them, in the pid namespace of the process that created the namespace
+};
+
+struct pcontainer_turn_page // mapped by mmap() at PCONTAINER_TURN_OFFSET
+{
+    struct pcontainer_turn slots[PCONTAINER_STATS_SLOTS];
+};
 
 #endif
@@ -46,12 +46,18 @@
 extern long processor_container_lock(struct processor_container_cmd __user *user_cmd);
 extern long processor_container_unlock(struct processor_container_cmd __user *user_cmd);
 extern long processor_container_ioctl(struct file *filp, unsigned int cmd, unsigned long arg);
+extern int processor_container_open(struct inode *inode, struct file *filp);
+extern int processor_container_release(struct inode *inode, struct file *filp);
+extern int processor_container_mmap(struct file *filp, struct vm_area_struct *vma);
 extern int processor_container_init(void);
 extern void processor_container_exit(void);
 
 static const struct file_operations processor_container_fops = {
     .owner                = THIS_MODULE,
     .unlocked_ioctl       = processor_container_ioctl,
+    .open                 = processor_container_open,
+    .release              = processor_container_release,
+    .mmap                 = processor_container_mmap,
 };
 
 struct miscdevice processor_container_dev = {
@@ -0,0 +1,244 @@
+//////////////////////////////////////////////////////////////////////
+//                      North Carolina State University
+//
+//
+//
+//                             Copyright 2016
+//
+////////////////////////////////////////////////////////////////////////
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms and conditions of the GNU General Public License,
+// version 2, as published by the Free Software Foundation.
+//
+// This program is distributed in the hope it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+//
+////////////////////////////////////////////////////////////////////////
+//
+//   Author:  Hung-Wei Tseng, Yu-Chia Liu
+//
+//
+//   Description:
+//     Memory of Processor Container: slab caches of the container and
+//     thread nodes and pools of nodes preallocated for bursts of creates
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "processor_container.h"
+#include "container.h"
+
+#include <asm/uaccess.h>
+#include <linux/slab.h>
+#include <linux/kernel.h>
+#include <linux/errno.h>
+#include <linux/spinlock.h>
+#include <linux/rcupdate.h>
+#include <linux/capability.h>
+
+struct node_pool // free nodes kept back from the slab cache, linked through their first word
+{
+    spinlock_t lock; // taken from RCU callbacks, so with interrupts off
+    void* free;
+    unsigned int nr_free;
+    unsigned int target; // freed nodes go back to the pool until it holds target
+    struct kmem_cache* cache;
+};
+
+static struct node_pool container_pool = { .lock = __SPIN_LOCK_UNLOCKED(container_pool.lock) };
+static struct node_pool thread_pool = { .lock = __SPIN_LOCK_UNLOCKED(thread_pool.lock) };
+
+/**
+ * Take a node from the pool, or from the slab cache when the pool is empty.
+ */
+static void* pool_get(struct node_pool* pool)
+{
+    unsigned long flags;
+    void* node;
+
+    spin_lock_irqsave(&pool->lock, flags);
+    node = pool->free;
+    if(node != NULL)
+    {
+        pool->free = *(void**)node;
+        pool->nr_free--;
+    }
+    spin_unlock_irqrestore(&pool->lock, flags);
+    if(node == NULL)
+        node = kmem_cache_alloc(pool->cache, GFP_KERNEL);
+    return node;
+}
+
+/**
+ * Give a node back to the pool, or to the slab cache when the pool is full.
+ * May be called from an RCU callback.
+ */
+static void pool_put(struct node_pool* pool, void* node)
+{
+    unsigned long flags;
+
+    spin_lock_irqsave(&pool->lock, flags);
+    if(pool->nr_free < pool->target)
+    {
+        *(void**)node = pool->free;
+        pool->free = node;
+        pool->nr_free++;
+        node = NULL;
+    }
+    spin_unlock_irqrestore(&pool->lock, flags);
+    if(node != NULL)
+        kmem_cache_free(pool->cache, node);
+}
+
+/**
+ * Grow or shrink the pool to target free nodes.
+ */
+static int pool_resize(struct node_pool* pool, unsigned int target)
+{
+    unsigned long flags;
+    void* node;
+
+    spin_lock_irqsave(&pool->lock, flags);
+    pool->target = target;
+    spin_unlock_irqrestore(&pool->lock, flags);
+    // nodes are allocated outside the lock, the pool may change meanwhile
+    while(READ_ONCE(pool->nr_free) < target)
+    {
+        node = kmem_cache_alloc(pool->cache, GFP_KERNEL);
+        if(node == NULL)
+            return -ENOMEM;
+        pool_put(pool, node);
+    }
+    for(;;)
+    {
+        spin_lock_irqsave(&pool->lock, flags);
+        node = NULL;
+        if(pool->nr_free > pool->target)
+        {
+            node = pool->free;
+            pool->free = *(void**)node;
+            pool->nr_free--;
+        }
+        spin_unlock_irqrestore(&pool->lock, flags);
+        if(node == NULL)
+            return 0;
+        kmem_cache_free(pool->cache, node);
+    }
+}
+
+struct container_list* container_node_alloc(void)
+{
+    return pool_get(&container_pool);
+}
+
+/**
+ * Free a container node that was never published.
+ */
+void container_node_free(struct container_list* c)
+{
+    pool_put(&container_pool, c);
+}
+
+static void container_node_rcu(struct rcu_head* head)
+{
+    pool_put(&container_pool, container_of(head, struct container_list, rcu));
+}
+
+/**
+ * Free a container node once the lookups that may still see it are done.
+ */
+void container_node_free_rcu(struct container_list* c)
+{
+    call_rcu(&c->rcu, container_node_rcu);
+}
+
+struct thread_list* thread_node_alloc(void)
+{
+    return pool_get(&thread_pool);
+}
+
+/**
+ * Free a thread node that was never published.
+ */
+void thread_node_free(struct thread_list* t)
+{
+    pool_put(&thread_pool, t);
+}
+
+static void thread_node_rcu(struct rcu_head* head)
+{
+    struct thread_list* t = container_of(head, struct thread_list, rcu);
+
+    put_task_struct(t->thread); // taken when the node was published
+    container_perf_release(t);
+    pool_put(&thread_pool, t);
+}
+
+/**
+ * Free a thread node once the lookups that may still see it are done.
+ */
+void thread_node_free_rcu(struct thread_list* t)
+{
+    call_rcu(&t->rcu, thread_node_rcu);
+}
+
+/**
+ * Create the slab caches of the nodes.
+ */
+int alloc_init(void)
+{
+    container_pool.cache = KMEM_CACHE(container_list, SLAB_HWCACHE_ALIGN);
+    thread_pool.cache = KMEM_CACHE(thread_list, SLAB_HWCACHE_ALIGN);
+    if(container_pool.cache == NULL || thread_pool.cache == NULL)
+    {
+        alloc_exit();
+        return -ENOMEM;
+    }
+    return 0;
+}
+
+/**
+ * Free the pools and destroy the caches, after rcu_barrier() returned every
+ * node to them.
+ */
+void alloc_exit(void)
+{
+    if(container_pool.cache != NULL)
+    {
+        pool_resize(&container_pool, 0);
+        kmem_cache_destroy(container_pool.cache);
+    }
+    if(thread_pool.cache != NULL)
+    {
+        pool_resize(&thread_pool, 0);
+        kmem_cache_destroy(thread_pool.cache);
+    }
+}
+
+/**
+ * Keep cmd.op container and thread nodes preallocated, so that a burst of
+ * that many creates does not reach the slab allocator; 0 frees them. The
+ * pools serve every user of the module, only an administrator sizes them.
+ */
+int processor_container_prealloc(struct processor_container_cmd __user *user_cmd)
+{
+    struct processor_container_cmd kernel_cmd;
+    int ret;
+
+    if(!capable(CAP_SYS_ADMIN))
+        return -EPERM;
+    if(copy_from_user(&kernel_cmd, user_cmd, sizeof(kernel_cmd)))
+        return -EFAULT;
+    if(kernel_cmd.op > PCONTAINER_MAX_PREALLOC)
+        return -EINVAL;
+    ret = pool_resize(&container_pool, kernel_cmd.op);
+    if(ret == 0)
+        ret = pool_resize(&thread_pool, kernel_cmd.op);
+    return ret;
+}
@@ -0,0 +1,244 @@
+//////////////////////////////////////////////////////////////////////
+//                      North Carolina State University
+//
+//
+//
+//                             Copyright 2016
+//
+////////////////////////////////////////////////////////////////////////
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms and conditions of the GNU General Public License,
+// version 2, as published by the Free Software Foundation.
+//
+// This program is distributed in the hope it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+//
+////////////////////////////////////////////////////////////////////////
+//
+//   Author:  Hung-Wei Tseng, Yu-Chia Liu
+//
+//   Description:
+//     Hand the turn of a thread that blocks to the next thread of its
+//     container, and take it back into the rotation when it wakes up
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "processor_container.h"
+#include "container.h"
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/spinlock.h>
+#include <linux/sched.h>
+#include <linux/preempt.h>
+#include <linux/irq_work.h>
+
+#include "pcontainer_trace.h"
+
+#ifdef PCONTAINER_HAVE_PREEMPT_NOTIFIERS
+
+#ifndef task_is_running
+#define task_is_running(task) (READ_ONCE((task)->state) == TASK_RUNNING)
+#endif
+
+static bool handoff = true;
+module_param(handoff, bool, 0644);
+MODULE_PARM_DESC(handoff, "hand the turn of a thread that goes to sleep to the next thread of its container");
+
+static bool block_enabled; // threads watch their switches, only with the exit hook
+
+/**
+ * Take active thread t, which went to sleep, off the run queue of its
+ * container and let the next waiting thread run in its place.
+ * Called with c->lock held.
+ */
+static void container_block(struct container_list* c, struct thread_list* t)
+{
+    container_runtime_stop(c, t);
+    t->active = false;
+    WRITE_ONCE(t->blocked, true);
+    list_move_tail(&t->entry, &c->blocked);
+    c->nr_threads--;
+    c->nr_blocked++;
+    stats_block(c);
+    trace_pcontainer_switch_out(c, t->thread);
+    container_refill(c);
+}
+
+/**
+ * Put blocked thread t, which woke up, back at the tail of the run queue
+ * of its container. It parks unless it is among the active threads.
+ * Called with c->lock held.
+ */
+static void container_unblock(struct container_list* c, struct thread_list* t)
+{
+    if(!t->blocked)
+        return;
+    WRITE_ONCE(t->blocked, false);
+    list_move_tail(&t->entry, &c->threads);
+    c->nr_blocked--;
+    c->nr_threads++;
+    container_refill(c);
+    if(!t->active || !c->running)
+        container_park_kick(t);
+    container_tick_start(c);
+}
+
+/**
+ * Runs on the cpu where an active thread went to sleep, once the scheduler
+ * dropped its locks, and hands its turn on.
+ */
+static void block_work(struct irq_work* work)
+{
+    struct thread_list* t = container_of(work, struct thread_list, block_work);
+    struct container_list* c = t->container;
+
+    spin_lock(&c->lock);
+    // the owner of a contended lock keeps the turn, the others wait for it,
+    // and a thread that nobody waits behind keeps it as well
+    if(READ_ONCE(t->sleeping) && t->active && c->running && !t->lock_boost && !c->dead &&
+       c->nr_threads > c->width)
+    {
+        container_block(c, t);
+        smp_mb(); // pairs with block_sched_in()
+        if(!READ_ONCE(t->sleeping)) // it woke up before it saw t->blocked
+            container_unblock(c, t);
+    }
+    spin_unlock(&c->lock);
+}
+
+/**
+ * The thread is switched out. Called by the scheduler with its locks held,
+ * so the turn is handed on from block_work().
+ */
+static void block_sched_out(struct preempt_notifier* notifier, struct task_struct* next)
+{
+    struct thread_list* t = container_of(notifier, struct thread_list, notifier);
+
+    // a preempted thread may run again at once and keeps its turn
+    if(task_is_running(current) || !READ_ONCE(t->active) || !READ_ONCE(handoff))
+        return;
+    WRITE_ONCE(t->sleeping, true);
+    irq_work_queue(&t->block_work);
+}
+
+/**
+ * The thread runs again, it rejoins the rotation if it lost its turn.
+ */
+static void block_sched_in(struct preempt_notifier* notifier, int cpu)
+{
+    struct thread_list* t = container_of(notifier, struct thread_list, notifier);
+    struct container_list* c = t->container;
+    unsigned long flags;
+
+    WRITE_ONCE(t->sleeping, false);
+    smp_mb(); // pairs with block_work()
+    if(!READ_ONCE(t->blocked))
+        return;
+    spin_lock_irqsave(&c->lock, flags);
+    container_unblock(c, t);
+    spin_unlock_irqrestore(&c->lock, flags);
+}
+
+static struct preempt_ops block_ops = {
+    .sched_in = block_sched_in,
+    .sched_out = block_sched_out,
+};
+
+/**
+ * Initialize the switch notifier of a new thread node.
+ */
+void container_block_init(struct thread_list* t)
+{
+    preempt_notifier_init(&t->notifier, &block_ops);
+    init_irq_work(&t->block_work, block_work);
+    t->notify = false;
+    t->blocked = false;
+    t->sleeping = false;
+}
+
+/**
+ * Start watching the switches of the calling thread t. Called by the
+ * thread itself, a notifier is only added and removed by its own task.
+ */
+void container_block_watch(struct thread_list* t)
+{
+    if(t->notify || !READ_ONCE(block_enabled))
+        return;
+    preempt_disable();
+    preempt_notifier_register(&t->notifier);
+    preempt_enable();
+    t->notify = true;
+}
+
+/**
+ * Stop watching the switches of t before its node is freed. Called by the
+ * thread itself without the container lock, a thread whose notifier is
+ * registered is only taken out of its container by its own task.
+ */
+void container_block_unwatch(struct thread_list* t)
+{
+    if(!t->notify)
+        return;
+    preempt_disable();
+    preempt_notifier_unregister(&t->notifier);
+    preempt_enable();
+    t->notify = false;
+    irq_work_sync(&t->block_work);
+}
+
+/**
+ * Enable the switch notifiers. An exited thread could not remove its own
+ * notifier without the exit hook, so they stay off without it.
+ */
+void block_init(void)
+{
+    if(!exit_hooked())
+    {
+        printk(KERN_WARNING "processor_container: no task exit hook, blocked threads keep their turn\n");
+        return;
+    }
+    preempt_notifier_inc();
+    WRITE_ONCE(block_enabled, true);
+}
+
+void block_exit(void)
+{
+    if(block_enabled)
+        preempt_notifier_dec();
+}
+
+#else
+
+void container_block_init(struct thread_list* t)
+{
+    t->notify = false;
+    t->blocked = false;
+    t->sleeping = false;
+}
+
+void container_block_watch(struct thread_list* t)
+{
+}
+
+void container_block_unwatch(struct thread_list* t)
+{
+}
+
+void block_init(void)
+{
+}
+
+void block_exit(void)
+{
+}
+
+#endif
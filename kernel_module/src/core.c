@@ -30,6 +30,11 @@
 ////////////////////////////////////////////////////////////////////////
 
 #include "processor_container.h"
+#include "container.h"
+
+// core.c instantiates the tracepoints, the other sources only call them
+#define CREATE_TRACE_POINTS
+#include "pcontainer_trace.h"
 
 #include <asm/uaccess.h>
 #include <linux/slab.h>
@@ -41,41 +46,50 @@
 #include <linux/module.h>
 #include <linux/moduleparam.h>
 #include <linux/poll.h>
-#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/rcupdate.h>
 #include <linux/sched.h>
 
-struct container_list
-{
-    __u64 cid;
-    struct thread_list* head;
-    struct thread_list* cur;
-    struct container_list* next;
-};
-
-struct thread_list
-{
-    struct task_struct* thread;
-    struct thread_list* next;
-};
-
 extern struct miscdevice processor_container_dev;
 
-struct container_list* start;
-struct mutex container_mutex;
+struct pcontainer_bucket task_table[1 << PCONTAINER_HASH_BITS]; // thread nodes keyed by task_struct
 
 /**
  * Initialize and register the kernel module
  */
 int processor_container_init(void)
 {
-    int ret;
+    int ret, i;
+
+    // the table must be ready before the device becomes visible, the
+    // containers are in the namespaces of the open files
+    for(i = 0; i < (1 << PCONTAINER_HASH_BITS); i++)
+    {
+        spin_lock_init(&task_table[i].lock);
+        INIT_HLIST_HEAD(&task_table[i].chain);
+    }
+    sched_init();
+    lock_init();
+    if ((ret = alloc_init()))
+        return ret;
+    if ((ret = stats_init()))
+    {
+        alloc_exit();
+        return ret;
+    }
     if ((ret = misc_register(&processor_container_dev)))
+    {
         printk(KERN_ERR "Unable to register \"processor_container\" misc device\n");
+        stats_exit();
+        alloc_exit();
+    }
     else
+    {
+        // threads that exit without deleting themselves are reaped from here on
+        exit_init();
+        block_init();
         printk(KERN_ERR "\"processor_container\" misc device installed\n");
-        mutex_init(&container_mutex);
-        start = NULL;
-        // printk(KERN_INFO "Hello world %lu..\n", sizeof(*container_list));
+    }
     return ret;
 }
 
@@ -86,4 +100,11 @@ int processor_container_init(void)
 void processor_container_exit(void)
 {
     misc_deregister(&processor_container_dev);
+    block_exit();
+    exit_exit();
+    rcu_barrier(); // wait for containers and threads still queued for container_node_free_rcu()
+    perf_exit();
+    namespace_exit(); // after the last containers dropped their namespaces
+    stats_exit();
+    alloc_exit();
 }
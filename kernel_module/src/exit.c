@@ -0,0 +1,155 @@
+//////////////////////////////////////////////////////////////////////
+//                      North Carolina State University
+//
+//
+//
+//                             Copyright 2016
+//
+////////////////////////////////////////////////////////////////////////
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms and conditions of the GNU General Public License,
+// version 2, as published by the Free Software Foundation.
+//
+// This program is distributed in the hope it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+//
+////////////////////////////////////////////////////////////////////////
+//
+//   Author:  Hung-Wei Tseng, Yu-Chia Liu
+//
+//   Description:
+//     Reaping of the threads that exit without deleting themselves
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "processor_container.h"
+#include "container.h"
+
+#include <linux/kernel.h>
+#include <linux/sched.h>
+#include <linux/string.h>
+#include <linux/version.h>
+#ifdef PCONTAINER_HAVE_PROFILE_EXIT
+#include <linux/profile.h>
+#include <linux/notifier.h>
+#elif LINUX_VERSION_CODE >= KERNEL_VERSION(3, 15, 0) && LINUX_VERSION_CODE < KERNEL_VERSION(6, 16, 0)
+// the probe is looked up by name, so its prototype is only known to match
+// sched_process_exit(struct task_struct*) of these kernels, 6.16 added group_dead
+#define PCONTAINER_EXIT_TRACEPOINT
+#include <linux/tracepoint.h>
+#endif
+
+#ifdef PCONTAINER_HAVE_PROFILE_EXIT
+
+/**
+ * Task exit notifier, called by every exiting task before it loses its mm.
+ */
+static int exit_notify(struct notifier_block* nb, unsigned long event, void* data)
+{
+    container_reap(data);
+    return NOTIFY_OK;
+}
+
+static struct notifier_block exit_nb = {
+    .notifier_call = exit_notify,
+};
+
+static bool exit_registered;
+
+/**
+ * Hook the exit of the tasks.
+ */
+void exit_init(void)
+{
+    exit_registered = profile_event_register(PROFILE_TASK_EXIT, &exit_nb) == 0;
+    if(!exit_registered)
+        printk(KERN_WARNING "processor_container: no task exit notifier, exited threads are reaped on release\n");
+}
+
+void exit_exit(void)
+{
+    if(exit_registered)
+        profile_event_unregister(PROFILE_TASK_EXIT, &exit_nb);
+}
+
+/**
+ * Whether every thread passes container_reap() on its way out.
+ */
+bool exit_hooked(void)
+{
+    return exit_registered;
+}
+
+#elif defined(PCONTAINER_EXIT_TRACEPOINT)
+
+static struct tracepoint* exit_tp; // sched_process_exit, NULL if it was not found
+
+/**
+ * Probe of sched_process_exit, it fires in the exiting task.
+ */
+static void exit_probe(void* data, struct task_struct* p)
+{
+    container_reap(current);
+}
+
+static void exit_find(struct tracepoint* tp, void* priv)
+{
+    if(strcmp(tp->name, "sched_process_exit") == 0)
+        exit_tp = tp;
+}
+
+/**
+ * Hook the exit of the tasks.
+ */
+void exit_init(void)
+{
+    for_each_kernel_tracepoint(exit_find, NULL);
+    if(exit_tp != NULL && tracepoint_probe_register(exit_tp, exit_probe, NULL))
+        exit_tp = NULL;
+    if(exit_tp == NULL)
+        printk(KERN_WARNING "processor_container: no task exit tracepoint, exited threads are reaped on release\n");
+}
+
+void exit_exit(void)
+{
+    if(exit_tp == NULL)
+        return;
+    tracepoint_probe_unregister(exit_tp, exit_probe, NULL);
+    tracepoint_synchronize_unregister(); // no probe runs in the module once it is gone
+}
+
+/**
+ * Whether every thread passes container_reap() on its way out.
+ */
+bool exit_hooked(void)
+{
+    return exit_tp != NULL;
+}
+
+#else
+
+/**
+ * No exit hook of a known prototype, exited threads are reaped on release.
+ */
+void exit_init(void)
+{
+    printk(KERN_WARNING "processor_container: no task exit hook, exited threads are reaped on release\n");
+}
+
+void exit_exit(void)
+{
+}
+
+bool exit_hooked(void)
+{
+    return false;
+}
+
+#endif
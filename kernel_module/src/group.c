@@ -0,0 +1,206 @@
+//////////////////////////////////////////////////////////////////////
+//                      North Carolina State University
+//
+//
+//
+//                             Copyright 2016
+//
+////////////////////////////////////////////////////////////////////////
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms and conditions of the GNU General Public License,
+// version 2, as published by the Free Software Foundation.
+//
+// This program is distributed in the hope it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+//
+////////////////////////////////////////////////////////////////////////
+//
+//   Author:  Hung-Wei Tseng, Yu-Chia Liu
+//
+//   Description:
+//     Groups of containers, the inner nodes of the container tree that
+//     divide the cpu among their children by shares
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "processor_container.h"
+#include "container.h"
+
+#include <asm/uaccess.h>
+#include <linux/slab.h>
+#include <linux/kernel.h>
+#include <linux/errno.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/hash.h>
+#include <linux/err.h>
+
+static inline struct hlist_head* group_bucket(struct pcontainer_namespace* ns, __u64 gid)
+{
+    return &ns->groups[hash_64(gid, PCONTAINER_GROUP_HASH_BITS)];
+}
+
+/**
+ * Find group gid of namespace ns, NULL if it does not exist.
+ * Called with ns->group_lock held.
+ */
+static struct pcontainer_group* group_lookup(struct pcontainer_namespace* ns, __u64 gid)
+{
+    struct pcontainer_group* g;
+
+    hlist_for_each_entry(g, group_bucket(ns, gid), hnode)
+    {
+        if(g->gid == gid)
+            return g;
+    }
+    return NULL;
+}
+
+/**
+ * Create group gid under parent, with its part on every run queue.
+ * Fails with -ENOSPC once the namespace has PCONTAINER_MAX_GROUPS groups,
+ * they are only freed with the namespace. Called with ns->group_lock held.
+ */
+static struct pcontainer_group* group_alloc(struct pcontainer_namespace* ns, __u64 gid, struct pcontainer_group* parent, unsigned int shares)
+{
+    struct pcontainer_group* g;
+    struct pcontainer_group_rq* grq;
+    int cpu;
+
+    if(ns->nr_groups >= PCONTAINER_MAX_GROUPS)
+        return ERR_PTR(-ENOSPC);
+    g = kmalloc(sizeof(struct pcontainer_group), GFP_KERNEL);
+    if(g == NULL)
+        return ERR_PTR(-ENOMEM);
+    g->rqs = alloc_percpu(struct pcontainer_group_rq);
+    if(g->rqs == NULL)
+    {
+        kfree(g);
+        return ERR_PTR(-ENOMEM);
+    }
+    g->gid = gid;
+    g->shares = shares;
+    g->parent = parent;
+    g->depth = parent != NULL ? parent->depth + 1 : 0;
+    for_each_possible_cpu(cpu)
+    {
+        grq = per_cpu_ptr(g->rqs, cpu);
+        grq->se.vruntime = 0;
+        grq->se.sched_class = PCONTAINER_CLASS_BATCH;
+        grq->se.depth = g->depth;
+        RB_CLEAR_NODE(&grq->se.run_node);
+        grq->se.parent = parent != NULL ? per_cpu_ptr(parent->rqs, cpu) : NULL;
+        grq->se.group = grq;
+        timeline_init(&grq->timeline);
+        grq->tg = g;
+    }
+    hlist_add_head(&g->hnode, group_bucket(ns, gid));
+    ns->nr_groups++;
+    return g;
+}
+
+/**
+ * Free the groups of a namespace that goes away, its containers are gone.
+ */
+void group_free_all(struct pcontainer_namespace* ns)
+{
+    struct pcontainer_group* g;
+    struct hlist_node* tmp;
+    int i;
+
+    for(i = 0; i < (1 << PCONTAINER_GROUP_HASH_BITS); i++)
+    {
+        hlist_for_each_entry_safe(g, tmp, &ns->groups[i], hnode)
+        {
+            free_percpu(g->rqs);
+            kfree(g);
+        }
+    }
+    ns->nr_groups = 0;
+}
+
+/**
+ * Create group gid of namespace ns under group parent, 0 for the top, or set
+ * the shares of the existing group gid. A group cannot move to another parent.
+ */
+int container_set_group(struct pcontainer_namespace* ns, __u64 gid, __u64 parent, __u64 shares)
+{
+    struct pcontainer_group* p = NULL;
+    struct pcontainer_group* g;
+    int ret = 0;
+
+    if(gid == 0 || gid > U32_MAX || shares == 0 || shares > PCONTAINER_MAX_SHARES)
+        return -EINVAL;
+
+    mutex_lock(&ns->group_lock);
+    if(parent != 0 && (p = group_lookup(ns, parent)) == NULL)
+    {
+        ret = -ENOENT;
+        goto out;
+    }
+    g = group_lookup(ns, gid);
+    if(g != NULL)
+    {
+        if(g->parent != p)
+            ret = -EEXIST;
+        else
+            WRITE_ONCE(g->shares, shares); // the groups are charged at the new rate from now on
+        goto out;
+    }
+    if(p != NULL && p->depth + 1 >= PCONTAINER_MAX_DEPTH)
+    {
+        ret = -EINVAL;
+        goto out;
+    }
+    g = group_alloc(ns, gid, p, shares);
+    if(IS_ERR(g))
+        ret = PTR_ERR(g);
+out:
+    mutex_unlock(&ns->group_lock);
+    return ret;
+}
+
+/**
+ * Create group cmd.cid, or set its shares, see PCONTAINER_GROUP().
+ */
+int processor_container_group(struct pcontainer_namespace* ns, struct processor_container_cmd __user *user_cmd)
+{
+    struct processor_container_cmd kernel_cmd;
+
+    if(copy_from_user(&kernel_cmd, user_cmd, sizeof(kernel_cmd)))
+        return -EFAULT;
+    return container_set_group(ns, kernel_cmd.cid, (u32)kernel_cmd.op, kernel_cmd.op >> 32);
+}
+
+/**
+ * Add the calling thread to container cmd.cid, which is created as a child
+ * of group cmd.op if it does not exist yet. The group is created at the top
+ * with the default shares if it does not exist either.
+ */
+int processor_container_create_child(struct pcontainer_namespace* ns, struct processor_container_cmd __user *user_cmd)
+{
+    struct processor_container_cmd kernel_cmd;
+    struct pcontainer_group* g;
+
+    if(copy_from_user(&kernel_cmd, user_cmd, sizeof(kernel_cmd)))
+        return -EFAULT;
+    if(kernel_cmd.op == 0 || kernel_cmd.op > U32_MAX)
+        return -EINVAL;
+
+    mutex_lock(&ns->group_lock);
+    g = group_lookup(ns, kernel_cmd.op);
+    if(g == NULL)
+        g = group_alloc(ns, kernel_cmd.op, NULL, PCONTAINER_DEFAULT_SHARES);
+    mutex_unlock(&ns->group_lock);
+    if(IS_ERR(g))
+        return PTR_ERR(g);
+    // groups live as long as the namespace, which the container keeps alive
+    return container_create(ns, kernel_cmd.cid, g);
+}
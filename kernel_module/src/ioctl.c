@@ -30,6 +30,8 @@
 ////////////////////////////////////////////////////////////////////////
 
 #include "processor_container.h"
+#include "container.h"
+#include "pcontainer_trace.h"
 
 #include <asm/uaccess.h>
 #include <linux/slab.h>
@@ -41,168 +43,436 @@
 #include <linux/module.h>
 #include <linux/moduleparam.h>
 #include <linux/poll.h>
-#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/rcupdate.h>
 #include <linux/sched.h>
 #include <linux/kthread.h>
+#include <linux/cpumask.h>
+#include <linux/err.h>
+#include <linux/ktime.h>
 
-struct container_list // datastructure to maintain list of containers
+/**
+ * Park the calling thread until it becomes an active thread of its
+ * container and the container holds a slot (or a signal needs to be handled
+ * in user space), then apply the affinity and placement of the container.
+ * A thread that was evicted leaves its container instead.
+ * Called with c->lock held, returns with it released.
+ */
+void container_wait_turn(struct container_list* c, struct thread_list* t)
 {
-    __u64 cid;
-    struct thread_list* head; // points to head of thread list
-    struct thread_list* cur; // points to currently executing thread
-    struct container_list* next;
-};
+    u64 start = 0;
 
-struct thread_list // datastructure to maintain list of threads
+    while((!t->active || !c->running) && !t->evict && !signal_pending(current))
+    {
+        if(start == 0)
+            start = ktime_get_ns();
+        set_current_state(TASK_INTERRUPTIBLE);
+        spin_unlock_irq(&c->lock);
+        schedule();
+        spin_lock_irq(&c->lock);
+    }
+    if(start != 0)
+    {
+        stats_wait(c, t, start);
+        if(t->active && c->running)
+            trace_pcontainer_switch_in(c, current, start);
+    }
+    if(t->evict) // another thread of the process took it out of the container
+    {
+        spin_unlock_irq(&c->lock);
+        container_leave();
+        return;
+    }
+    container_block_watch(t);
+    container_place_thread(c, t, start != 0);
+}
+
+/**
+ * Take a task out of its container and destroy the container when it was the
+ * last thread. The task is the caller, or has exited and is reaped for it.
+ * Does not sleep.
+ */
+static void container_remove(struct task_struct* task, bool reaped)
 {
-    struct task_struct* thread;
-    struct thread_list* next;
-};
+    struct container_list* temp_container;
+    struct thread_list* temp_thread;
+    struct pcontainer_bucket* bucket = task_bucket(task);
+    bool orphan;
 
-extern struct mutex container_mutex;
-extern struct container_list* start;
+    spin_lock(&bucket->lock);
+    temp_thread = task_lookup(task);
+    if(temp_thread != NULL)
+        hlist_del_rcu(&temp_thread->hnode);
+    spin_unlock(&bucket->lock);
+    if(temp_thread == NULL)
+        return;
+    // no switch of the task reaches the node any more
+    container_block_unwatch(temp_thread);
+
+    temp_container = temp_thread->container;
+    spin_lock_irq(&temp_container->lock);
+    trace_pcontainer_delete(temp_container, task);
+    // a park requested by the tick is still queued on this thread, it frees the
+    // node; the work reads orphan under this lock, so only one of them frees it
+    orphan = temp_thread->park_pending;
+    temp_thread->orphan = orphan;
+    if(reaped)
+        stats_reap(temp_container);
+    // when just 1 thread in container - free container and thread datastructure memory
+    if(temp_container->nr_threads + temp_container->nr_blocked == 1)
+    {
+        // creators that already found the container retry their lookup once it is dead
+        temp_container->dead = true;
+        stats_detach(temp_container);
+        spin_unlock_irq(&temp_container->lock);
+        sched_container_exit(temp_container);
+        bucket = container_bucket(temp_container->nspace, temp_container->cid);
+        spin_lock(&bucket->lock);
+        hlist_del_rcu(&temp_container->hnode);
+        spin_unlock(&bucket->lock);
+        hrtimer_cancel(&temp_container->tick);
+        hrtimer_cancel(&temp_container->period);
+        // the groups of the container go with the namespace
+        namespace_put(temp_container->nspace);
+        container_node_free_rcu(temp_container);
+    }
+    // otherwise unlink the thread and hand the processor to its successor if it was active
+    else
+    {
+        list_del(&temp_thread->entry);
+        if(temp_thread->blocked)
+            temp_container->nr_blocked--;
+        else
+            temp_container->nr_threads--;
+        if(temp_thread->lock_boost)
+            temp_container->nr_boosted--;
+        if(temp_thread->active)
+        {
+            container_runtime_stop(temp_container, temp_thread);
+            container_refill(temp_container);
+        }
+        else
+            stats_threads(temp_container);
+        spin_unlock_irq(&temp_container->lock);
+    }
+    if(!orphan)
+        thread_node_free_rcu(temp_thread);
+}
+
+/**
+ * Take the calling thread out of its container and destroy the container
+ * when it was the last thread.
+ */
+void container_leave(void)
+{
+    container_remove(current, false);
+}
+
+/**
+ * Take a task that exits without having deleted itself out of its container,
+ * so that the next thread of the container gets its turn right away.
+ * Called from the task exit hook with task == current, or for a task that
+ * has exited. Does not sleep.
+ */
+void container_reap(struct task_struct* task)
+{
+    struct thread_list* t;
+
+    // every task of the system passes here on exit, most are in no container,
+    // the lookup without the bucket lock keeps them cheap
+    rcu_read_lock();
+    t = task_lookup(task);
+    rcu_read_unlock();
+    if(t != NULL)
+        container_remove(task, true);
+}
 
 /**
  * Delete the task in the container.
  * 
  * external functions needed:
- * mutex_lock(), mutex_unlock(), wake_up_process(), 
+ * spin_lock(), spin_unlock(), wake_up_process(), hrtimer_cancel(), container_node_free_rcu()
  */
 int processor_container_delete(struct processor_container_cmd __user *user_cmd)
 {
-    mutex_lock(&container_mutex);
-    struct container_list* temp_container = start;
-    struct container_list* prev_container = NULL;
-    while(temp_container != NULL)
+    struct thread_list* temp_thread;
+
+    rcu_read_lock();
+    temp_thread = task_lookup(current); // only the thread itself unlinks its node
+    rcu_read_unlock();
+    if(temp_thread != NULL)
+        container_perf_charge(temp_thread); // its last turn
+    container_leave();
+    return 0;
+}
+
+/**
+ * Allocate the node of a task that joins a container and publish it in the
+ * task table. Fails with -EBUSY if the task is in a container already.
+ */
+static struct thread_list* container_thread_alloc(struct task_struct* task)
+{
+    struct thread_list* temp_thread = thread_node_alloc();
+    struct pcontainer_bucket* bucket = task_bucket(task);
+
+    if(temp_thread == NULL)
+        return ERR_PTR(-ENOMEM);
+    temp_thread->thread = task;
+    get_task_struct(task); // dropped when the node is freed
+    temp_thread->active = false;
+    temp_thread->affinity_seq = 0;
+    temp_thread->lock_boost = false;
+    temp_thread->evict = false;
+    temp_thread->wake_ns = 0;
+    temp_thread->runtime_seen = task->se.sum_exec_runtime;
+    container_park_init(temp_thread);
+    container_block_init(temp_thread);
+    container_perf_init(temp_thread);
+
+    spin_lock(&bucket->lock);
+    if(task_lookup(task) != NULL)
+    {
+        spin_unlock(&bucket->lock);
+        put_task_struct(task);
+        thread_node_free(temp_thread);
+        return ERR_PTR(-EBUSY);
+    }
+    hlist_add_head_rcu(&temp_thread->hnode, &bucket->chain);
+    spin_unlock(&bucket->lock);
+    return temp_thread;
+}
+
+/**
+ * Unpublish and free the node of a task that could not join a container.
+ */
+static void container_thread_free(struct thread_list* temp_thread)
+{
+    struct pcontainer_bucket* bucket = task_bucket(temp_thread->thread);
+
+    spin_lock(&bucket->lock);
+    hlist_del_rcu(&temp_thread->hnode);
+    spin_unlock(&bucket->lock);
+    thread_node_free_rcu(temp_thread);
+}
+
+/**
+ * Add the node of a task to container cid of namespace ns, creating the
+ * container as a child of group if it does not exist yet. Returns with the
+ * lock of the container held.
+ */
+static struct container_list* container_join(struct pcontainer_namespace* ns, struct thread_list* temp_thread, __u64 cid, struct pcontainer_group* group)
+{
+    struct pcontainer_bucket* bucket;
+    struct container_list* c;
+
+retry:
+    rcu_read_lock();
+    c = container_lookup(ns, cid);
+    if(c != NULL) // add thread to already existing container
     {
-        if(current->pid == temp_container->cur->thread->pid)
+        spin_lock_irq(&c->lock);
+        rcu_read_unlock();
+        if(c->dead)
         {
-            // when just 1 thread in container - free container and thread datastructure memory
-            if(temp_container->cur == temp_container->head && temp_container->head->next == NULL)
-            {
-                if(prev_container == NULL)
-                {
-                    start = start->next;
-                }
-                else
-                {
-                    prev_container->next = temp_container->next;
-                }
-                printk(KERN_INFO "pid = %d..\n",current->pid);
-                kfree(temp_container->head);
-                kfree(temp_container);
-            }
-            // when current thread is head, move head to next
-            else if(temp_container->cur == temp_container->head)
-            {
-                struct thread_list* temp_thread = temp_container->head;
-                temp_container->head = temp_thread->next;
-                temp_container->cur = temp_container->head;
-                printk(KERN_INFO "pid = %d..\n",current->pid);
-                kfree(temp_thread);
-                wake_up_process(temp_container->cur->thread);
-            }
-            // general case to remove thread from datastructure in case of multiple threads in container
-            else
-            {
-                struct thread_list* temp_thread = temp_container->head;
-                while(temp_thread->next != temp_container->cur)
-                {
-                    temp_thread = temp_thread->next;
-                }
-                temp_thread->next = temp_container->cur->next;
-                temp_thread = temp_container->cur;
-                temp_container->cur = temp_thread->next;
-                if(temp_container->cur == NULL)
-                {
-                    temp_container->cur = temp_container->head;
-                }
-                printk(KERN_INFO "pid = %d..\n",current->pid);
-                kfree(temp_thread);
-                wake_up_process(temp_container->cur->thread);
-            }
-            break;
+            spin_unlock_irq(&c->lock);
+            goto retry;
         }
-        prev_container = temp_container;
-        temp_container = temp_container->next;
+        list_add_tail(&temp_thread->entry, &c->threads);
+        c->nr_threads++;
+        temp_thread->active = false;
+        temp_thread->container = c;
+        container_refill(c);
+        container_tick_start(c);
     }
-    mutex_unlock(&container_mutex);
-    return 0;
+    else // create new container with single thread
+    {
+        struct container_list* temp_container;
+
+        rcu_read_unlock();
+        temp_container = container_node_alloc();
+        if(temp_container == NULL)
+            return ERR_PTR(-ENOMEM);
+        temp_container->cid = cid;
+        temp_container->nspace = ns;
+        spin_lock_init(&temp_container->lock);
+        INIT_LIST_HEAD(&temp_container->threads);
+        list_add_tail(&temp_thread->entry, &temp_container->threads);
+        temp_container->nr_threads = 1;
+        INIT_LIST_HEAD(&temp_container->blocked);
+        temp_container->nr_blocked = 0;
+        temp_container->width = 1;
+        temp_container->nr_boosted = 0;
+        temp_container->boost_start = 0;
+        temp_thread->active = true;
+        temp_container->dead = false;
+        container_tick_init(temp_container);
+        temp_container->slice_ns = 0;
+        temp_container->slice_min_ns = 0;
+        temp_container->slice_max_ns = 0;
+        temp_container->shares = PCONTAINER_DEFAULT_SHARES;
+        temp_container->se.sched_class = PCONTAINER_CLASS_BATCH;
+        temp_container->se.vruntime = 0;
+        temp_container->se.depth = group != NULL ? group->depth + 1 : 0;
+        temp_container->se.parent = NULL;
+        temp_container->se.group = NULL;
+        temp_container->group = group;
+        temp_container->group_delta = 0;
+        temp_container->exec_start = 0;
+        temp_container->runtime_pending = 0;
+        sched_quota_init(temp_container);
+        temp_container->running = false;
+        RB_CLEAR_NODE(&temp_container->se.run_node);
+        cpumask_copy(&temp_container->allowed, cpu_possible_mask);
+        temp_container->affinity_seq = 0;
+        temp_container->rq = sched_select_rq(temp_container);
+        temp_container->placement = PCONTAINER_PLACE_OFF;
+        container_set_home(temp_container);
+        temp_thread->container = temp_container;
+        stats_attach(temp_container);
+
+        bucket = container_bucket(ns, cid);
+        spin_lock(&bucket->lock);
+        if(container_lookup(ns, cid) != NULL) // another thread created it meanwhile
+        {
+            spin_unlock(&bucket->lock);
+            stats_detach(temp_container);
+            container_node_free(temp_container);
+            goto retry;
+        }
+        // before it can be found, the last thread may leave right away
+        refcount_inc(&ns->ref);
+        hlist_add_head_rcu(&temp_container->hnode, &bucket->chain);
+        spin_unlock(&bucket->lock);
+        // take a free slot of its run queue or wait for the running containers to give one up
+        sched_container_enter(temp_container);
+        c = temp_container;
+        spin_lock_irq(&c->lock);
+    }
+    trace_pcontainer_create(c, temp_thread->thread);
+    return c;
 }
 
 /**
  * Create a task in the corresponding container.
  * external functions needed:
- * copy_from_user(), mutex_lock(), mutex_unlock(), set_current_state(), schedule()
+ * copy_from_user(), spin_lock(), spin_unlock(), set_current_state(), schedule(),
+ * sched_container_enter()
  * 
  * external variables needed:
  * struct task_struct* current  
  */
-int processor_container_create(struct processor_container_cmd __user *user_cmd)
+int processor_container_create(struct pcontainer_namespace* ns, struct processor_container_cmd __user *user_cmd)
 {
-    struct thread_list* temp_thread = (struct thread_list*)kmalloc(sizeof(struct thread_list), GFP_KERNEL);
-    struct processor_container_cmd *kernel_cmd = (struct processor_container_cmd*)kmalloc(sizeof(struct processor_container_cmd), GFP_KERNEL);
+    struct processor_container_cmd kernel_cmd;
 
-    temp_thread->thread = current;
-    temp_thread->next = NULL;
+    if(copy_from_user(&kernel_cmd, user_cmd, sizeof(kernel_cmd)))
+        return -EFAULT;
+    return container_create(ns, kernel_cmd.cid, NULL);
+}
 
-    copy_from_user(kernel_cmd, user_cmd, sizeof(*user_cmd));
+/**
+ * Add the calling thread to container cid of namespace ns and wait for its
+ * turn. A new container is a child of group, at the top if it is NULL; an
+ * existing one stays where it is.
+ */
+int container_create(struct pcontainer_namespace* ns, __u64 cid, struct pcontainer_group* group)
+{
+    struct thread_list* temp_thread;
+    struct container_list* c;
 
-    mutex_lock(&container_mutex);
-    if(start == NULL) // when first container is created
+    temp_thread = container_thread_alloc(current);
+    if(IS_ERR(temp_thread))
+        return PTR_ERR(temp_thread);
+    c = container_join(ns, temp_thread, cid, group);
+    if(IS_ERR(c))
     {
-        struct container_list* temp_container = (struct container_list*)kmalloc(sizeof(struct container_list), GFP_KERNEL);
-        temp_container->cid = kernel_cmd->cid;
-        temp_container->head = temp_thread;
-        temp_container->cur = temp_container->head;
-        temp_container->next = NULL;
-        start = temp_container;
-        mutex_unlock(&container_mutex);
-        schedule(); // here the purpose of schedule is to give a fair share to different containers
-        mutex_lock(&container_mutex);
+        container_thread_free(temp_thread);
+        return PTR_ERR(c);
     }
-    else
+    container_wait_turn(c, temp_thread);
+    return 0;
+}
+
+/**
+ * Add a thread to container cid of namespace ns on behalf of another thread
+ * of its process. It parks the next time it returns to user space unless it
+ * may run.
+ */
+int container_enroll(struct pcontainer_namespace* ns, struct task_struct* task, __u64 cid)
+{
+    struct thread_list* temp_thread;
+    struct container_list* c;
+
+    temp_thread = container_thread_alloc(task);
+    if(IS_ERR(temp_thread))
+        return PTR_ERR(temp_thread);
+    c = container_join(ns, temp_thread, cid, NULL);
+    if(IS_ERR(c))
     {
-        int flag = 0;
-        struct container_list* c = start;
-        while(c != NULL)
-        {
-            if(c->cid == kernel_cmd->cid) // add thread to already existing container
-            {
-                struct thread_list* temp2 = c->head;
-                flag = 1;
-                while(temp2->next != NULL)
-                {
-                    temp2 = temp2->next;
-                }
-                temp2->next = temp_thread;
-                mutex_unlock(&container_mutex);
-                set_current_state(TASK_INTERRUPTIBLE);
-                schedule();
-                mutex_lock(&container_mutex);
-                break;
-            }
-            c = c->next;
-        }
-        if(flag == 0) // create new container with single thread
-        {
-            struct container_list* temp_container = (struct container_list*)kmalloc(sizeof(struct container_list), GFP_KERNEL);
-            temp_container->cid = kernel_cmd->cid;
-            temp_container->head = temp_thread;
-            temp_container->cur = temp_container->head;
-            temp_container->next = NULL;
-            c = start;
-            while(c->next != NULL)
-            {
-                c = c->next;
-            }
-            c->next = temp_container;
-            mutex_unlock(&container_mutex);
-            schedule(); // here the purpose of schedule is to give a fair share to different containers
-            mutex_lock(&container_mutex);
-        }
+        container_thread_free(temp_thread);
+        return PTR_ERR(c);
+    }
+    if(!temp_thread->active || !c->running)
+        container_park(temp_thread);
+    spin_unlock_irq(&c->lock);
+    return 0;
+}
+
+/**
+ * Take a thread out of its container on behalf of another thread of its
+ * process. Only the thread itself unlinks its node, so it is woken or sent
+ * through container_wait_turn(), which leaves the container for it.
+ */
+int container_evict(struct task_struct* task)
+{
+    struct thread_list* temp_thread;
+    struct container_list* c;
+
+    if(task == current)
+    {
+        container_leave();
+        return 0;
+    }
+    rcu_read_lock();
+    temp_thread = task_lookup(task);
+    if(temp_thread == NULL)
+    {
+        rcu_read_unlock();
+        return -ENOENT;
+    }
+    c = temp_thread->container;
+    spin_lock_irq(&c->lock);
+    if(task_lookup(task) == temp_thread) // not on its way out already
+    {
+        temp_thread->evict = true;
+        wake_up_process(task);
+        container_park(temp_thread);
+    }
+    spin_unlock_irq(&c->lock);
+    rcu_read_unlock();
+    return 0;
+}
+
+/**
+ * End the quantum of the active threads of container cid of namespace ns.
+ */
+int container_switch_cid(struct pcontainer_namespace* ns, __u64 cid)
+{
+    struct container_list* c;
+
+    rcu_read_lock();
+    c = container_lookup(ns, cid);
+    if(c == NULL)
+    {
+        rcu_read_unlock();
+        return -ENOENT;
     }
-    mutex_unlock(&container_mutex);
+    sched_tick(c);
+    spin_lock_irq(&c->lock);
+    if(!c->dead && c->running && c->nr_threads > c->width)
+        container_rotate(c);
+    spin_unlock_irq(&c->lock);
+    rcu_read_unlock();
     return 0;
 }
 
@@ -210,42 +480,46 @@ int processor_container_create(struct processor_container_cmd __user *user_cmd)
  * switch to the next task in the next container
  * 
  * external functions needed:
- * mutex_lock(), mutex_unlock(), wake_up_process(), set_current_state(), schedule()
+ * spin_lock(), spin_unlock(), sched_tick(), container_rotate(), schedule()
  */
 
 int processor_container_switch(struct processor_container_cmd __user *user_cmd)
 {
-    mutex_lock(&container_mutex);
-    printk(KERN_INFO "pid before = %d..\n",current->pid);
-    struct container_list* temp_container = start;
-    while(temp_container != NULL)
+    struct container_list* temp_container;
+    struct thread_list* temp_thread;
+
+    rcu_read_lock();
+    temp_thread = task_lookup(current); // only the thread itself unlinks its node
+    rcu_read_unlock();
+    if(temp_thread == NULL)
     {
-        // if more than 1 threads in a container
-        if(current->pid == temp_container->cur->thread->pid && temp_container->head->next != NULL)
+        schedule();
+        return 0;
+    }
+    // the turn of the thread ends here unless it is the only one left
+    container_perf_charge(temp_thread);
+
+    temp_container = temp_thread->container;
+    spin_lock_irq(&temp_container->lock);
+    if(temp_thread->active && temp_container->running && !temp_thread->evict) // the quantum of the container ends
+    {
+        spin_unlock_irq(&temp_container->lock);
+        // give the slot to a waiting container that is behind this one
+        sched_tick(temp_container);
+        spin_lock_irq(&temp_container->lock);
+        // if threads are waiting in the container hand the processor to the first one
+        if(temp_thread->active && temp_container->nr_threads > temp_container->width && !temp_thread->lock_boost)
         {
-            struct thread_list* temp_thread = temp_container->cur->next;
-            if(temp_thread == NULL)
-            {
-                temp_thread = temp_container->head;
-            }
-            temp_container->cur = temp_thread;
-            wake_up_process(temp_container->cur->thread);
-            mutex_unlock(&container_mutex);
-            set_current_state(TASK_INTERRUPTIBLE);
-            schedule();
-            mutex_lock(&container_mutex);
-            break;
+            container_yield(temp_container, temp_thread);
         }
-        else // when just 1 thread signal the scheduler to schedule some other container 
+        else if(temp_thread->active && temp_container->running) // when no thread waits signal the scheduler to schedule some other container
         {
-            mutex_unlock(&container_mutex);
+            spin_unlock_irq(&temp_container->lock);
             schedule();
-            mutex_lock(&container_mutex);
+            return 0;
         }
-        temp_container = temp_container->next;
     }
-    printk(KERN_INFO "pid after = %d..\n",current->pid);
-    mutex_unlock(&container_mutex);
+    container_wait_turn(temp_container, temp_thread);
     return 0;
 }
 
@@ -256,14 +530,59 @@ int processor_container_switch(struct processor_container_cmd __user *user_cmd)
 int processor_container_ioctl(struct file *filp, unsigned int cmd,
                               unsigned long arg)
 {
+    struct pcontainer_namespace* ns;
+
     switch (cmd)
     {
+    case PCONTAINER_IOCTL_ENTER:
+        return processor_container_enter(filp, (void __user *)arg);
+    case PCONTAINER_IOCTL_SQPOLL:
+        return processor_container_sqpoll(filp, (void __user *)arg);
+    case PCONTAINER_IOCTL_LOCK:
+        return processor_container_lock((void __user *)arg);
+    case PCONTAINER_IOCTL_UNLOCK:
+        return processor_container_unlock((void __user *)arg);
     case PCONTAINER_IOCTL_CSWITCH:
         return processor_container_switch((void __user *)arg);
-    case PCONTAINER_IOCTL_CREATE:
-        return processor_container_create((void __user *)arg);
     case PCONTAINER_IOCTL_DELETE:
         return processor_container_delete((void __user *)arg);
+    case PCONTAINER_IOCTL_PREALLOC:
+        return processor_container_prealloc((void __user *)arg);
+    case PCONTAINER_IOCTL_NAMESPACE:
+        return processor_container_namespace(filp, (void __user *)arg);
+    default:
+        break;
+    }
+
+    // the other commands act on the namespace of the file, most name a
+    // container by its cid in it
+    ns = file_namespace(filp->private_data);
+    if(ns == NULL)
+        return -ENOMEM;
+    switch (cmd)
+    {
+    case PCONTAINER_IOCTL_TICK:
+        return processor_container_tick(ns, (void __user *)arg);
+    case PCONTAINER_IOCTL_CREATE:
+        return processor_container_create(ns, (void __user *)arg);
+    case PCONTAINER_IOCTL_CREATE_CHILD:
+        return processor_container_create_child(ns, (void __user *)arg);
+    case PCONTAINER_IOCTL_GROUP:
+        return processor_container_group(ns, (void __user *)arg);
+    case PCONTAINER_IOCTL_SHARES:
+        return processor_container_shares(ns, (void __user *)arg);
+    case PCONTAINER_IOCTL_AFFINITY:
+        return processor_container_affinity(ns, (void __user *)arg);
+    case PCONTAINER_IOCTL_WIDTH:
+        return processor_container_width(ns, (void __user *)arg);
+    case PCONTAINER_IOCTL_QUOTA:
+        return processor_container_quota(ns, (void __user *)arg);
+    case PCONTAINER_IOCTL_CLASS:
+        return processor_container_class(ns, (void __user *)arg);
+    case PCONTAINER_IOCTL_SLICE:
+        return processor_container_slice(ns, (void __user *)arg);
+    case PCONTAINER_IOCTL_PLACEMENT:
+        return processor_container_placement(ns, (void __user *)arg);
     default:
         return -ENOTTY;
     }
@@ -0,0 +1,384 @@
+//////////////////////////////////////////////////////////////////////
+//                      North Carolina State University
+//
+//
+//
+//                             Copyright 2016
+//
+////////////////////////////////////////////////////////////////////////
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms and conditions of the GNU General Public License,
+// version 2, as published by the Free Software Foundation.
+//
+// This program is distributed in the hope it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+//
+////////////////////////////////////////////////////////////////////////
+//
+//   Author:  Hung-Wei Tseng, Yu-Chia Liu
+//
+//
+//   Description:
+//     Locks of Processor Container: user space takes a free lock with an
+//     atomic on the lock word, the kernel module only sees contended locks
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "processor_container.h"
+#include "container.h"
+
+#include <asm/uaccess.h>
+#include <asm/futex.h>
+#include <linux/kernel.h>
+#include <linux/errno.h>
+#include <linux/list.h>
+#include <linux/hash.h>
+#include <linux/spinlock.h>
+#include <linux/rcupdate.h>
+#include <linux/sched.h>
+#include <linux/ktime.h>
+
+// number of buckets (as a power of 2) of the table of lock waiters
+#define PCONTAINER_LOCK_HASH_BITS 8
+
+struct lock_waiter // a thread sleeping in PCONTAINER_IOCTL_LOCK, lives on its stack
+{
+    struct task_struct* task;
+    struct thread_list* thread; // node of the task if it is in a container
+    struct mm_struct* mm; // the lock is the word at uaddr in mm
+    u32 __user* uaddr;
+    u32 tid;
+    bool granted; // the unlocker handed the lock over
+    struct list_head entry; // entry in the bucket of the lock, oldest first
+};
+
+struct lock_bucket
+{
+    spinlock_t lock; // taken before the lock of any container
+    struct list_head waiters;
+};
+
+static struct lock_bucket lock_table[1 << PCONTAINER_LOCK_HASH_BITS];
+
+/**
+ * Initialize the table of lock waiters.
+ */
+void lock_init(void)
+{
+    int i;
+
+    for(i = 0; i < (1 << PCONTAINER_LOCK_HASH_BITS); i++)
+    {
+        spin_lock_init(&lock_table[i].lock);
+        INIT_LIST_HEAD(&lock_table[i].waiters);
+    }
+}
+
+static inline struct lock_bucket* lock_bucket_of(struct mm_struct* mm, u32 __user* uaddr)
+{
+    return &lock_table[hash_long((unsigned long)uaddr ^ (unsigned long)mm, PCONTAINER_LOCK_HASH_BITS)];
+}
+
+/**
+ * Read the lock word without sleeping on a page fault. uaddr must have
+ * passed access_ok().
+ */
+static int lock_read(u32 __user* uaddr, u32* val)
+{
+    int ret;
+
+    pagefault_disable();
+    ret = __get_user(*val, uaddr);
+    pagefault_enable();
+    return ret;
+}
+
+/**
+ * Replace the lock word with new if it is old, *cur gets the word found.
+ * uaddr must have passed access_ok().
+ */
+static int lock_cmpxchg(u32 __user* uaddr, u32* cur, u32 old, u32 new)
+{
+    int ret;
+
+    pagefault_disable();
+    ret = futex_atomic_cmpxchg_inatomic(cur, uaddr, old, new);
+    pagefault_enable();
+    return ret;
+}
+
+/**
+ * Waiter on the lock to hand it to: the oldest one in container c if there
+ * is one, so that the lock does not wait for a container switch, otherwise
+ * the oldest one. Skips skip. Called with the bucket lock held.
+ */
+static struct lock_waiter* lock_pick(struct lock_bucket* b, struct mm_struct* mm, u32 __user* uaddr,
+                                     struct container_list* c, struct lock_waiter* skip)
+{
+    struct lock_waiter* w;
+    struct lock_waiter* oldest = NULL;
+
+    list_for_each_entry(w, &b->waiters, entry)
+    {
+        if(w == skip || w->mm != mm || w->uaddr != uaddr)
+            continue;
+        if(c == NULL || (w->thread != NULL && w->thread->container == c))
+            return w;
+        if(oldest == NULL)
+            oldest = w;
+    }
+    return oldest;
+}
+
+/**
+ * Keep the owner of a contended lock from being rotated out of its container
+ * until it unlocks, and queue it right behind the active threads so that it
+ * is the next one to run if it is waiting.
+ */
+static void lock_boost(struct thread_list* t)
+{
+    struct container_list* c = t->container;
+    struct thread_list* pos;
+    struct thread_list* last = NULL;
+    unsigned long flags;
+
+    rcu_read_lock();
+    spin_lock_irqsave(&c->lock, flags);
+    // a node that left the task table is about to leave the run queue
+    if(!t->lock_boost && task_lookup(t->thread) == t)
+    {
+        t->lock_boost = true;
+        if(c->nr_boosted++ == 0)
+            c->boost_start = ktime_get_ns(); // the slot is kept for a limited time only
+        if(!t->active && !t->blocked) // a blocked owner rejoins the run queue when it wakes up
+        {
+            list_for_each_entry(pos, &c->threads, entry)
+            {
+                if(!pos->active)
+                    break;
+                last = pos;
+            }
+            list_move(&t->entry, last != NULL ? &last->entry : &c->threads);
+        }
+    }
+    spin_unlock_irqrestore(&c->lock, flags);
+    rcu_read_unlock();
+}
+
+/**
+ * The owner released its lock, its container may rotate it out again.
+ */
+static void lock_unboost(struct thread_list* t)
+{
+    struct container_list* c = t->container;
+
+    spin_lock_irq(&c->lock);
+    if(t->lock_boost)
+    {
+        t->lock_boost = false;
+        c->nr_boosted--;
+    }
+    spin_unlock_irq(&c->lock);
+}
+
+/**
+ * Take the lock whose word is at cmd.op after the fast path in user space
+ * found it taken: mark it contended, give the turn of the caller to the
+ * other threads of its container and sleep until the owner hands it over.
+ */
+long processor_container_lock(struct processor_container_cmd __user *user_cmd)
+{
+    struct processor_container_cmd kernel_cmd;
+    struct lock_waiter w;
+    struct lock_bucket* b;
+    struct container_list* c;
+    struct task_struct* task;
+    struct thread_list* owner;
+    u32 __user* uaddr;
+    u32 val, cur;
+    long ret = 0;
+
+    if(copy_from_user(&kernel_cmd, user_cmd, sizeof(kernel_cmd)))
+        return -EFAULT;
+    uaddr = (u32 __user*)(unsigned long)kernel_cmd.op;
+    if((unsigned long)uaddr % sizeof(u32) != 0)
+        return -EINVAL;
+    // the word is read and written with the user access checks disabled
+    if(!access_ok(uaddr, sizeof(u32)))
+        return -EFAULT;
+
+    w.task = current;
+    w.mm = current->mm;
+    w.uaddr = uaddr;
+    w.tid = task_pid_vnr(current) & PCONTAINER_LOCK_TID_MASK;
+    w.granted = false;
+    rcu_read_lock();
+    w.thread = task_lookup(current); // only the thread itself unlinks its node
+    rcu_read_unlock();
+    b = lock_bucket_of(w.mm, uaddr);
+
+retry:
+    spin_lock(&b->lock);
+    for(;;)
+    {
+        if(lock_read(uaddr, &val))
+            goto fault;
+        if(val == 0) // released meanwhile, take it unless a sleeping waiter was handed it
+        {
+            if(lock_cmpxchg(uaddr, &cur, 0, w.tid | (lock_pick(b, w.mm, uaddr, NULL, NULL) ? PCONTAINER_LOCK_CONTENDED : 0)))
+                goto fault;
+            if(cur == 0)
+            {
+                spin_unlock(&b->lock);
+                return 0;
+            }
+            continue;
+        }
+        if((val & PCONTAINER_LOCK_TID_MASK) == w.tid)
+        {
+            spin_unlock(&b->lock);
+            return -EDEADLK;
+        }
+        if(val & PCONTAINER_LOCK_CONTENDED)
+            break;
+        // the owner has to come to the kernel module to unlock from now on
+        if(lock_cmpxchg(uaddr, &cur, val, val | PCONTAINER_LOCK_CONTENDED))
+            goto fault;
+        if(cur == val)
+            break;
+    }
+    list_add_tail(&w.entry, &b->waiters);
+
+    rcu_read_lock();
+    task = find_task_by_vpid(val & PCONTAINER_LOCK_TID_MASK);
+    // the tid comes from memory user space writes, only the threads of the
+    // caller's process are boosted, a waiter cannot pin another container
+    if(task != NULL && READ_ONCE(task->mm) != current->mm)
+        task = NULL;
+    owner = task != NULL ? task_lookup(task) : NULL;
+    if(owner != NULL)
+        lock_boost(owner);
+    rcu_read_unlock();
+    if(w.thread != NULL)
+    {
+        c = w.thread->container;
+        spin_lock_irq(&c->lock);
+        if(w.thread->active && !w.thread->lock_boost && c->nr_threads > c->width)
+            container_yield(c, w.thread);
+        spin_unlock_irq(&c->lock);
+    }
+
+    for(;;)
+    {
+        set_current_state(TASK_INTERRUPTIBLE);
+        spin_unlock(&b->lock);
+        schedule();
+        spin_lock(&b->lock);
+        if(w.granted)
+            break;
+        if(signal_pending(current)) // the library takes the fast path again after the handler
+        {
+            list_del(&w.entry);
+            ret = -EINTR;
+            break;
+        }
+    }
+    spin_unlock(&b->lock);
+    __set_current_state(TASK_RUNNING);
+
+    // the caller gave its turn away, wait until it is active again
+    if(w.thread != NULL)
+    {
+        c = w.thread->container;
+        spin_lock_irq(&c->lock);
+        container_wait_turn(c, w.thread);
+    }
+    return ret;
+
+fault:
+    spin_unlock(&b->lock);
+    // the fast path just tried to write the word so it is mapped writable,
+    // it only has to be faulted back in if it was paged out meanwhile
+    if(get_user(val, uaddr))
+        return -EFAULT;
+    goto retry;
+}
+
+/**
+ * Release the contended lock whose word is at cmd.op: hand it directly to
+ * a waiter, preferably one of the caller's container.
+ */
+long processor_container_unlock(struct processor_container_cmd __user *user_cmd)
+{
+    struct processor_container_cmd kernel_cmd;
+    struct lock_waiter* next;
+    struct lock_bucket* b;
+    struct thread_list* self;
+    u32 __user* uaddr;
+    u32 val, cur, new, tid = task_pid_vnr(current) & PCONTAINER_LOCK_TID_MASK;
+
+    if(copy_from_user(&kernel_cmd, user_cmd, sizeof(kernel_cmd)))
+        return -EFAULT;
+    uaddr = (u32 __user*)(unsigned long)kernel_cmd.op;
+    if((unsigned long)uaddr % sizeof(u32) != 0)
+        return -EINVAL;
+    // the word is read and written with the user access checks disabled
+    if(!access_ok(uaddr, sizeof(u32)))
+        return -EFAULT;
+
+    rcu_read_lock();
+    self = task_lookup(current);
+    rcu_read_unlock();
+    b = lock_bucket_of(current->mm, uaddr);
+
+retry:
+    spin_lock(&b->lock);
+    if(lock_read(uaddr, &val))
+        goto fault;
+    if((val & PCONTAINER_LOCK_TID_MASK) != tid)
+    {
+        spin_unlock(&b->lock);
+        return -EPERM;
+    }
+    next = lock_pick(b, current->mm, uaddr, self != NULL ? self->container : NULL, NULL);
+    new = 0;
+    if(next != NULL)
+    {
+        new = next->tid;
+        if(lock_pick(b, current->mm, uaddr, NULL, next) != NULL)
+            new |= PCONTAINER_LOCK_CONTENDED;
+    }
+    if(lock_cmpxchg(uaddr, &cur, val, new))
+        goto fault;
+    if(cur != val)
+    {
+        spin_unlock(&b->lock);
+        goto retry;
+    }
+    if(next != NULL)
+    {
+        list_del(&next->entry);
+        next->granted = true;
+        if((new & PCONTAINER_LOCK_CONTENDED) && next->thread != NULL)
+            lock_boost(next->thread);
+        wake_up_process(next->task);
+    }
+    spin_unlock(&b->lock);
+
+    if(self != NULL)
+        lock_unboost(self);
+    return 0;
+
+fault:
+    spin_unlock(&b->lock);
+    if(get_user(val, uaddr))
+        return -EFAULT;
+    goto retry;
+}
@@ -0,0 +1,324 @@
+//////////////////////////////////////////////////////////////////////
+//                      North Carolina State University
+//
+//
+//
+//                             Copyright 2016
+//
+////////////////////////////////////////////////////////////////////////
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms and conditions of the GNU General Public License,
+// version 2, as published by the Free Software Foundation.
+//
+// This program is distributed in the hope it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+//
+////////////////////////////////////////////////////////////////////////
+//
+//   Author:  Hung-Wei Tseng, Yu-Chia Liu
+//
+//
+//   Description:
+//     Namespaces of Processor Container: every open file of the device has
+//     its own table of containers, so processes neither collide on cids nor
+//     share the locks of the table, unless their files join a namespace by key
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "processor_container.h"
+#include "container.h"
+
+#include <asm/uaccess.h>
+#include <linux/slab.h>
+#include <linux/kernel.h>
+#include <linux/errno.h>
+#include <linux/fs.h>
+#include <linux/list.h>
+#include <linux/spinlock.h>
+#include <linux/mutex.h>
+#include <linux/sched.h>
+#include <linux/rcupdate.h>
+#include <linux/refcount.h>
+#include <linux/cred.h>
+#include <linux/atomic.h>
+#include <linux/llist.h>
+#include <linux/workqueue.h>
+#include <linux/pid_namespace.h>
+
+static LIST_HEAD(namespaces); // every namespace, the shared ones are found by key
+// protects namespaces and the last put of a namespace, a spinlock because
+// the task exit hook drops references where it must not sleep
+static DEFINE_SPINLOCK(namespace_lock);
+static atomic64_t namespace_ids = ATOMIC64_INIT(0);
+static LLIST_HEAD(namespace_free_list); // unlisted namespaces waiting for namespace_free_work
+
+/**
+ * Allocate a namespace with one reference, the caller adds it to the list.
+ */
+static struct pcontainer_namespace* namespace_alloc(u64 key)
+{
+    struct pcontainer_namespace* ns = kmalloc(sizeof(struct pcontainer_namespace), GFP_KERNEL);
+    int i;
+
+    if(ns == NULL)
+        return NULL;
+    refcount_set(&ns->ref, 1);
+    ns->id = atomic64_inc_return(&namespace_ids);
+    ns->key = key;
+    ns->owner = current_euid();
+    ns->pid_ns = get_pid_ns(task_active_pid_ns(current));
+    ns->stats = NULL;
+    ns->tick_ns = 0;
+    for(i = 0; i < (1 << PCONTAINER_NS_HASH_BITS); i++)
+    {
+        spin_lock_init(&ns->table[i].lock);
+        INIT_HLIST_HEAD(&ns->table[i].chain);
+    }
+    mutex_init(&ns->group_lock);
+    for(i = 0; i < (1 << PCONTAINER_GROUP_HASH_BITS); i++)
+        INIT_HLIST_HEAD(&ns->groups[i]);
+    ns->nr_groups = 0;
+    return ns;
+}
+
+/**
+ * Free a namespace that is not in the list any more. May sleep.
+ */
+static void namespace_free(struct pcontainer_namespace* ns)
+{
+    group_free_all(ns);
+    stats_free(ns);
+    put_pid_ns(ns->pid_ns);
+    kfree(ns);
+}
+
+/**
+ * Free the namespaces whose last reference was dropped where sleeping is not
+ * allowed.
+ */
+static void namespace_free_queued(struct work_struct* work)
+{
+    struct pcontainer_namespace* ns;
+    struct pcontainer_namespace* next;
+
+    llist_for_each_entry_safe(ns, next, llist_del_all(&namespace_free_list), free_node)
+        namespace_free(ns);
+}
+
+static DECLARE_WORK(namespace_free_work, namespace_free_queued);
+
+/**
+ * Drop a reference to a namespace and free it with the last one. Its table
+ * is empty by then, a container holds a reference until it is unhashed.
+ * Does not sleep, the namespace is freed by a work item.
+ */
+void namespace_put(struct pcontainer_namespace* ns)
+{
+    if(!refcount_dec_and_lock(&ns->ref, &namespace_lock))
+        return;
+    list_del(&ns->entry);
+    spin_unlock(&namespace_lock);
+    if(llist_add(&ns->free_node, &namespace_free_list))
+        schedule_work(&namespace_free_work);
+}
+
+/**
+ * Wait for the namespaces queued to be freed, on unload.
+ */
+void namespace_exit(void)
+{
+    flush_work(&namespace_free_work);
+}
+
+/**
+ * Install ns as the namespace of an open file unless it has one already.
+ * Returns the namespace of the file, the reference to ns is dropped if it
+ * lost the race.
+ */
+static struct pcontainer_namespace* file_set_namespace(struct pcontainer_file* f, struct pcontainer_namespace* ns)
+{
+    struct pcontainer_namespace* old = cmpxchg(&f->nspace, NULL, ns);
+
+    if(old == NULL)
+        return ns;
+    namespace_put(ns);
+    return old;
+}
+
+/**
+ * The namespace of an open file, a new one of its own if no command needed
+ * one yet. NULL if it cannot be allocated.
+ */
+struct pcontainer_namespace* file_namespace(struct pcontainer_file* f)
+{
+    struct pcontainer_namespace* ns = READ_ONCE(f->nspace);
+
+    if(ns != NULL)
+        return ns;
+    ns = namespace_alloc(0);
+    if(ns == NULL)
+        return NULL;
+    // created by the poll thread of the ring, whose tids are those of the process that mapped it
+    if((current->flags & PF_KTHREAD) && f->ns != NULL)
+    {
+        put_pid_ns(ns->pid_ns);
+        ns->pid_ns = get_pid_ns(f->ns);
+    }
+    spin_lock(&namespace_lock);
+    list_add(&ns->entry, &namespaces);
+    spin_unlock(&namespace_lock);
+    return file_set_namespace(f, ns);
+}
+
+/**
+ * Call fn for every container of namespace ns, which the caller holds a
+ * reference to. fn must not sleep.
+ */
+void namespace_for_each_container(struct pcontainer_namespace* ns, void (*fn)(struct container_list* c))
+{
+    struct container_list* c;
+    int i;
+
+    rcu_read_lock();
+    for(i = 0; i < (1 << PCONTAINER_NS_HASH_BITS); i++)
+    {
+        hlist_for_each_entry_rcu(c, &ns->table[i].chain, hnode)
+            fn(c);
+    }
+    rcu_read_unlock();
+}
+
+/**
+ * Call fn for every namespace with data. fn must not sleep.
+ */
+void namespace_for_each(void (*fn)(struct pcontainer_namespace* ns, void* data), void* data)
+{
+    struct pcontainer_namespace* ns;
+
+    spin_lock(&namespace_lock);
+    list_for_each_entry(ns, &namespaces, entry)
+        fn(ns, data);
+    spin_unlock(&namespace_lock);
+}
+
+/**
+ * A thread of namespace ns whose task has exited, with a reference held,
+ * NULL if there is none.
+ */
+static struct task_struct* namespace_find_exited(struct pcontainer_namespace* ns)
+{
+    struct task_struct* task = NULL;
+    struct container_list* c;
+    struct thread_list* t;
+    int i;
+
+    rcu_read_lock();
+    for(i = 0; i < (1 << PCONTAINER_NS_HASH_BITS) && task == NULL; i++)
+    {
+        hlist_for_each_entry_rcu(c, &ns->table[i].chain, hnode)
+        {
+            spin_lock_irq(&c->lock);
+            list_for_each_entry(t, &c->threads, entry)
+            {
+                // the notifier of a watched thread is only removed by the
+                // thread itself, the exit hook reaps it
+                if((t->thread->flags & PF_EXITING) && !t->notify)
+                {
+                    task = t->thread;
+                    get_task_struct(task);
+                    break;
+                }
+            }
+            spin_unlock_irq(&c->lock);
+            if(task != NULL)
+                break;
+        }
+    }
+    rcu_read_unlock();
+    return task;
+}
+
+/**
+ * Reap the threads of the namespace of a released file that exited without
+ * deleting themselves, in case the task exit hook missed them. Threads that
+ * still run stay, other files of a shared namespace may still use them.
+ */
+void namespace_reap(struct pcontainer_namespace* ns)
+{
+    struct task_struct* task;
+
+    while((task = namespace_find_exited(ns)) != NULL)
+    {
+        container_reap(task);
+        put_task_struct(task);
+    }
+}
+
+/**
+ * Copy the id of namespace ns to cmd.cid in user space, a 64 bit id does not
+ * fit the return value of an ioctl.
+ */
+static int namespace_copy_id(struct processor_container_cmd __user *user_cmd, struct pcontainer_namespace* ns)
+{
+    return put_user(ns->id, &user_cmd->cid) ? -EFAULT : 0;
+}
+
+/**
+ * Let the open file join the namespace of key cmd.op of the calling user,
+ * created by the first of its files that asks for it, or give it one of its
+ * own for key 0. The same key of another user names another namespace.
+ * Fails with -EBUSY once the file has a namespace. Stores the id of the namespace of the file in
+ * cmd.cid.
+ */
+int processor_container_namespace(struct file* filp, struct processor_container_cmd __user *user_cmd)
+{
+    struct processor_container_cmd kernel_cmd;
+    struct pcontainer_file* f = filp->private_data;
+    struct pcontainer_namespace* fresh;
+    struct pcontainer_namespace* found = NULL;
+    struct pcontainer_namespace* ns;
+
+    if(copy_from_user(&kernel_cmd, user_cmd, sizeof(kernel_cmd)))
+        return -EFAULT;
+    if(kernel_cmd.op == 0)
+    {
+        ns = file_namespace(f);
+        return ns != NULL ? namespace_copy_id(user_cmd, ns) : -ENOMEM;
+    }
+    if(READ_ONCE(f->nspace) != NULL)
+        return -EBUSY;
+
+    // allocated up front, the lock is not held across allocations
+    fresh = namespace_alloc(kernel_cmd.op);
+    if(fresh == NULL)
+        return -ENOMEM;
+    spin_lock(&namespace_lock);
+    // every user has keys of its own, nobody can claim those of another
+    list_for_each_entry(ns, &namespaces, entry)
+    {
+        if(ns->key == kernel_cmd.op && uid_eq(ns->owner, current_euid()))
+        {
+            found = ns;
+            break;
+        }
+    }
+    if(found != NULL)
+        refcount_inc(&found->ref);
+    else
+        list_add(&fresh->entry, &namespaces);
+    spin_unlock(&namespace_lock);
+    if(found != NULL)
+        namespace_free(fresh);
+    else
+        found = fresh;
+    if(file_set_namespace(f, found) != found)
+        return -EBUSY;
+    return namespace_copy_id(user_cmd, found);
+}
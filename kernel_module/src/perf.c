@@ -0,0 +1,198 @@
+//////////////////////////////////////////////////////////////////////
+//                      North Carolina State University
+//
+//
+//
+//                             Copyright 2016
+//
+////////////////////////////////////////////////////////////////////////
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms and conditions of the GNU General Public License,
+// version 2, as published by the Free Software Foundation.
+//
+// This program is distributed in the hope it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+//
+////////////////////////////////////////////////////////////////////////
+//
+//   Author:  Hung-Wei Tseng, Yu-Chia Liu
+//
+//   Description:
+//     Hardware performance counters of Processor Container: every thread
+//     counts its own instructions, cycles, cache and branch misses, and
+//     charges them to its container whenever its turn ends
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "processor_container.h"
+#include "container.h"
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/slab.h>
+#include <linux/err.h>
+#include <linux/spinlock.h>
+#include <linux/sched.h>
+#include <linux/ktime.h>
+#include <linux/llist.h>
+#include <linux/workqueue.h>
+#include <linux/perf_event.h>
+
+#ifdef CONFIG_PERF_EVENTS
+
+static bool perf;
+module_param(perf, bool, 0644);
+MODULE_PARM_DESC(perf, "count instructions, cycles, cache and branch misses of every container");
+
+// the events of PCONTAINER_PERF_*
+static const u64 perf_config[PCONTAINER_PERF_EVENTS] = {
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES,
+};
+
+struct pcontainer_perf // the counters of one thread
+{
+    struct perf_event* events[PCONTAINER_PERF_EVENTS]; // NULL if the cpu cannot count it
+    u64 charged[PCONTAINER_PERF_EVENTS]; // values already added to the container
+    struct llist_node free_node; // entry in perf_free_list
+};
+
+// counters of freed thread nodes, released from perf_free_work because
+// releasing them sleeps and nodes are freed from RCU callbacks
+static LLIST_HEAD(perf_free_list);
+
+static void perf_free(struct work_struct* work)
+{
+    struct pcontainer_perf *p, *next;
+    int i;
+
+    llist_for_each_entry_safe(p, next, llist_del_all(&perf_free_list), free_node)
+    {
+        for(i = 0; i < PCONTAINER_PERF_EVENTS; i++)
+        {
+            if(p->events[i] != NULL)
+                perf_event_release_kernel(p->events[i]);
+        }
+        kfree(p);
+    }
+}
+
+static DECLARE_WORK(perf_free_work, perf_free);
+
+/**
+ * Create the counters of task, which count only while it runs. Events the
+ * cpu cannot count are left out. Returns NULL if there is no memory.
+ */
+static struct pcontainer_perf* perf_alloc(struct task_struct* task)
+{
+    struct perf_event_attr attr = {
+        .type = PERF_TYPE_HARDWARE,
+        .size = sizeof(attr),
+        .exclude_hv = 1,
+    };
+    struct pcontainer_perf* p = kzalloc(sizeof(*p), GFP_KERNEL);
+    struct perf_event* event;
+    int i;
+
+    if(p == NULL)
+        return NULL;
+    for(i = 0; i < PCONTAINER_PERF_EVENTS; i++)
+    {
+        attr.config = perf_config[i];
+        event = perf_event_create_kernel_counter(&attr, -1, task, NULL, NULL);
+        p->events[i] = IS_ERR(event) ? NULL : event;
+    }
+    return p;
+}
+
+/**
+ * A new thread node has no counters yet.
+ */
+void container_perf_init(struct thread_list* t)
+{
+    t->perf = NULL;
+}
+
+/**
+ * Add the events the calling thread t counted since its last charge to its
+ * container, creating its counters on the first charge while the perf
+ * parameter is on. Called by the thread itself without locks when its turn
+ * ends. A thread is in one container for its whole life and its counters
+ * stop while it waits, so whatever they counted belongs to that container.
+ */
+void container_perf_charge(struct thread_list* t)
+{
+    struct container_list* c = t->container;
+    u64 delta[PCONTAINER_PERF_EVENTS] = { 0 };
+    u64 start, value, enabled, running;
+    int i;
+
+    if(!READ_ONCE(perf))
+        return;
+    start = ktime_get_ns();
+    if(t->perf == NULL && (t->perf = perf_alloc(current)) == NULL)
+        return;
+    for(i = 0; i < PCONTAINER_PERF_EVENTS; i++)
+    {
+        if(t->perf->events[i] == NULL)
+            continue;
+        value = perf_event_read_value(t->perf->events[i], &enabled, &running);
+        delta[i] = value - t->perf->charged[i];
+        t->perf->charged[i] = value;
+    }
+    spin_lock_irq(&c->lock);
+    stats_perf(c, delta, ktime_get_ns() - start);
+    spin_unlock_irq(&c->lock);
+}
+
+/**
+ * Release the counters of a thread node that is being freed. Does not sleep.
+ */
+void container_perf_release(struct thread_list* t)
+{
+    if(t->perf == NULL)
+        return;
+    llist_add(&t->perf->free_node, &perf_free_list);
+    schedule_work(&perf_free_work);
+    t->perf = NULL;
+}
+
+/**
+ * Wait for the counters of the freed nodes to be released. Called once no
+ * node can be freed any more.
+ */
+void perf_exit(void)
+{
+    flush_work(&perf_free_work);
+}
+
+#else
+
+void container_perf_init(struct thread_list* t)
+{
+    t->perf = NULL;
+}
+
+void container_perf_charge(struct thread_list* t)
+{
+}
+
+void container_perf_release(struct thread_list* t)
+{
+}
+
+void perf_exit(void)
+{
+}
+
+#endif
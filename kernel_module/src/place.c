@@ -0,0 +1,153 @@
+//////////////////////////////////////////////////////////////////////
+//                      North Carolina State University
+//
+//
+//
+//                             Copyright 2016
+//
+////////////////////////////////////////////////////////////////////////
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms and conditions of the GNU General Public License,
+// version 2, as published by the Free Software Foundation.
+//
+// This program is distributed in the hope it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+//
+////////////////////////////////////////////////////////////////////////
+//
+//   Author:  Hung-Wei Tseng, Yu-Chia Liu
+//
+//   Description:
+//     Placement of the threads of Processor Container: keeps the threads
+//     of a container on the cpus that share a cache and a NUMA node with
+//     the home cpu of the container, so its working set stays in one place
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "processor_container.h"
+#include "container.h"
+
+#include <asm/uaccess.h>
+#include <linux/kernel.h>
+#include <linux/errno.h>
+#include <linux/spinlock.h>
+#include <linux/rcupdate.h>
+#include <linux/sched.h>
+#include <linux/cpumask.h>
+#include <linux/topology.h>
+
+#ifdef PCONTAINER_HAVE_LLC_MASK
+#define pcontainer_llc_mask(cpu) cpu_llc_shared_mask(cpu)
+#else
+// the cpus of the package, which share the last level cache on most machines
+#define pcontainer_llc_mask(cpu) topology_core_cpumask(cpu)
+#endif
+
+/**
+ * Compute the home domain of a container: the cpus it may use that share
+ * the last level cache and the NUMA node of its home cpu, or the ones on
+ * that node, or all it may use. Threads of a strictly placed container
+ * apply it the next time they pass container_wait_turn().
+ * Called with c->lock held or before the container is visible.
+ */
+void container_set_home(struct container_list* c)
+{
+    int cpu = c->rq->cpu;
+    const struct cpumask* node = cpumask_of_node(cpu_to_node(cpu));
+
+    cpumask_and(&c->home, pcontainer_llc_mask(cpu), node);
+    cpumask_and(&c->home, &c->home, &c->allowed);
+    if(cpumask_empty(&c->home))
+        cpumask_and(&c->home, node, &c->allowed);
+    if(cpumask_empty(&c->home))
+        cpumask_copy(&c->home, &c->allowed);
+    if(c->placement == PCONTAINER_PLACE_STRICT)
+        c->affinity_seq++;
+}
+
+/**
+ * Keep the calling thread, which got its turn, in the cpus its container
+ * allows and the placement asks for. Strictly placed threads only run in
+ * the home domain. A thread of a container that prefers its home domain
+ * and waited for its turn elsewhere moves back there, after which the
+ * scheduler may spread it again.
+ * Called with c->lock held, returns with it released.
+ */
+void container_place_thread(struct container_list* c, struct thread_list* t, bool waited)
+{
+    unsigned int placement = c->placement;
+    bool apply = t->affinity_seq != c->affinity_seq;
+
+    t->affinity_seq = c->affinity_seq;
+    spin_unlock_irq(&c->lock);
+
+    // the container outlives the call, the thread is still on its run queue
+    if(placement == PCONTAINER_PLACE_STRICT)
+    {
+        if(apply)
+            set_cpus_allowed_ptr(current, &c->home);
+        return;
+    }
+    if(apply)
+        set_cpus_allowed_ptr(current, &c->allowed);
+    if(placement == PCONTAINER_PLACE_PREFERRED && waited &&
+       !cpumask_test_cpu(task_cpu(current), &c->home))
+    {
+        set_cpus_allowed_ptr(current, &c->home);
+        set_cpus_allowed_ptr(current, &c->allowed);
+    }
+}
+
+/**
+ * Set the placement of the threads of container cid to one of
+ * PCONTAINER_PLACE_OFF, PCONTAINER_PLACE_PREFERRED or PCONTAINER_PLACE_STRICT.
+ */
+int container_set_placement(struct pcontainer_namespace* ns, __u64 cid, __u64 placement)
+{
+    struct container_list* c;
+    int ret = -ENOENT;
+
+    if(placement > PCONTAINER_PLACE_STRICT)
+        return -EINVAL;
+
+    rcu_read_lock();
+    c = container_lookup(ns, cid);
+    if(c != NULL)
+    {
+        spin_lock_irq(&c->lock);
+        if(!c->dead)
+        {
+            if(c->placement != placement)
+            {
+                c->placement = placement;
+                c->affinity_seq++;
+                // send the active threads through container_wait_turn()
+                if(c->running)
+                    container_park_active(c);
+            }
+            ret = 0;
+        }
+        spin_unlock_irq(&c->lock);
+    }
+    rcu_read_unlock();
+    return ret;
+}
+
+/**
+ * Set the placement of container cmd.cid to cmd.op.
+ */
+int processor_container_placement(struct pcontainer_namespace* ns, struct processor_container_cmd __user *user_cmd)
+{
+    struct processor_container_cmd kernel_cmd;
+
+    if(copy_from_user(&kernel_cmd, user_cmd, sizeof(kernel_cmd)))
+        return -EFAULT;
+    return container_set_placement(ns, kernel_cmd.cid, kernel_cmd.op);
+}
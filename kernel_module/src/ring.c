@@ -0,0 +1,337 @@
+//////////////////////////////////////////////////////////////////////
+//                      North Carolina State University
+//
+//
+//
+//                             Copyright 2016
+//
+////////////////////////////////////////////////////////////////////////
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms and conditions of the GNU General Public License,
+// version 2, as published by the Free Software Foundation.
+//
+// This program is distributed in the hope it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+//
+////////////////////////////////////////////////////////////////////////
+//
+//   Author:  Hung-Wei Tseng, Yu-Chia Liu
+//
+//
+//   Description:
+//     Command ring of Processor Container: user space queues operations in
+//     memory shared with the kernel module, which runs them in batches
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "processor_container.h"
+#include "container.h"
+
+#include <asm/uaccess.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/kernel.h>
+#include <linux/errno.h>
+#include <linux/mm.h>
+#include <linux/fs.h>
+#include <linux/mutex.h>
+#include <linux/rcupdate.h>
+#include <linux/sched.h>
+#include <linux/kthread.h>
+#include <linux/pid.h>
+#include <linux/pid_namespace.h>
+#include <linux/jiffies.h>
+
+/**
+ * Set up the state of a new open file of the device.
+ */
+int processor_container_open(struct inode* inode, struct file* filp)
+{
+    struct pcontainer_file* f = kzalloc(sizeof(struct pcontainer_file), GFP_KERNEL);
+
+    if(f == NULL)
+        return -ENOMEM;
+    mutex_init(&f->ring_lock);
+    mutex_init(&f->sqpoll_lock);
+    filp->private_data = f;
+    return 0;
+}
+
+/**
+ * Stop the poll thread and free the ring when the last reference to the file,
+ * mappings of the ring included, is gone.
+ */
+int processor_container_release(struct inode* inode, struct file* filp)
+{
+    struct pcontainer_file* f = filp->private_data;
+
+    if(f->sqpoll != NULL)
+        kthread_stop(f->sqpoll);
+    if(f->ring != NULL)
+    {
+        vfree(f->ring);
+        put_pid(f->tgid);
+        put_pid_ns(f->ns);
+    }
+    // containers keep the namespace as long as they have threads, those of
+    // a killed process that the exit hook missed are reaped here
+    if(f->nspace != NULL)
+    {
+        namespace_reap(f->nspace);
+        namespace_put(f->nspace);
+    }
+    kfree(f);
+    return 0;
+}
+
+/**
+ * Map the ring into the calling process, allocating it on the first call, or
+ * the statistics of the containers at PCONTAINER_STATS_OFFSET and their turns
+ * at PCONTAINER_TURN_OFFSET.
+ */
+int processor_container_mmap(struct file* filp, struct vm_area_struct* vma)
+{
+    struct pcontainer_file* f = filp->private_data;
+    unsigned long size = vma->vm_end - vma->vm_start;
+    struct pcontainer_ring* ring;
+    int ret;
+
+    if(vma->vm_pgoff == (PCONTAINER_STATS_OFFSET >> PAGE_SHIFT) ||
+       vma->vm_pgoff == (PCONTAINER_TURN_OFFSET >> PAGE_SHIFT))
+        return stats_mmap(file_namespace(f), vma);
+    if(vma->vm_pgoff != 0 || size != PAGE_ALIGN(sizeof(struct pcontainer_ring)))
+        return -EINVAL;
+    mutex_lock(&f->ring_lock);
+    if(f->ring == NULL)
+    {
+        ring = vmalloc_user(size);
+        if(ring == NULL)
+        {
+            ret = -ENOMEM;
+            goto out;
+        }
+        f->sq_head = 0;
+        f->cq_tail = 0;
+        f->tgid = get_pid(task_tgid(current));
+        f->ns = get_pid_ns(task_active_pid_ns(current));
+        // enter and sqpoll look at the ring without ring_lock
+        smp_store_release(&f->ring, ring);
+    }
+    ret = remap_vmalloc_range(vma, f->ring, 0);
+out:
+    mutex_unlock(&f->ring_lock);
+    return ret;
+}
+
+/**
+ * Thread tid of the process that mapped the ring with a reference held,
+ * NULL if there is no such thread.
+ */
+static struct task_struct* ring_task(struct pcontainer_file* f, u32 tid)
+{
+    struct task_struct* task;
+
+    rcu_read_lock();
+    task = pid_task(find_pid_ns(tid, f->ns), PIDTYPE_PID);
+    if(task != NULL && task_tgid(task) == f->tgid)
+        get_task_struct(task);
+    else
+        task = NULL;
+    rcu_read_unlock();
+    return task;
+}
+
+/**
+ * Run one entry of the submission queue and return its result.
+ */
+static long ring_exec(struct pcontainer_file* f, struct pcontainer_sqe* sqe)
+{
+    struct pcontainer_namespace* ns = file_namespace(f);
+    struct task_struct* task;
+    long ret;
+
+    if(ns == NULL)
+        return -ENOMEM;
+    switch(sqe->opcode)
+    {
+    case PCONTAINER_OP_CREATE:
+    case PCONTAINER_OP_DELETE:
+        task = ring_task(f, sqe->tid);
+        if(task == NULL)
+            return -ESRCH;
+        if(sqe->opcode == PCONTAINER_OP_CREATE)
+            ret = container_enroll(ns, task, sqe->cid);
+        else
+            ret = container_evict(task);
+        put_task_struct(task);
+        return ret;
+    case PCONTAINER_OP_SWITCH:
+        return container_switch_cid(ns, sqe->cid);
+    case PCONTAINER_OP_SHARES:
+        return container_set_shares(ns, sqe->cid, sqe->op);
+    case PCONTAINER_OP_WIDTH:
+        return container_set_width(ns, sqe->cid, sqe->op);
+    case PCONTAINER_OP_AFFINITY:
+        return container_set_affinity(ns, sqe->cid, sqe->op);
+    case PCONTAINER_OP_QUOTA:
+        return container_set_quota(ns, sqe->cid, sqe->op);
+    case PCONTAINER_OP_CLASS:
+        return container_set_class(ns, sqe->cid, sqe->op);
+    case PCONTAINER_OP_SLICE:
+        return container_set_slice(ns, sqe->cid, sqe->op);
+    case PCONTAINER_OP_PLACEMENT:
+        return container_set_placement(ns, sqe->cid, sqe->op);
+    default:
+        return -EINVAL;
+    }
+}
+
+/**
+ * Run the entries user space queued since the last drain, as long as the
+ * completion queue has room for their results. Returns how many ran.
+ */
+static int ring_drain(struct pcontainer_file* f)
+{
+    struct pcontainer_ring* r = f->ring;
+    struct pcontainer_sqe sqe;
+    struct pcontainer_cqe* cqe;
+    u32 tail;
+    int n = 0;
+
+    mutex_lock(&f->ring_lock);
+    tail = smp_load_acquire(&r->sq_tail);
+    while(f->sq_head != tail)
+    {
+        // the rest waits for user space to reap completions
+        if(f->cq_tail - READ_ONCE(r->cq_head) >= PCONTAINER_RING_ENTRIES)
+            break;
+        sqe = r->sqes[f->sq_head & (PCONTAINER_RING_ENTRIES - 1)];
+        cqe = &r->cqes[f->cq_tail & (PCONTAINER_RING_ENTRIES - 1)];
+        cqe->user_data = sqe.user_data;
+        cqe->res = ring_exec(f, &sqe);
+        f->sq_head++;
+        f->cq_tail++;
+        smp_store_release(&r->sq_head, f->sq_head);
+        smp_store_release(&r->cq_tail, f->cq_tail);
+        n++;
+    }
+    mutex_unlock(&f->ring_lock);
+    return n;
+}
+
+/**
+ * Poll thread of a ring: drains it while user space keeps queueing and
+ * sleeps after sq_idle_us without entries until PCONTAINER_IOCTL_ENTER.
+ */
+static int ring_sqpoll(void* data)
+{
+    struct pcontainer_file* f = data;
+    struct pcontainer_ring* r = f->ring;
+    unsigned long idle = usecs_to_jiffies(f->sq_idle_us);
+    unsigned long last = jiffies;
+
+    while(!kthread_should_stop())
+    {
+        if(ring_drain(f) > 0)
+        {
+            last = jiffies;
+        }
+        else if(time_after(jiffies, last + idle))
+        {
+            set_current_state(TASK_INTERRUPTIBLE);
+            WRITE_ONCE(r->flags, PCONTAINER_RING_NEED_WAKEUP);
+            smp_mb(); // pairs with the barrier of the library between sq_tail and flags
+            if(READ_ONCE(r->sq_tail) == f->sq_head && !kthread_should_stop())
+                schedule();
+            __set_current_state(TASK_RUNNING);
+            WRITE_ONCE(r->flags, 0);
+            last = jiffies;
+            continue;
+        }
+        cond_resched();
+    }
+    return 0;
+}
+
+/**
+ * Run the queued entries of the ring, or wake its poll thread. A caller that
+ * added itself to a container waits for its turn like after create.
+ */
+int processor_container_enter(struct file* filp, struct processor_container_cmd __user *user_cmd)
+{
+    struct pcontainer_file* f = filp->private_data;
+    struct thread_list* t;
+    bool polled;
+    int n = 0;
+
+    if(smp_load_acquire(&f->ring) == NULL)
+        return -EINVAL;
+    if(task_tgid(current) != f->tgid)
+        return -EPERM;
+
+    mutex_lock(&f->sqpoll_lock);
+    polled = f->sqpoll != NULL;
+    if(polled)
+        wake_up_process(f->sqpoll);
+    mutex_unlock(&f->sqpoll_lock);
+    if(!polled)
+        n = ring_drain(f);
+
+    rcu_read_lock();
+    t = task_lookup(current); // only the thread itself unlinks its node
+    rcu_read_unlock();
+    if(t != NULL)
+    {
+        spin_lock_irq(&t->container->lock);
+        container_wait_turn(t->container, t);
+    }
+    return n;
+}
+
+/**
+ * Start the poll thread of the ring with an idle time of cmd.op us, at most
+ * PCONTAINER_MAX_SQ_IDLE_US, or stop it when cmd.op is 0.
+ */
+int processor_container_sqpoll(struct file* filp, struct processor_container_cmd __user *user_cmd)
+{
+    struct processor_container_cmd kernel_cmd;
+    struct pcontainer_file* f = filp->private_data;
+    struct task_struct* task;
+    int ret = 0;
+
+    if(copy_from_user(&kernel_cmd, user_cmd, sizeof(kernel_cmd)))
+        return -EFAULT;
+    // any user may start the thread, it must not spin for as long as it likes
+    if(kernel_cmd.op > PCONTAINER_MAX_SQ_IDLE_US)
+        return -EINVAL;
+    if(smp_load_acquire(&f->ring) == NULL)
+        return -EINVAL;
+    if(task_tgid(current) != f->tgid)
+        return -EPERM;
+
+    mutex_lock(&f->sqpoll_lock);
+    if(kernel_cmd.op == 0)
+    {
+        if(f->sqpoll != NULL)
+            kthread_stop(f->sqpoll);
+        f->sqpoll = NULL;
+    }
+    else if(f->sqpoll == NULL)
+    {
+        f->sq_idle_us = kernel_cmd.op;
+        task = kthread_run(ring_sqpoll, f, "pcontainer_sq");
+        if(IS_ERR(task))
+            ret = PTR_ERR(task);
+        else
+            f->sqpoll = task;
+    }
+    mutex_unlock(&f->sqpoll_lock);
+    return ret;
+}
@@ -0,0 +1,1225 @@
+//////////////////////////////////////////////////////////////////////
+//                      North Carolina State University
+//
+//
+//
+//                             Copyright 2016
+//
+////////////////////////////////////////////////////////////////////////
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms and conditions of the GNU General Public License,
+// version 2, as published by the Free Software Foundation.
+//
+// This program is distributed in the hope it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+//
+////////////////////////////////////////////////////////////////////////
+//
+//   Author:  Hung-Wei Tseng, Yu-Chia Liu
+//
+//   Description:
+//     Proportional share scheduling between the containers of
+//     Processor Container
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "processor_container.h"
+#include "container.h"
+#include "pcontainer_policy.h"
+#include "pcontainer_trace.h"
+
+#include <asm/uaccess.h>
+#include <linux/slab.h>
+#include <linux/kernel.h>
+#include <linux/errno.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/spinlock.h>
+#include <linux/rcupdate.h>
+#include <linux/rbtree.h>
+#include <linux/sched.h>
+#include <linux/cpumask.h>
+#include <linux/percpu.h>
+#include <linux/math64.h>
+
+static unsigned int slots = 1;
+module_param(slots, uint, 0444);
+MODULE_PARM_DESC(slots, "containers of each cpu whose threads may run at the same time");
+
+static bool steal = true;
+module_param(steal, bool, 0644);
+MODULE_PARM_DESC(steal, "let a run queue with a free slot take a waiting container from the busiest one");
+
+static unsigned int migration_cost_us = 500;
+module_param(migration_cost_us, uint, 0644);
+MODULE_PARM_DESC(migration_cost_us, "a container that ran this recently is cache hot and not stolen");
+
+// waiting containers looked at from the far end of the busiest timeline per steal
+#define PCONTAINER_STEAL_SCAN 8
+
+DEFINE_PER_CPU(struct pcontainer_rq, pcontainer_rqs);
+
+/**
+ * Initialize an empty timeline.
+ */
+void timeline_init(struct pcontainer_timeline* tl)
+{
+    tl->root = RB_ROOT;
+    tl->leftmost = NULL;
+    tl->nr_queued = 0;
+    tl->min_vruntime = 0;
+}
+
+/**
+ * Initialize the run queues of containers, one per cpu.
+ */
+void sched_init(void)
+{
+    struct pcontainer_rq* rq;
+    int cpu;
+
+    for_each_possible_cpu(cpu)
+    {
+        rq = per_cpu_ptr(&pcontainer_rqs, cpu);
+        spin_lock_init(&rq->lock);
+        rq->cpu = cpu;
+        timeline_init(&rq->timeline);
+        INIT_LIST_HEAD(&rq->running);
+        rq->nr_running = 0;
+        rq->nr_queued = 0;
+        rq->nr_slots = slots ? slots : 1;
+    }
+}
+
+/**
+ * Lock the home run queue of a container. The home run queue only changes
+ * under its own lock, so retry if the container moved while we waited.
+ */
+static struct pcontainer_rq* sched_lock_rq(struct container_list* c, unsigned long* flags)
+{
+    struct pcontainer_rq* rq;
+
+    for(;;)
+    {
+        rq = READ_ONCE(c->rq);
+        spin_lock_irqsave(&rq->lock, *flags);
+        if(rq == READ_ONCE(c->rq))
+            return rq;
+        spin_unlock_irqrestore(&rq->lock, *flags);
+    }
+}
+
+/**
+ * Pick the home run queue of a container: the least loaded run queue among
+ * the online cpus it is allowed on. Called with c->lock held or before the
+ * container is visible.
+ */
+struct pcontainer_rq* sched_select_rq(struct container_list* c)
+{
+    struct pcontainer_rq* rq;
+    struct pcontainer_rq* best = NULL;
+    unsigned int load, best_load = UINT_MAX;
+    int cpu;
+
+    for_each_cpu_and(cpu, &c->allowed, cpu_online_mask)
+    {
+        rq = per_cpu_ptr(&pcontainer_rqs, cpu);
+        load = READ_ONCE(rq->nr_running) + READ_ONCE(rq->nr_queued);
+        if(load < best_load)
+        {
+            best = rq;
+            best_load = load;
+            if(load == 0)
+                break;
+        }
+    }
+    if(best == NULL) // the allowed cpus went offline
+        best = raw_cpu_ptr(&pcontainer_rqs);
+    return best;
+}
+
+/**
+ * Position of an entity in its timeline, see pcontainer_policy_key().
+ */
+static inline u64 entity_key(struct pcontainer_entity* se)
+{
+    return pcontainer_policy_key(se->vruntime, se->sched_class);
+}
+
+/**
+ * Timeline an entity of run queue rq waits in: the one of its group on rq,
+ * or the one of rq at the top of the tree.
+ */
+static inline struct pcontainer_timeline* entity_timeline(struct pcontainer_rq* rq, struct pcontainer_entity* se)
+{
+    return se->parent != NULL ? &se->parent->timeline : &rq->timeline;
+}
+
+/**
+ * Insert an entity into a timeline, O(log n). Called with rq->lock held.
+ */
+static void timeline_insert(struct pcontainer_timeline* tl, struct pcontainer_entity* se)
+{
+    struct rb_node** link = &tl->root.rb_node;
+    struct rb_node* parent = NULL;
+    bool leftmost = true;
+
+    while(*link != NULL)
+    {
+        parent = *link;
+        if(pcontainer_policy_before(entity_key(se), entity_key(rb_entry(parent, struct pcontainer_entity, run_node))))
+        {
+            link = &parent->rb_left;
+        }
+        else
+        {
+            link = &parent->rb_right;
+            leftmost = false;
+        }
+    }
+    if(leftmost)
+        tl->leftmost = &se->run_node;
+    rb_link_node(&se->run_node, parent, link);
+    rb_insert_color(&se->run_node, &tl->root);
+    tl->nr_queued++;
+}
+
+/**
+ * Remove an entity from a timeline. Called with rq->lock held.
+ */
+static void timeline_erase(struct pcontainer_timeline* tl, struct pcontainer_entity* se)
+{
+    if(tl->leftmost == &se->run_node)
+        tl->leftmost = rb_next(&se->run_node);
+    rb_erase(&se->run_node, &tl->root);
+    RB_CLEAR_NODE(&se->run_node);
+    tl->nr_queued--;
+}
+
+/**
+ * Insert a container waiting for a slot into the timeline of its group, and
+ * the groups above it that had nothing waiting into theirs, O(depth log n).
+ * Called with rq->lock and c->lock held.
+ */
+static void timeline_enqueue(struct pcontainer_rq* rq, struct container_list* c)
+{
+    struct pcontainer_entity* se = &c->se;
+    struct pcontainer_timeline* tl;
+
+    for(;;)
+    {
+        tl = entity_timeline(rq, se);
+        timeline_insert(tl, se);
+        if(tl->nr_queued > 1 || se->parent == NULL)
+            break;
+        // the group waits again, it earns no credit for the time it was idle
+        se = &se->parent->se;
+        tl = entity_timeline(rq, se);
+        if(pcontainer_policy_before(se->vruntime, tl->min_vruntime))
+            se->vruntime = tl->min_vruntime;
+    }
+    rq->nr_queued++;
+}
+
+/**
+ * Remove a container from the timeline of its group, and the groups above it
+ * that have nothing else waiting from theirs. Called with rq->lock held.
+ */
+static void timeline_dequeue(struct pcontainer_rq* rq, struct container_list* c)
+{
+    struct pcontainer_entity* se = &c->se;
+    struct pcontainer_timeline* tl;
+
+    for(;;)
+    {
+        tl = entity_timeline(rq, se);
+        timeline_erase(tl, se);
+        if(tl->nr_queued > 0 || se->parent == NULL)
+            break;
+        se = &se->parent->se;
+    }
+    rq->nr_queued--;
+}
+
+/**
+ * The waiting container to run next: the leftmost entity of the timeline of
+ * rq and, while that is a group, of the timeline of the group, O(depth).
+ * NULL if nothing waits. Called with rq->lock held.
+ */
+static struct container_list* timeline_first(struct pcontainer_rq* rq)
+{
+    struct pcontainer_timeline* tl = &rq->timeline;
+    struct pcontainer_entity* se;
+
+    for(;;)
+    {
+        if(tl->leftmost == NULL)
+            return NULL;
+        se = rb_entry(tl->leftmost, struct pcontainer_entity, run_node);
+        if(se->group == NULL)
+            return container_of(se, struct container_list, se);
+        tl = &se->group->timeline;
+    }
+}
+
+/**
+ * The waiting container at the far end of the subtree of a waiting entity.
+ * A waiting group always has a waiting child.
+ */
+static struct container_list* entity_last(struct pcontainer_entity* se)
+{
+    while(se->group != NULL)
+        se = rb_entry(rb_last(&se->group->timeline.root), struct pcontainer_entity, run_node);
+    return container_of(se, struct container_list, se);
+}
+
+/**
+ * The waiting container that would run last, NULL if nothing waits.
+ * Called with rq->lock held.
+ */
+static struct container_list* timeline_last(struct pcontainer_rq* rq)
+{
+    struct rb_node* node = rb_last(&rq->timeline.root);
+
+    return node != NULL ? entity_last(rb_entry(node, struct pcontainer_entity, run_node)) : NULL;
+}
+
+/**
+ * The waiting container that would run right before c, NULL if c is the
+ * first. Called with rq->lock held.
+ */
+static struct container_list* timeline_prev(struct container_list* c)
+{
+    struct pcontainer_entity* se = &c->se;
+    struct rb_node* node;
+
+    while((node = rb_prev(&se->run_node)) == NULL)
+    {
+        if(se->parent == NULL)
+            return NULL;
+        se = &se->parent->se;
+    }
+    return entity_last(rb_entry(node, struct pcontainer_entity, run_node));
+}
+
+/**
+ * Remember the cpu time an active thread used until it stopped being active,
+ * for the next charge of its container. Called with c->lock held.
+ */
+void container_runtime_stop(struct container_list* c, struct thread_list* t)
+{
+    u64 runtime = READ_ONCE(t->thread->se.sum_exec_runtime);
+
+    if(runtime > t->runtime_seen)
+        c->runtime_pending += runtime - t->runtime_seen;
+    t->runtime_seen = runtime;
+}
+
+/**
+ * The cpu time the threads of a container used since its last charge. The
+ * runtime of a thread running on another cpu lags by up to a scheduler
+ * tick, the next charge gets the rest. Called with c->lock held.
+ */
+static u64 sched_runtime(struct container_list* c)
+{
+    struct thread_list* t;
+    u64 runtime;
+
+    list_for_each_entry(t, &c->threads, entry)
+    {
+        if(!t->active)
+            break;
+        container_runtime_stop(c, t);
+    }
+    runtime = c->runtime_pending;
+    c->runtime_pending = 0;
+    return runtime;
+}
+
+/**
+ * Charge the time a running container held its slot since the last charge
+ * to its virtual time, and the cpu time its threads used in it to its quota
+ * and statistics. Called with c->lock held.
+ */
+static void sched_charge(struct container_list* c, u64 now)
+{
+    u64 delta = now - c->exec_start;
+    u64 runtime = sched_runtime(c);
+
+    c->exec_start = now;
+    c->se.vruntime = pcontainer_policy_charge(c->se.vruntime, delta, c->shares);
+    // the groups are charged under rq->lock, see sched_charge_groups()
+    if(c->group != NULL)
+        c->group_delta += delta;
+    // a thread that sleeps through its turn holds the slot but uses no cpu time
+    stats_charge(c, runtime);
+    if(c->quota_ns != 0)
+        c->quota_used += runtime;
+}
+
+/**
+ * Charge the groups of a container on rq with the runtime the container was
+ * charged since, at their own shares, and keep the waiting ones in order.
+ * Called with rq->lock and c->lock held, c is on rq.
+ */
+static void sched_charge_groups(struct pcontainer_rq* rq, struct container_list* c)
+{
+    struct pcontainer_group_rq* g;
+    struct pcontainer_timeline* tl;
+    bool queued;
+
+    if(c->group_delta == 0)
+        return;
+    for(g = c->se.parent; g != NULL; g = g->se.parent)
+    {
+        tl = entity_timeline(rq, &g->se);
+        queued = !RB_EMPTY_NODE(&g->se.run_node);
+        if(queued)
+            timeline_erase(tl, &g->se);
+        g->se.vruntime = pcontainer_policy_charge(g->se.vruntime, c->group_delta, READ_ONCE(g->tg->shares));
+        if(queued)
+            timeline_insert(tl, &g->se);
+    }
+    c->group_delta = 0;
+}
+
+/**
+ * Whether running container c gives its slot to waiting container next at
+ * the end of its quantum. They are compared where their paths up the tree
+ * meet: as children of the same group, or at the top. Called with rq->lock
+ * and c->lock held, both are on rq.
+ */
+static bool sched_preempt(struct container_list* c, struct container_list* next)
+{
+    struct pcontainer_entity* a = &c->se;
+    struct pcontainer_entity* b = &next->se;
+
+    while(a->depth > b->depth)
+        a = &a->parent->se;
+    while(b->depth > a->depth)
+        b = &b->parent->se;
+    while(a->parent != b->parent)
+    {
+        a = &a->parent->se;
+        b = &b->parent->se;
+    }
+    return pcontainer_policy_preempt(entity_key(a), entity_key(b),
+                                     pcontainer_policy_boosted(c->nr_boosted, c->boost_start, ktime_get_ns()));
+}
+
+/**
+ * Wake a thread for its turn and remember when, for its wakeup latency, how
+ * often it slept so far, for the quantum of its container, and its runtime,
+ * for the quota. Called with c->lock held.
+ */
+static void container_wake(struct thread_list* t)
+{
+    t->wake_ns = ktime_get_ns();
+    t->nvcsw = READ_ONCE(t->thread->nvcsw);
+    t->runtime_seen = READ_ONCE(t->thread->se.sum_exec_runtime);
+    trace_pcontainer_wakeup(t->container, t->thread);
+    wake_up_process(t->thread);
+}
+
+/**
+ * Wake the active threads of a container that got a slot.
+ * Called with c->lock held.
+ */
+static void container_wake_active(struct container_list* c)
+{
+    struct thread_list* t;
+
+    list_for_each_entry(t, &c->threads, entry)
+    {
+        if(!t->active)
+            break;
+        container_wake(t);
+    }
+}
+
+/**
+ * Ask the active threads of a container that lost its slot to park.
+ * Called with c->lock held.
+ */
+void container_park_active(struct container_list* c)
+{
+    struct thread_list* t;
+
+    list_for_each_entry(t, &c->threads, entry)
+    {
+        if(!t->active)
+            break;
+        container_park(t);
+    }
+}
+
+/**
+ * Take the slot away from a running container. Called with rq->lock and
+ * c->lock held.
+ */
+static void sched_stop_running(struct pcontainer_rq* rq, struct container_list* c)
+{
+    sched_charge_groups(rq, c);
+    c->running = false;
+    list_del(&c->run_entry);
+    rq->nr_running--;
+    container_park_active(c);
+    stats_threads(c);
+}
+
+/**
+ * Give a free slot to a container and let its active threads run.
+ * Called with rq->lock held.
+ */
+static void sched_grant(struct pcontainer_rq* rq, struct container_list* c)
+{
+    spin_lock(&c->lock);
+    c->running = true;
+    c->exec_start = ktime_get_ns();
+    list_add_tail(&c->run_entry, &rq->running);
+    rq->nr_running++;
+    container_wake_active(c);
+    container_tick_start(c);
+    stats_switch(c);
+    stats_threads(c);
+    spin_unlock(&c->lock);
+}
+
+/**
+ * Remove the queued container with the smallest virtual time from the
+ * timeline, NULL if nothing waits. Called with rq->lock held.
+ */
+static struct container_list* sched_pick(struct pcontainer_rq* rq)
+{
+    struct container_list* next = timeline_first(rq);
+    struct pcontainer_timeline* tl;
+    struct pcontainer_entity* se;
+
+    if(next == NULL)
+        return NULL;
+    // every level of the tree moves on to the entity picked from it
+    for(se = &next->se; se != NULL; se = se->parent != NULL ? &se->parent->se : NULL)
+    {
+        tl = entity_timeline(rq, se);
+        if(pcontainer_policy_before(tl->min_vruntime, se->vruntime))
+            tl->min_vruntime = se->vruntime;
+    }
+    timeline_dequeue(rq, next);
+    return next;
+}
+
+/**
+ * Give latency container c the slot of the running batch container that is
+ * furthest behind it, if any, without waiting for its tick. Returns whether
+ * c got a slot. Called with rq->lock held.
+ */
+static bool sched_wakeup_preempt(struct pcontainer_rq* rq, struct container_list* c)
+{
+    struct container_list* r;
+    struct container_list* victim = NULL;
+    u64 now = ktime_get_ns();
+
+    list_for_each_entry(r, &rq->running, run_entry)
+    {
+        spin_lock(&r->lock);
+        sched_charge(r, now);
+        if(pcontainer_policy_wakeup_preempt(r->se.sched_class, r->se.vruntime, c->se.sched_class, c->se.vruntime,
+                                            pcontainer_policy_boosted(r->nr_boosted, r->boost_start, now)) &&
+           (victim == NULL || pcontainer_policy_before(victim->se.vruntime, r->se.vruntime)))
+            victim = r;
+        spin_unlock(&r->lock);
+    }
+    if(victim == NULL)
+        return false;
+    spin_lock(&victim->lock);
+    sched_stop_running(rq, victim);
+    timeline_enqueue(rq, victim);
+    spin_unlock(&victim->lock);
+    sched_grant(rq, c);
+    return true;
+}
+
+/**
+ * Let a container take a free slot of its run queue, or the slot of a batch
+ * container if it is a latency container, or wait in the timeline for a
+ * running container to reach the end of its quantum.
+ * Called with rq->lock held.
+ */
+static void sched_place(struct pcontainer_rq* rq, struct container_list* c)
+{
+    struct container_list* r;
+
+    if(rq->nr_running < rq->nr_slots)
+    {
+        sched_grant(rq, c);
+        return;
+    }
+    // the batch container that lost its slot waits in the timeline instead
+    if(READ_ONCE(c->se.sched_class) != PCONTAINER_CLASS_LATENCY || !sched_wakeup_preempt(rq, c))
+    {
+        spin_lock(&c->lock);
+        timeline_enqueue(rq, c);
+        spin_unlock(&c->lock);
+    }
+    // running containers without threads to rotate need a tick from now on
+    if(rq->nr_queued == 1)
+    {
+        list_for_each_entry(r, &rq->running, run_entry)
+        {
+            spin_lock(&r->lock);
+            container_tick_start(r);
+            spin_unlock(&r->lock);
+        }
+    }
+}
+
+/**
+ * Take a container off its run queue and hand its slot to the next waiting
+ * container. Returns whether the slot stayed free.
+ * Called with rq->lock held.
+ */
+static bool sched_remove(struct pcontainer_rq* rq, struct container_list* c)
+{
+    struct container_list* next;
+
+    spin_lock(&c->lock);
+    if(c->running)
+    {
+        sched_stop_running(rq, c);
+        spin_unlock(&c->lock);
+        next = sched_pick(rq);
+        if(next == NULL)
+            return true;
+        sched_grant(rq, next);
+        return false;
+    }
+    if(!RB_EMPTY_NODE(&c->se.run_node))
+        timeline_dequeue(rq, c);
+    spin_unlock(&c->lock);
+    return false;
+}
+
+/**
+ * Queue a container that is on no run queue yet on its home run queue, lag
+ * ahead of the virtual time of that run queue.
+ */
+static void sched_enqueue(struct container_list* c, u64 lag)
+{
+    struct pcontainer_rq* rq;
+    unsigned long flags;
+    bool idle;
+
+    rq = sched_lock_rq(c, &flags);
+    spin_lock(&c->lock);
+    // a dead or throttled container stays off, one already queued by a racing move stays where it is
+    idle = !c->dead && !c->throttled && !c->running && RB_EMPTY_NODE(&c->se.run_node);
+    if(idle)
+    {
+        // it waits among the containers of its group on rq
+        c->se.parent = c->group != NULL ? per_cpu_ptr(c->group->rqs, rq->cpu) : NULL;
+        c->se.vruntime = entity_timeline(rq, &c->se)->min_vruntime + lag;
+    }
+    spin_unlock(&c->lock);
+    if(idle)
+        sched_place(rq, c);
+    spin_unlock_irqrestore(&rq->lock, flags);
+}
+
+/**
+ * A slot of run queue dst is free and nothing waits for it: take a waiting
+ * container from the far end of the timeline of the busiest run queue, the
+ * one that would wait there the longest. It has to be allowed on the cpu of
+ * dst, stay in its home domain if it is placed and not have run so recently
+ * that its cache is still warm. Called without run queue locks.
+ */
+static void sched_steal(struct pcontainer_rq* dst)
+{
+    struct pcontainer_rq* rq;
+    struct pcontainer_rq* src = NULL;
+    struct container_list* c = NULL;
+    struct container_list* cand;
+    unsigned int n, busiest = 0;
+    unsigned long flags;
+    u64 now, cost = (u64)READ_ONCE(migration_cost_us) * NSEC_PER_USEC;
+    u64 lag = 0;
+    int cpu, scan = PCONTAINER_STEAL_SCAN;
+
+    if(!READ_ONCE(steal))
+        return;
+    for_each_online_cpu(cpu)
+    {
+        rq = per_cpu_ptr(&pcontainer_rqs, cpu);
+        n = READ_ONCE(rq->nr_queued);
+        if(rq != dst && n > busiest)
+        {
+            src = rq;
+            busiest = n;
+        }
+    }
+    if(src == NULL)
+        return;
+
+    // the stolen container may die once src is unlocked
+    rcu_read_lock();
+    spin_lock_irqsave(&src->lock, flags);
+    now = ktime_get_ns();
+    for(cand = timeline_last(src); cand != NULL && scan-- > 0; cand = timeline_prev(cand))
+    {
+        spin_lock(&cand->lock);
+        if(cpumask_test_cpu(dst->cpu, &cand->allowed) &&
+           (cand->placement == PCONTAINER_PLACE_OFF || cpumask_test_cpu(dst->cpu, &cand->home)) &&
+           now - cand->exec_start >= cost)
+        {
+            c = cand;
+            break;
+        }
+        spin_unlock(&cand->lock);
+    }
+    if(c != NULL) // c->lock is held
+    {
+        lag = pcontainer_policy_lag(c->se.vruntime, entity_timeline(src, &c->se)->min_vruntime);
+        timeline_dequeue(src, c);
+        WRITE_ONCE(c->rq, dst);
+        container_set_home(c);
+        spin_unlock(&c->lock);
+    }
+    spin_unlock_irqrestore(&src->lock, flags);
+
+    if(c != NULL)
+        sched_enqueue(c, lag);
+    rcu_read_unlock();
+}
+
+/**
+ * A new container asks its home run queue for a slot. It starts at the
+ * virtual time of the run queue so that it neither starves the others nor
+ * has to wait for them to catch up.
+ */
+void sched_container_enter(struct container_list* c)
+{
+    sched_enqueue(c, 0);
+}
+
+/**
+ * A dead container leaves its run queue, its slot goes to the next one or
+ * to a container stolen from another run queue.
+ */
+void sched_container_exit(struct container_list* c)
+{
+    struct pcontainer_rq* rq;
+    unsigned long flags;
+    bool free;
+
+    rq = sched_lock_rq(c, &flags);
+    free = sched_remove(rq, c);
+    spin_unlock_irqrestore(&rq->lock, flags);
+    if(free)
+        sched_steal(rq);
+}
+
+/**
+ * Move a container to another home run queue. It keeps how far it is ahead
+ * of the virtual time of its run queue, but no credit for being behind.
+ */
+static void sched_migrate(struct container_list* c, struct pcontainer_rq* dst)
+{
+    struct pcontainer_rq* rq;
+    unsigned long flags;
+    bool free;
+    u64 lag;
+
+    rq = sched_lock_rq(c, &flags);
+    if(rq == dst)
+    {
+        spin_unlock_irqrestore(&rq->lock, flags);
+        return;
+    }
+    spin_lock(&c->lock);
+    if(c->running)
+        sched_charge(c, ktime_get_ns());
+    lag = pcontainer_policy_lag(c->se.vruntime, entity_timeline(rq, &c->se)->min_vruntime);
+    spin_unlock(&c->lock);
+    free = sched_remove(rq, c);
+    spin_lock(&c->lock);
+    WRITE_ONCE(c->rq, dst);
+    container_set_home(c);
+    spin_unlock(&c->lock);
+    spin_unlock_irqrestore(&rq->lock, flags);
+
+    sched_enqueue(c, lag);
+    if(free)
+        sched_steal(rq);
+}
+
+/**
+ * End of the quantum of a container: charge it and hand its slot to the
+ * waiting container with the smallest virtual time if c got ahead of it,
+ * or to anyone waiting if c used up its quota.
+ */
+void sched_tick(struct container_list* c)
+{
+    struct pcontainer_rq* rq;
+    struct container_list* next;
+    unsigned long flags;
+    bool free = false;
+
+    // nobody waits for a slot on the run queue and no quota, its lock is not needed
+    if(READ_ONCE(READ_ONCE(c->rq)->nr_queued) == 0 && READ_ONCE(c->quota_ns) == 0)
+    {
+        spin_lock_irqsave(&c->lock, flags);
+        if(c->running)
+            sched_charge(c, ktime_get_ns());
+        spin_unlock_irqrestore(&c->lock, flags);
+        return;
+    }
+
+    rq = sched_lock_rq(c, &flags);
+    spin_lock(&c->lock);
+    if(!c->running)
+    {
+        spin_unlock(&c->lock);
+        goto out;
+    }
+    sched_charge(c, ktime_get_ns());
+    // off the run queue until container_period() refills the quota
+    if(c->quota_ns != 0 && c->quota_used >= c->quota_ns)
+    {
+        sched_stop_running(rq, c);
+        c->throttled = true;
+        c->throttle_start = ktime_get_ns();
+        spin_unlock(&c->lock);
+        next = sched_pick(rq);
+        if(next != NULL)
+            sched_grant(rq, next);
+        else
+            free = true;
+        goto out;
+    }
+    sched_charge_groups(rq, c);
+    next = timeline_first(rq);
+    // an owner of a contended lock keeps the slot until it unlocks
+    if(next == NULL || !sched_preempt(c, next))
+    {
+        spin_unlock(&c->lock);
+        goto out;
+    }
+    sched_stop_running(rq, c);
+    timeline_enqueue(rq, c);
+    spin_unlock(&c->lock);
+    sched_grant(rq, sched_pick(rq));
+out:
+    spin_unlock_irqrestore(&rq->lock, flags);
+    if(free)
+        sched_steal(rq);
+}
+
+/**
+ * Put a throttled container whose quota was refilled or lifted back on its
+ * run queue. It keeps how far it is ahead of the virtual time of the run
+ * queue, so the others catch up on the time it used.
+ */
+static void sched_unthrottle(struct container_list* c)
+{
+    struct pcontainer_rq* rq;
+    unsigned long flags;
+    bool wake;
+    u64 lag = 0;
+
+    rq = sched_lock_rq(c, &flags);
+    spin_lock(&c->lock);
+    wake = c->throttled && (c->quota_ns == 0 || c->quota_used < c->quota_ns);
+    if(wake)
+    {
+        c->throttled = false;
+        stats_throttle(c, ktime_get_ns() - c->throttle_start);
+        lag = pcontainer_policy_lag(c->se.vruntime, entity_timeline(rq, &c->se)->min_vruntime);
+    }
+    spin_unlock(&c->lock);
+    spin_unlock_irqrestore(&rq->lock, flags);
+
+    if(wake)
+        sched_enqueue(c, lag);
+}
+
+/**
+ * hrtimer callback at the start of each period of a container with a quota:
+ * refill the quota and let the container run again if it was throttled.
+ */
+static enum hrtimer_restart container_period(struct hrtimer* timer)
+{
+    struct container_list* c = container_of(timer, struct container_list, period);
+    enum hrtimer_restart ret = HRTIMER_NORESTART;
+
+    spin_lock(&c->lock);
+    // an overrun of the last period, e.g. until the next tick, is paid from this one
+    c->quota_used = c->quota_used > c->quota_ns ? c->quota_used - c->quota_ns : 0;
+    // container_set_quota() re-armed the timer while we waited for the lock
+    if(!c->dead && c->quota_ns != 0 && !hrtimer_is_queued(timer))
+    {
+        hrtimer_forward_now(timer, ns_to_ktime(c->period_ns));
+        ret = HRTIMER_RESTART;
+    }
+    spin_unlock(&c->lock);
+
+    sched_unthrottle(c);
+    return ret;
+}
+
+/**
+ * Initialize the quota of a new container: none.
+ */
+void sched_quota_init(struct container_list* c)
+{
+    c->quota_ns = 0;
+    c->period_ns = 0;
+    c->quota_used = 0;
+    c->throttled = false;
+    hrtimer_init(&c->period, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+    c->period.function = container_period;
+}
+
+/**
+ * Make the first width threads of the run queue the active ones: wake the
+ * ones that just became active and park the ones beyond the width.
+ * Called with c->lock held.
+ */
+void container_refill(struct container_list* c)
+{
+    struct thread_list* t;
+    unsigned int n = 0;
+
+    list_for_each_entry(t, &c->threads, entry)
+    {
+        if(n++ < c->width)
+        {
+            if(!t->active)
+            {
+                t->active = true;
+                if(c->running)
+                    container_wake(t);
+            }
+        }
+        else if(t->active)
+        {
+            container_runtime_stop(c, t);
+            t->active = false;
+            if(c->running)
+                container_park(t);
+        }
+        else
+        {
+            break; // the active threads are at the head of the run queue
+        }
+    }
+    stats_threads(c);
+}
+
+/**
+ * Move an active thread to the tail of the run queue of its container.
+ * Called with c->lock held, container_refill() picks its successor.
+ */
+static void container_requeue(struct container_list* c, struct thread_list* t)
+{
+    list_move_tail(&t->entry, &c->threads);
+    container_runtime_stop(c, t);
+    t->active = false;
+    stats_switch(c);
+    trace_pcontainer_switch_out(c, t->thread);
+    // a container without a slot already asked its threads to park
+    if(c->running)
+        container_park(t);
+}
+
+/**
+ * Hand the processor of active thread t to the first waiting thread of its
+ * container. Called with c->lock held.
+ */
+void container_yield(struct container_list* c, struct thread_list* t)
+{
+    container_requeue(c, t);
+    container_refill(c);
+}
+
+/**
+ * End the quantum of the active threads of a container that has more
+ * threads than its width; as many waiting threads as possible take over.
+ * Not while an owner of a contended lock runs. Called with c->lock held.
+ */
+void container_rotate(struct container_list* c)
+{
+    unsigned int n = pcontainer_policy_rotate(c->nr_threads, c->width);
+
+    if(c->nr_boosted > 0)
+        return;
+    while(n-- > 0)
+        container_requeue(c, list_first_entry(&c->threads, struct thread_list, entry));
+    container_refill(c);
+}
+
+/**
+ * Set the shares of container cid.
+ */
+int container_set_shares(struct pcontainer_namespace* ns, __u64 cid, __u64 shares)
+{
+    struct container_list* c;
+    int ret = -ENOENT;
+
+    if(shares == 0 || shares > PCONTAINER_MAX_SHARES)
+        return -EINVAL;
+
+    rcu_read_lock();
+    c = container_lookup(ns, cid);
+    if(c != NULL)
+    {
+        spin_lock_irq(&c->lock);
+        if(!c->dead)
+        {
+            // the runtime so far is charged at the old rate
+            if(c->running)
+                sched_charge(c, ktime_get_ns());
+            c->shares = shares;
+            ret = 0;
+        }
+        spin_unlock_irq(&c->lock);
+    }
+    rcu_read_unlock();
+    return ret;
+}
+
+/**
+ * Set the shares of container cmd.cid to cmd.op.
+ */
+int processor_container_shares(struct pcontainer_namespace* ns, struct processor_container_cmd __user *user_cmd)
+{
+    struct processor_container_cmd kernel_cmd;
+
+    if(copy_from_user(&kernel_cmd, user_cmd, sizeof(kernel_cmd)))
+        return -EFAULT;
+    return container_set_shares(ns, kernel_cmd.cid, kernel_cmd.op);
+}
+
+/**
+ * Restrict container cid to the cpus in mask cpus. The container moves to
+ * another run queue if its home cpu is no longer allowed, its threads apply
+ * the mask the next time they pass container_wait_turn().
+ */
+int container_set_affinity(struct pcontainer_namespace* ns, __u64 cid, __u64 cpus)
+{
+    struct container_list* c;
+    struct pcontainer_rq* dst = NULL;
+    cpumask_var_t mask;
+    int cpu, ret = -ENOENT;
+
+    if(!alloc_cpumask_var(&mask, GFP_KERNEL))
+        return -ENOMEM;
+    if(cpus == 0)
+    {
+        cpumask_copy(mask, cpu_possible_mask);
+    }
+    else
+    {
+        cpumask_clear(mask);
+        for(cpu = 0; cpu < 64 && cpu < nr_cpu_ids; cpu++)
+        {
+            if(cpus & (1ULL << cpu))
+                cpumask_set_cpu(cpu, mask);
+        }
+    }
+    if(!cpumask_intersects(mask, cpu_online_mask))
+    {
+        ret = -EINVAL;
+        goto out;
+    }
+
+    rcu_read_lock();
+    c = container_lookup(ns, cid);
+    if(c != NULL)
+    {
+        spin_lock_irq(&c->lock);
+        if(!c->dead)
+        {
+            cpumask_copy(&c->allowed, mask);
+            c->affinity_seq++;
+            container_set_home(c);
+            // send the active threads through container_wait_turn()
+            if(c->running)
+                container_park_active(c);
+            if(!cpumask_test_cpu(c->rq->cpu, &c->allowed))
+                dst = sched_select_rq(c);
+            ret = 0;
+        }
+        spin_unlock_irq(&c->lock);
+        if(dst != NULL)
+            sched_migrate(c, dst);
+    }
+    rcu_read_unlock();
+out:
+    free_cpumask_var(mask);
+    return ret;
+}
+
+/**
+ * Restrict container cmd.cid to the cpus in mask cmd.op.
+ */
+int processor_container_affinity(struct pcontainer_namespace* ns, struct processor_container_cmd __user *user_cmd)
+{
+    struct processor_container_cmd kernel_cmd;
+
+    if(copy_from_user(&kernel_cmd, user_cmd, sizeof(kernel_cmd)))
+        return -EFAULT;
+    return container_set_affinity(ns, kernel_cmd.cid, kernel_cmd.op);
+}
+
+/**
+ * Let width threads of container cid run at the same time.
+ */
+int container_set_width(struct pcontainer_namespace* ns, __u64 cid, __u64 width)
+{
+    struct container_list* c;
+    int ret = -ENOENT;
+
+    if(width == 0 || width > PCONTAINER_MAX_WIDTH)
+        return -EINVAL;
+
+    rcu_read_lock();
+    c = container_lookup(ns, cid);
+    if(c != NULL)
+    {
+        spin_lock_irq(&c->lock);
+        if(!c->dead)
+        {
+            c->width = width;
+            container_refill(c);
+            container_tick_start(c);
+            ret = 0;
+        }
+        spin_unlock_irq(&c->lock);
+    }
+    rcu_read_unlock();
+    return ret;
+}
+
+/**
+ * Let cmd.op threads of container cmd.cid run at the same time.
+ */
+int processor_container_width(struct pcontainer_namespace* ns, struct processor_container_cmd __user *user_cmd)
+{
+    struct processor_container_cmd kernel_cmd;
+
+    if(copy_from_user(&kernel_cmd, user_cmd, sizeof(kernel_cmd)))
+        return -EFAULT;
+    return container_set_width(ns, kernel_cmd.cid, kernel_cmd.op);
+}
+
+/**
+ * Let container cid run at most quota_us of each period_us, encoded by
+ * PCONTAINER_QUOTA(). A quota of 0 lifts the limit. The new quota starts
+ * with a full period.
+ */
+int container_set_quota(struct pcontainer_namespace* ns, __u64 cid, __u64 quota)
+{
+    struct container_list* c;
+    u64 quota_ns = (u64)(u32)quota * NSEC_PER_USEC;
+    u64 period_ns = (quota >> 32) * NSEC_PER_USEC;
+    int ret = -ENOENT;
+
+    if(quota_ns != 0 && (period_ns < PCONTAINER_MIN_PERIOD_US * NSEC_PER_USEC ||
+                         period_ns > PCONTAINER_MAX_PERIOD_US * NSEC_PER_USEC))
+        return -EINVAL;
+
+    rcu_read_lock();
+    c = container_lookup(ns, cid);
+    if(c != NULL)
+    {
+        spin_lock_irq(&c->lock);
+        if(!c->dead)
+        {
+            // the runtime so far counts against the old quota
+            if(c->running)
+                sched_charge(c, ktime_get_ns());
+            c->quota_ns = quota_ns;
+            c->period_ns = period_ns;
+            c->quota_used = 0;
+            if(quota_ns != 0)
+            {
+                hrtimer_start(&c->period, ns_to_ktime(period_ns), HRTIMER_MODE_REL);
+                container_tick_start(c);
+            }
+            ret = 0;
+        }
+        spin_unlock_irq(&c->lock);
+        if(ret == 0)
+            sched_unthrottle(c);
+    }
+    rcu_read_unlock();
+    return ret;
+}
+
+/**
+ * Set the quota of container cmd.cid to cmd.op, see PCONTAINER_IOCTL_QUOTA.
+ */
+int processor_container_quota(struct pcontainer_namespace* ns, struct processor_container_cmd __user *user_cmd)
+{
+    struct processor_container_cmd kernel_cmd;
+
+    if(copy_from_user(&kernel_cmd, user_cmd, sizeof(kernel_cmd)))
+        return -EFAULT;
+    return container_set_quota(ns, kernel_cmd.cid, kernel_cmd.op);
+}
+
+/**
+ * Put container cid in scheduling class sched_class. A waiting container
+ * moves to its new place in the timeline.
+ */
+int container_set_class(struct pcontainer_namespace* ns, __u64 cid, __u64 sched_class)
+{
+    struct container_list* c;
+    struct pcontainer_rq* rq;
+    unsigned long flags;
+    bool queued;
+    int ret = -ENOENT;
+
+    if(sched_class != PCONTAINER_CLASS_BATCH && sched_class != PCONTAINER_CLASS_LATENCY)
+        return -EINVAL;
+
+    rcu_read_lock();
+    c = container_lookup(ns, cid);
+    if(c != NULL)
+    {
+        rq = sched_lock_rq(c, &flags);
+        spin_lock(&c->lock);
+        if(!c->dead)
+        {
+            queued = !RB_EMPTY_NODE(&c->se.run_node);
+            if(queued)
+                timeline_dequeue(rq, c);
+            c->se.sched_class = sched_class;
+            if(queued)
+                timeline_enqueue(rq, c);
+            ret = 0;
+        }
+        spin_unlock(&c->lock);
+        spin_unlock_irqrestore(&rq->lock, flags);
+    }
+    rcu_read_unlock();
+    return ret;
+}
+
+/**
+ * Put container cmd.cid in scheduling class cmd.op.
+ */
+int processor_container_class(struct pcontainer_namespace* ns, struct processor_container_cmd __user *user_cmd)
+{
+    struct processor_container_cmd kernel_cmd;
+
+    if(copy_from_user(&kernel_cmd, user_cmd, sizeof(kernel_cmd)))
+        return -EFAULT;
+    return container_set_class(ns, kernel_cmd.cid, kernel_cmd.op);
+}
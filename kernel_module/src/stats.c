@@ -0,0 +1,565 @@
+//////////////////////////////////////////////////////////////////////
+//                      North Carolina State University
+//
+//
+//
+//                             Copyright 2016
+//
+////////////////////////////////////////////////////////////////////////
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms and conditions of the GNU General Public License,
+// version 2, as published by the Free Software Foundation.
+//
+// This program is distributed in the hope it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+//
+////////////////////////////////////////////////////////////////////////
+//
+//   Author:  Hung-Wei Tseng, Yu-Chia Liu
+//
+//
+//   Description:
+//     Statistics of Processor Container: counters of every container in
+//     memory the processes of its namespace map read-only, and a text view
+//     of all namespaces in debugfs. A second mapping publishes which threads
+//     hold a turn and when it ends, so user space can skip switches that
+//     would not change anything
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "processor_container.h"
+#include "container.h"
+
+#include <linux/vmalloc.h>
+#include <linux/kernel.h>
+#include <linux/errno.h>
+#include <linux/mm.h>
+#include <linux/fs.h>
+#include <linux/spinlock.h>
+#include <linux/sched.h>
+#include <linux/list.h>
+#include <linux/bitops.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/ktime.h>
+#include <linux/slab.h>
+#include <linux/pid.h>
+#include <linux/pid_namespace.h>
+
+struct pcontainer_stats_area // statistics and turns of the containers of one namespace
+{
+    struct pcontainer_stats_page* stats_page; // shared with the processes of the namespace
+    struct pcontainer_turn_page* turn_page; // slot i for the container of stats slot i
+    spinlock_t lock; // protects used
+    DECLARE_BITMAP(used, PCONTAINER_STATS_SLOTS);
+};
+
+static DEFINE_SPINLOCK(stats_lock); // protects stats_reaped
+static u64 stats_reaped; // threads reaped in any container, counted in debugfs
+static struct dentry* stats_dir;
+
+/*
+ * Every slot is a seqcount: its container updates it under the container
+ * lock between stats_begin() and stats_end(), readers retry while seq is odd
+ * or changed under them. Updates stay on the cache lines of the container.
+ */
+static inline void stats_begin(struct pcontainer_stats* s)
+{
+    WRITE_ONCE(s->seq, s->seq + 1);
+    smp_wmb();
+}
+
+static inline void stats_end(struct pcontainer_stats* s)
+{
+    smp_wmb();
+    WRITE_ONCE(s->seq, s->seq + 1);
+}
+
+static inline void turn_begin(struct pcontainer_turn* turn)
+{
+    WRITE_ONCE(turn->seq, turn->seq + 1);
+    smp_wmb();
+}
+
+static inline void turn_end(struct pcontainer_turn* turn)
+{
+    smp_wmb();
+    WRITE_ONCE(turn->seq, turn->seq + 1);
+}
+
+/**
+ * The turn slot of a container, NULL if it has no statistics slot.
+ */
+static inline struct pcontainer_turn* stats_turn_slot(struct container_list* c)
+{
+    struct pcontainer_stats_area* area;
+
+    if(c->stats == NULL)
+        return NULL;
+    area = c->nspace->stats;
+    return &area->turn_page->slots[c->stats - area->stats_page->slots];
+}
+
+/**
+ * Free the statistics of a namespace that is being freed.
+ */
+void stats_free(struct pcontainer_namespace* ns)
+{
+    struct pcontainer_stats_area* area = ns->stats;
+
+    if(area == NULL)
+        return;
+    vfree(area->turn_page);
+    vfree(area->stats_page);
+    kfree(area);
+}
+
+/**
+ * The statistics of namespace ns, allocated by the first container or
+ * mapping that needs them. NULL if there is no memory. May sleep.
+ */
+static struct pcontainer_stats_area* stats_area(struct pcontainer_namespace* ns)
+{
+    struct pcontainer_stats_area* area = READ_ONCE(ns->stats);
+
+    if(area != NULL)
+        return area;
+    area = kzalloc(sizeof(*area), GFP_KERNEL);
+    if(area == NULL)
+        return NULL;
+    spin_lock_init(&area->lock);
+    area->stats_page = vmalloc_user(PAGE_ALIGN(sizeof(struct pcontainer_stats_page)));
+    area->turn_page = vmalloc_user(PAGE_ALIGN(sizeof(struct pcontainer_turn_page)));
+    if(area->stats_page == NULL || area->turn_page == NULL)
+    {
+        vfree(area->turn_page);
+        vfree(area->stats_page);
+        kfree(area);
+        return NULL;
+    }
+    if(cmpxchg(&ns->stats, NULL, area) == NULL)
+        return area;
+    // another thread of the namespace allocated them meanwhile
+    vfree(area->turn_page);
+    vfree(area->stats_page);
+    kfree(area);
+    return ns->stats;
+}
+
+/**
+ * Give a new container a slot in the statistics of its namespace, it is not
+ * counted if none is free. May sleep.
+ */
+void stats_attach(struct container_list* c)
+{
+    struct pcontainer_stats_area* area = stats_area(c->nspace);
+    struct pcontainer_turn* turn;
+    struct pcontainer_stats* s;
+    unsigned long slot;
+
+    c->stats = NULL;
+    if(area == NULL)
+        return;
+    spin_lock(&area->lock);
+    slot = find_first_zero_bit(area->used, PCONTAINER_STATS_SLOTS);
+    if(slot < PCONTAINER_STATS_SLOTS)
+        __set_bit(slot, area->used);
+    spin_unlock(&area->lock);
+    if(slot >= PCONTAINER_STATS_SLOTS)
+        return;
+
+    s = &area->stats_page->slots[slot];
+    stats_begin(s);
+    s->cid = c->cid;
+    s->nsid = c->nspace->id;
+    s->cpu_ns = 0;
+    s->switches = 0;
+    s->nr_runnable = 0;
+    s->nr_sleeping = c->nr_threads;
+    s->wait_ns = 0;
+    s->wakeups = 0;
+    s->wakeup_latency_sum_ns = 0;
+    s->wakeup_latency_max_ns = 0;
+    s->nr_reaped = 0;
+    s->nr_blocks = 0;
+    s->instructions = 0;
+    s->cycles = 0;
+    s->llc_misses = 0;
+    s->branch_misses = 0;
+    s->perf_ns = 0;
+    s->in_use = 1;
+    stats_end(s);
+    c->stats = s;
+
+    // the generation keeps counting, a reader that cached the slot of the
+    // old container still sees that it changed
+    turn = &area->turn_page->slots[slot];
+    turn_begin(turn);
+    turn->cid = c->cid;
+    turn->nsid = c->nspace->id;
+    turn->generation++;
+    turn->deadline_ns = 0;
+    turn->running = 0;
+    turn->nr_active = 0;
+    turn->in_use = 1;
+    turn_end(turn);
+}
+
+/**
+ * Free the slot of a dead container. Called with c->lock held.
+ */
+void stats_detach(struct container_list* c)
+{
+    struct pcontainer_stats_area* area = c->nspace->stats;
+    struct pcontainer_turn* turn = stats_turn_slot(c);
+    struct pcontainer_stats* s = c->stats;
+
+    if(s == NULL)
+        return;
+    turn_begin(turn);
+    turn->in_use = 0;
+    turn->running = 0;
+    turn->nr_active = 0;
+    turn->generation++;
+    turn_end(turn);
+    stats_begin(s);
+    s->in_use = 0;
+    stats_end(s);
+    c->stats = NULL;
+    spin_lock(&area->lock);
+    __clear_bit(s - area->stats_page->slots, area->used);
+    spin_unlock(&area->lock);
+}
+
+/**
+ * Count a thread that exited without deleting itself. Called with c->lock
+ * held.
+ */
+void stats_reap(struct container_list* c)
+{
+    struct pcontainer_stats* s = c->stats;
+
+    spin_lock(&stats_lock);
+    stats_reaped++;
+    spin_unlock(&stats_lock);
+    if(s == NULL)
+        return;
+    stats_begin(s);
+    s->nr_reaped++;
+    stats_end(s);
+}
+
+/**
+ * Count a turn handed on because the active thread went to sleep.
+ * Called with c->lock held.
+ */
+void stats_block(struct container_list* c)
+{
+    struct pcontainer_stats* s = c->stats;
+
+    if(s == NULL)
+        return;
+    stats_begin(s);
+    s->nr_blocks++;
+    stats_end(s);
+}
+
+/**
+ * Add delta ns of cpu time of its threads to a container. Called with
+ * c->lock held.
+ */
+void stats_charge(struct container_list* c, u64 delta)
+{
+    struct pcontainer_stats* s = c->stats;
+
+    if(s == NULL)
+        return;
+    stats_begin(s);
+    s->cpu_ns += delta;
+    stats_end(s);
+}
+
+/**
+ * Count a turn handed to a thread or to the container.
+ * Called with c->lock held.
+ */
+void stats_switch(struct container_list* c)
+{
+    struct pcontainer_stats* s = c->stats;
+
+    if(s == NULL)
+        return;
+    stats_begin(s);
+    s->switches++;
+    stats_end(s);
+}
+
+/**
+ * Add the hardware events a thread counted during its turns, and the time it
+ * took to read them, to its container. Called with c->lock held.
+ */
+void stats_perf(struct container_list* c, u64* delta, u64 cost_ns)
+{
+    struct pcontainer_stats* s = c->stats;
+
+    if(s == NULL)
+        return;
+    stats_begin(s);
+    s->instructions += delta[PCONTAINER_PERF_INSTRUCTIONS];
+    s->cycles += delta[PCONTAINER_PERF_CYCLES];
+    s->llc_misses += delta[PCONTAINER_PERF_LLC_MISSES];
+    s->branch_misses += delta[PCONTAINER_PERF_BRANCH_MISSES];
+    s->perf_ns += cost_ns;
+    stats_end(s);
+}
+
+/**
+ * Publish the active threads of a container in its turn slot and bump the
+ * generation. Called with c->lock held.
+ */
+static void stats_turn(struct container_list* c)
+{
+    struct pcontainer_turn* turn = stats_turn_slot(c);
+    struct thread_list* t;
+    unsigned int n = 0;
+
+    turn_begin(turn);
+    turn->generation++;
+    turn->running = c->running;
+    turn->deadline_ns = container_tick_deadline(c);
+    if(c->running)
+    {
+        list_for_each_entry(t, &c->threads, entry)
+        {
+            if(!t->active)
+                break; // the active threads are at the head of the run queue
+            // as the processes of the namespace see them, not the global ones
+            if(n < PCONTAINER_TURN_TIDS)
+                turn->tids[n] = task_pid_nr_ns(t->thread, c->nspace->pid_ns);
+            n++;
+        }
+    }
+    turn->nr_active = n;
+    turn_end(turn);
+}
+
+/**
+ * Publish when the quantum of a container ends after its timer changed.
+ * Called with c->lock held.
+ */
+void stats_deadline(struct container_list* c)
+{
+    struct pcontainer_turn* turn = stats_turn_slot(c);
+
+    if(turn == NULL)
+        return;
+    turn_begin(turn);
+    turn->deadline_ns = container_tick_deadline(c);
+    turn_end(turn);
+}
+
+/**
+ * Publish how many threads of a container may run and how many wait, and
+ * which ones hold a turn. Called with c->lock held.
+ */
+void stats_threads(struct container_list* c)
+{
+    struct pcontainer_stats* s = c->stats;
+    unsigned int runnable = c->running ? min(c->width, c->nr_threads) : 0;
+
+    if(s == NULL)
+        return;
+    stats_begin(s);
+    s->nr_runnable = runnable;
+    s->nr_sleeping = c->nr_threads + c->nr_blocked - runnable;
+    stats_end(s);
+    stats_turn(c);
+}
+
+/**
+ * Account a thread that waited for its turn since start and the time from
+ * its wakeup to running. Called with c->lock held.
+ */
+void stats_wait(struct container_list* c, struct thread_list* t, u64 start)
+{
+    struct pcontainer_stats* s = c->stats;
+    u64 now = ktime_get_ns();
+    u64 latency;
+
+    if(s == NULL)
+        return;
+    stats_begin(s);
+    s->wait_ns += now - start;
+    if(t->wake_ns > start) // woken for this turn, not by a signal
+    {
+        latency = now - t->wake_ns;
+        s->wakeups++;
+        s->wakeup_latency_sum_ns += latency;
+        if(latency > s->wakeup_latency_max_ns)
+            s->wakeup_latency_max_ns = latency;
+    }
+    stats_end(s);
+}
+
+/**
+ * Account a container that was throttled for throttled_ns until its quota
+ * was refilled. Called with c->lock held.
+ */
+void stats_throttle(struct container_list* c, u64 throttled_ns)
+{
+    struct pcontainer_stats* s = c->stats;
+
+    if(s == NULL)
+        return;
+    stats_begin(s);
+    s->nr_throttled++;
+    s->throttled_ns += throttled_ns;
+    stats_end(s);
+}
+
+/**
+ * Publish the quantum of a container after it changed.
+ * Called with c->lock held.
+ */
+void stats_slice(struct container_list* c)
+{
+    struct pcontainer_stats* s = c->stats;
+
+    if(s == NULL)
+        return;
+    stats_begin(s);
+    s->slice_ns = c->slice_ns;
+    stats_end(s);
+}
+
+/**
+ * Map the statistics of namespace ns, or its turn slots at
+ * PCONTAINER_TURN_OFFSET, read-only into the calling process.
+ */
+int stats_mmap(struct pcontainer_namespace* ns, struct vm_area_struct* vma)
+{
+    bool turn = vma->vm_pgoff == (PCONTAINER_TURN_OFFSET >> PAGE_SHIFT);
+    size_t size = turn ? sizeof(struct pcontainer_turn_page) : sizeof(struct pcontainer_stats_page);
+    struct pcontainer_stats_area* area = ns != NULL ? stats_area(ns) : NULL;
+
+    if(area == NULL)
+        return -ENOMEM;
+    if(vma->vm_end - vma->vm_start != PAGE_ALIGN(size))
+        return -EINVAL;
+    if(vma->vm_flags & VM_WRITE)
+        return -EPERM;
+    // every process sees the same page, mprotect() must not make it writable
+#ifdef PCONTAINER_HAVE_VM_FLAGS_CLEAR
+    vm_flags_clear(vma, VM_MAYWRITE);
+#else
+    vma->vm_flags &= ~VM_MAYWRITE;
+#endif
+    return remap_vmalloc_range(vma, turn ? (void*)area->turn_page : (void*)area->stats_page, 0);
+}
+
+/**
+ * Print num * scale / den with three decimals, or - when den is 0.
+ */
+static void stats_show_ratio(struct seq_file* m, u64 num, u64 den, u64 scale)
+{
+    u64 milli;
+
+    if(den == 0)
+    {
+        seq_puts(m, " -");
+        return;
+    }
+    milli = div64_u64(num * scale * 1000, den);
+    seq_printf(m, " %llu.%03llu", div_u64(milli, 1000), milli % 1000);
+}
+
+/**
+ * Print one line per container of namespace ns.
+ */
+static void stats_show_namespace(struct pcontainer_namespace* ns, void* data)
+{
+    struct pcontainer_stats_area* area = READ_ONCE(ns->stats);
+    struct seq_file* m = data;
+    struct pcontainer_stats copy;
+    struct pcontainer_stats* s;
+    u32 seq;
+    int i;
+
+    if(area == NULL)
+        return;
+    for(i = 0; i < PCONTAINER_STATS_SLOTS; i++)
+    {
+        s = &area->stats_page->slots[i];
+        do
+        {
+            seq = READ_ONCE(s->seq);
+            smp_rmb();
+            copy = *s;
+            smp_rmb();
+        } while((seq & 1) || seq != READ_ONCE(s->seq));
+        if(!copy.in_use)
+            continue;
+        seq_printf(m, "%llu %llu %llu %llu %u %u %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu",
+                   copy.nsid, copy.cid, copy.cpu_ns, copy.switches, copy.nr_runnable, copy.nr_sleeping,
+                   copy.wait_ns, copy.wakeups,
+                   copy.wakeups ? div64_u64(copy.wakeup_latency_sum_ns, copy.wakeups) : 0,
+                   copy.wakeup_latency_max_ns, copy.nr_throttled, copy.throttled_ns,
+                   copy.slice_ns, copy.nr_reaped, copy.nr_blocks, copy.instructions, copy.cycles,
+                   copy.llc_misses, copy.branch_misses, copy.perf_ns);
+        stats_show_ratio(m, copy.instructions, copy.cycles, 1);
+        stats_show_ratio(m, copy.llc_misses, copy.instructions, 1000);
+        stats_show_ratio(m, copy.branch_misses, copy.instructions, 1000);
+        seq_putc(m, '\n');
+    }
+}
+
+/**
+ * debugfs view: one line per container of every namespace, with the
+ * instructions per cycle and the misses per thousand instructions derived
+ * from the hardware events.
+ */
+static int stats_show(struct seq_file* m, void* v)
+{
+    seq_puts(m, "nsid cid cpu_ns switches runnable sleeping wait_ns wakeups wakeup_avg_ns wakeup_max_ns throttled throttled_ns slice_ns reaped blocks"
+             " instructions cycles llc_misses branch_misses perf_ns ipc llc_mpki branch_mpki\n");
+    namespace_for_each(stats_show_namespace, m);
+    return 0;
+}
+
+static int stats_open(struct inode* inode, struct file* file)
+{
+    return single_open(file, stats_show, NULL);
+}
+
+static const struct file_operations stats_fops = {
+    .owner                = THIS_MODULE,
+    .open                 = stats_open,
+    .read                 = seq_read,
+    .llseek               = seq_lseek,
+    .release              = single_release,
+};
+
+/**
+ * Create pcontainer/stats in debugfs, the statistics of every namespace are
+ * allocated with it.
+ */
+int stats_init(void)
+{
+    // debugfs is optional, the statistics are still mapped without it
+    stats_dir = debugfs_create_dir("pcontainer", NULL);
+    debugfs_create_file("stats", 0444, stats_dir, NULL, &stats_fops);
+    debugfs_create_u64("reaped", 0444, stats_dir, &stats_reaped);
+    return 0;
+}
+
+void stats_exit(void)
+{
+    debugfs_remove_recursive(stats_dir);
+}
@@ -0,0 +1,356 @@
+//////////////////////////////////////////////////////////////////////
+//                      North Carolina State University
+//
+//
+//
+//                             Copyright 2016
+//
+////////////////////////////////////////////////////////////////////////
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms and conditions of the GNU General Public License,
+// version 2, as published by the Free Software Foundation.
+//
+// This program is distributed in the hope it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+//
+////////////////////////////////////////////////////////////////////////
+//
+//   Author:  Hung-Wei Tseng, Yu-Chia Liu
+//
+//   Description:
+//     Kernel driven quanta of Processor Container
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "processor_container.h"
+#include "container.h"
+#include "pcontainer_policy.h"
+
+#include <asm/uaccess.h>
+#include <linux/slab.h>
+#include <linux/kernel.h>
+#include <linux/errno.h>
+#include <linux/spinlock.h>
+#include <linux/rcupdate.h>
+#include <linux/sched.h>
+#include <linux/hrtimer.h>
+#include <linux/hardirq.h>
+#include <linux/task_work.h>
+#include <linux/math64.h>
+
+#ifdef PCONTAINER_HAVE_TASK_WORK
+/**
+ * Runs in the context of a thread that lost its turn on its way back to
+ * user space and parks it until it is active again.
+ */
+static void container_park_work(struct callback_head* work)
+{
+    struct thread_list* t = container_of(work, struct thread_list, park_work);
+    struct container_list* c;
+
+    // only the thread itself takes a running thread out of its container,
+    // others reap it once it exits
+    if(!(current->flags & PF_EXITING) && !READ_ONCE(t->orphan))
+        container_perf_charge(t);
+    // a container is freed a grace period after the removal of its last
+    // thread, which sets orphan first if this work is still queued
+    rcu_read_lock();
+    if(READ_ONCE(t->orphan))
+    {
+        rcu_read_unlock();
+        thread_node_free_rcu(t);
+        return;
+    }
+    c = t->container;
+    spin_lock_irq(&c->lock);
+    rcu_read_unlock();
+    // container_remove() decides under the same lock whether the work frees the node
+    if(t->orphan)
+    {
+        spin_unlock_irq(&c->lock);
+        thread_node_free_rcu(t);
+        return;
+    }
+    t->park_pending = false;
+    if(current->flags & PF_EXITING)
+    {
+        spin_unlock_irq(&c->lock);
+        return;
+    }
+    container_wait_turn(c, t);
+}
+#endif
+
+/**
+ * Initialize the park request of a new thread node.
+ */
+void container_park_init(struct thread_list* t)
+{
+#ifdef PCONTAINER_HAVE_TASK_WORK
+    init_task_work(&t->park_work, container_park_work);
+#endif
+    t->park_pending = false;
+    t->orphan = false;
+}
+
+/**
+ * Make a thread that is no longer active stop running; it parks itself the next
+ * time it returns to user space. Called with the container lock held.
+ */
+void container_park(struct thread_list* t)
+{
+    if(t->thread == current && !in_interrupt())
+        return; // the ioctl of the thread parks it in container_wait_turn() before returning
+    container_park_kick(t);
+}
+
+/**
+ * Make a thread park the next time it returns to user space, even the
+ * caller outside of an ioctl. Called with the container lock held.
+ */
+void container_park_kick(struct thread_list* t)
+{
+#ifdef PCONTAINER_HAVE_TASK_WORK
+    if(!t->park_pending && task_work_add(t->thread, &t->park_work, true) == 0)
+    {
+        t->park_pending = true;
+        kick_process(t->thread); // force a thread running in user space into the kernel
+    }
+#else
+    // the SIGPROF handler of the library issues the switch ioctl, which parks
+    // the thread; the library installs it before a thread joins a container
+    send_sig(SIGPROF, t->thread, 1);
+#endif
+}
+
+/**
+ * Kernel driven quantum of a container: its own or the one of its namespace,
+ * 0 if user space drives its switches. Called with the container lock held.
+ */
+static u64 container_slice(struct container_list* c)
+{
+    return c->slice_ns != 0 ? c->slice_ns : READ_ONCE(c->nspace->tick_ns);
+}
+
+/**
+ * Adapt the quantum of a container at its end: longer if the active threads
+ * ran through it, shorter if one of them slept, e.g. waiting for its next
+ * request. Called with the container lock held.
+ */
+static void container_adapt_slice(struct container_list* c)
+{
+    struct thread_list* t;
+    unsigned long nvcsw;
+    bool slept = false;
+
+    list_for_each_entry(t, &c->threads, entry)
+    {
+        if(!t->active)
+            break;
+        nvcsw = READ_ONCE(t->thread->nvcsw);
+        if(nvcsw != t->nvcsw)
+            slept = true;
+        t->nvcsw = nvcsw;
+    }
+    c->slice_ns = pcontainer_policy_slice(c->slice_ns, c->slice_min_ns, c->slice_max_ns, slept);
+    stats_slice(c);
+}
+
+/**
+ * Time until the next tick of a container: its quantum, or less if the
+ * quota of the container runs out before. 0 if neither applies.
+ * Called with the container lock held.
+ */
+static u64 container_tick_interval(struct container_list* c)
+{
+    u64 interval = container_slice(c);
+    u64 left;
+
+    if(c->quota_ns == 0 || !c->running)
+        return interval;
+    left = c->quota_used < c->quota_ns ? c->quota_ns - c->quota_used : 0;
+    // the active threads use up the quota together
+    left = div_u64(left, max(1U, min(c->width, c->nr_threads)));
+    left = max_t(u64, left, PCONTAINER_MIN_TICK_NS);
+    return interval == 0 || left < interval ? left : interval;
+}
+
+/**
+ * hrtimer callback that ends the quantum of the running thread of a container,
+ * gives the slot of the container to a waiting container that is behind it
+ * and hands the processor to the next thread in its run queue.
+ */
+static enum hrtimer_restart container_tick(struct hrtimer* timer)
+{
+    struct container_list* c = container_of(timer, struct container_list, tick);
+    enum hrtimer_restart ret = HRTIMER_NORESTART;
+    u64 interval;
+
+    // judge the quantum that ends before sched_tick() parks the threads
+    if(READ_ONCE(c->slice_min_ns) != READ_ONCE(c->slice_max_ns))
+    {
+        spin_lock(&c->lock);
+        if(c->running)
+            container_adapt_slice(c);
+        spin_unlock(&c->lock);
+    }
+    sched_tick(c);
+
+    spin_lock(&c->lock);
+    // container_tick_start() re-armed the timer while we waited for the lock
+    if(c->dead || hrtimer_is_queued(timer))
+        goto out;
+    // a tick for the quota alone leaves the rotation to user space
+    if(container_slice(c) != 0 && c->nr_threads > c->width)
+        container_rotate(c);
+    interval = container_tick_interval(c);
+    if(interval != 0 && container_needs_tick(c))
+    {
+        hrtimer_forward_now(timer, ns_to_ktime(interval));
+        ret = HRTIMER_RESTART;
+    }
+    stats_deadline(c);
+out:
+    spin_unlock(&c->lock);
+    return ret;
+}
+
+/**
+ * Initialize the quantum timer of a new container.
+ */
+void container_tick_init(struct container_list* c)
+{
+    hrtimer_init(&c->tick, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+    c->tick.function = container_tick;
+}
+
+/**
+ * A running container needs its quantum timer while it has more threads
+ * than its width to rotate, other containers wait for a slot on its
+ * run queue or it has a quota to run out of.
+ * Called with the container lock held.
+ */
+bool container_needs_tick(struct container_list* c)
+{
+    return !c->dead && c->running &&
+           (c->nr_threads > c->width || READ_ONCE(c->rq->nr_queued) > 0 || c->quota_ns != 0);
+}
+
+/**
+ * Arm the quantum timer if the kernel drives the switches or enforces a
+ * quota and the container needs it. Called with the container lock held.
+ */
+void container_tick_start(struct container_list* c)
+{
+    u64 interval = container_tick_interval(c);
+
+    if(interval != 0 && container_needs_tick(c) && !hrtimer_is_queued(&c->tick))
+        hrtimer_start(&c->tick, ns_to_ktime(interval), HRTIMER_MODE_REL);
+    stats_deadline(c);
+}
+
+/**
+ * When the quantum of a running container ends in CLOCK_MONOTONIC ns:
+ * PCONTAINER_TURN_FOREVER if nothing waits for it, 0 if user space has to
+ * end it with a switch. Called with the container lock held.
+ */
+u64 container_tick_deadline(struct container_list* c)
+{
+    bool waiting = c->nr_threads > c->width || READ_ONCE(c->rq->nr_queued) > 0;
+
+    if(!c->running)
+        return 0;
+    // the timer of a quota alone does not end the quanta user space drives
+    if(container_slice(c) == 0 && waiting)
+        return 0;
+    if(hrtimer_active(&c->tick))
+        return ktime_to_ns(hrtimer_get_expires(&c->tick));
+    return waiting || c->quota_ns != 0 ? 0 : PCONTAINER_TURN_FOREVER;
+}
+
+/**
+ * Arm the quantum timer of a container after the quantum of its namespace
+ * changed.
+ */
+static void container_tick_restart(struct container_list* c)
+{
+    spin_lock_irq(&c->lock);
+    container_tick_start(c);
+    spin_unlock_irq(&c->lock);
+}
+
+/**
+ * Set the length of the kernel driven quantum of the containers in namespace
+ * ns to cmd.op nanoseconds, at most PCONTAINER_MAX_SLICE_US, or go back to
+ * switches driven by user space when it is 0. The containers of other
+ * namespaces keep theirs.
+ */
+int processor_container_tick(struct pcontainer_namespace* ns, struct processor_container_cmd __user *user_cmd)
+{
+    struct processor_container_cmd kernel_cmd;
+
+    if(copy_from_user(&kernel_cmd, user_cmd, sizeof(kernel_cmd)))
+        return -EFAULT;
+    // longer ones would overflow ktime_t and refire the timers back to back
+    if(kernel_cmd.op != 0 && (kernel_cmd.op < PCONTAINER_MIN_TICK_NS || kernel_cmd.op > PCONTAINER_MAX_SLICE_US * NSEC_PER_USEC))
+        return -EINVAL;
+
+    WRITE_ONCE(ns->tick_ns, kernel_cmd.op);
+    // arm the timers of the containers that already have threads to rotate
+    namespace_for_each_container(ns, container_tick_restart);
+    return 0;
+}
+
+/**
+ * Give container cid its own kernel driven quantum, encoded by
+ * PCONTAINER_SLICE(). It starts at min_us and adapts up to max_us, or stays
+ * at min_us if they are equal. 0 goes back to the quantum of the namespace.
+ */
+int container_set_slice(struct pcontainer_namespace* ns, __u64 cid, __u64 slice)
+{
+    struct container_list* c;
+    u64 min_ns = (u64)(u32)slice * NSEC_PER_USEC;
+    u64 max_ns = (slice >> 32) * NSEC_PER_USEC;
+    int ret = -ENOENT;
+
+    if(max_ns < min_ns || (min_ns == 0 && max_ns != 0) || max_ns > PCONTAINER_MAX_SLICE_US * NSEC_PER_USEC)
+        return -EINVAL;
+
+    rcu_read_lock();
+    c = container_lookup(ns, cid);
+    if(c != NULL)
+    {
+        spin_lock_irq(&c->lock);
+        if(!c->dead)
+        {
+            c->slice_ns = min_ns;
+            c->slice_min_ns = min_ns;
+            c->slice_max_ns = max_ns;
+            stats_slice(c);
+            container_tick_start(c);
+            ret = 0;
+        }
+        spin_unlock_irq(&c->lock);
+    }
+    rcu_read_unlock();
+    return ret;
+}
+
+/**
+ * Set the quantum of container cmd.cid to cmd.op, see PCONTAINER_IOCTL_SLICE.
+ */
+int processor_container_slice(struct pcontainer_namespace* ns, struct processor_container_cmd __user *user_cmd)
+{
+    struct processor_container_cmd kernel_cmd;
+
+    if(copy_from_user(&kernel_cmd, user_cmd, sizeof(kernel_cmd)))
+        return -EFAULT;
+    return container_set_slice(ns, kernel_cmd.cid, kernel_cmd.op);
+}
@@ -1,5 +1,43 @@
 #include "pcontainer.h"
 
+static __thread struct pcontainer_turn_page *turn_page; // of the namespace turn_nsid, NULL without turns
+static __thread int turn_cid; // container of the calling thread
+static __thread int turn_joined;
+static __thread int turn_slot = -1; // where its container was found last, -2 if it has no slot
+static __thread __u32 turn_tid;
+static __thread int turn_fd = -1; // descriptor whose namespace is turn_nsid
+static __thread __u64 turn_nsid;
+static unsigned long long turn_signals, turn_skipped; // SIGPROF handled and not sent to the kernel
+
+// namespace of the descriptor each statistics mapping came from, so that
+// pcontainer_stats_find() skips the containers of other namespaces
+#define STATS_MAPS 16
+static struct
+{
+    struct pcontainer_stats_page *page;
+    __u64 nsid;
+} stats_maps[STATS_MAPS];
+
+// turn page of every namespace a thread joined a container in, each
+// namespace publishes the turns of its own containers; never unmapped
+#define TURN_MAPS 16
+static struct
+{
+    __u64 nsid; // 0 for a free entry
+    struct pcontainer_turn_page *page; // NULL while it is mapped or if it cannot be
+} turn_maps[TURN_MAPS];
+
+static void pcontainer_keep_handler(int devfd);
+
+/**
+ * open the device of the kernel module and return its descriptor for the
+ * other calls.
+ */
+int pcontainer_open(void)
+{
+    return open("/dev/pcontainer", O_RDWR);
+}
+
 /**
  * context switch handler in user space that sends command to kernel space
  * for switch tasks and containers.
@@ -18,17 +56,656 @@ int pcontainer_context_switch_handler(int devfd, int id)
 int pcontainer_delete(int devfd, int id)
 {
     struct processor_container_cmd cmd;
+    turn_joined = 0;
     cmd.cid = id;
     return ioctl(devfd, PCONTAINER_IOCTL_DELETE, &cmd);
 }
 
+/**
+ * The turn page of namespace nsid, mapped from devfd by the first thread that
+ * joins one of its containers. NULL if it cannot be mapped.
+ */
+static struct pcontainer_turn_page *pcontainer_turn_page(int devfd, __u64 nsid)
+{
+    struct pcontainer_turn_page *turn;
+    int i;
+
+    for (i = 0; i < TURN_MAPS; i++)
+    {
+        if (__atomic_load_n(&turn_maps[i].nsid, __ATOMIC_ACQUIRE) == 0 &&
+            __sync_bool_compare_and_swap(&turn_maps[i].nsid, 0, nsid))
+        {
+            turn = pcontainer_turn_map(devfd);
+            __atomic_store_n(&turn_maps[i].page, turn, __ATOMIC_RELEASE);
+            return turn;
+        }
+        if (__atomic_load_n(&turn_maps[i].nsid, __ATOMIC_ACQUIRE) == nsid)
+            return __atomic_load_n(&turn_maps[i].page, __ATOMIC_ACQUIRE);
+    }
+    return NULL;
+}
+
+/**
+ * Put the calling thread in container id with the create command request and
+ * remember where it is for pcontainer_turn_left().
+ */
+static int pcontainer_join(int devfd, int id, unsigned long request, unsigned long long op)
+{
+    struct processor_container_cmd cmd;
+    int ret;
+
+    // the kernel tick may signal the thread as soon as it is in the container
+    pcontainer_keep_handler(devfd);
+    cmd.cid = id;
+    cmd.op = op;
+    ret = ioctl(devfd, request, &cmd);
+    if (ret != 0)
+        return ret;
+    turn_joined = 0;
+    // the same cid may exist in the namespaces of other descriptors, and
+    // older modules do not publish the turns, every switch goes to the kernel
+    if (turn_fd != devfd)
+    {
+        turn_nsid = pcontainer_namespace_id(devfd);
+        turn_page = turn_nsid != 0 ? pcontainer_turn_page(devfd, turn_nsid) : NULL;
+        turn_fd = devfd;
+    }
+    turn_cid = id;
+    turn_slot = -1;
+    turn_tid = syscall(SYS_gettid);
+    turn_joined = 1;
+    return 0;
+}
+
 /**
  * create function in user space that sends command to kernel space
  * for creating the current task in specified container.
  */
 int pcontainer_create(int devfd, int id)
+{
+    return pcontainer_join(devfd, id, PCONTAINER_IOCTL_CREATE, 0);
+}
+
+/**
+ * create function in user space that sends command to kernel space for
+ * creating the current task in container id, which becomes a child of group
+ * parent if it is new. The group is created at the top if it does not exist.
+ */
+int pcontainer_create_child(int devfd, int id, int parent)
+{
+    return pcontainer_join(devfd, id, PCONTAINER_IOCTL_CREATE_CHILD, parent);
+}
+
+/**
+ * group function in user space that sends command to kernel space for
+ * creating group id under group parent (0 for the top) or setting the
+ * shares of the existing group id.
+ */
+int pcontainer_set_group(int devfd, int id, int parent, int shares)
+{
+    struct processor_container_cmd cmd;
+    cmd.cid = id;
+    cmd.op = PCONTAINER_GROUP(parent, shares);
+    return ioctl(devfd, PCONTAINER_IOCTL_GROUP, &cmd);
+}
+
+/**
+ * namespace function in user space that sends command to kernel space for
+ * sharing the containers of devfd with the descriptors of the same user that
+ * use key, or keeping them to devfd for key 0. It has to come before the
+ * first container of devfd.
+ */
+int pcontainer_set_namespace(int devfd, unsigned long long key)
+{
+    struct processor_container_cmd cmd;
+    cmd.cid = 0;
+    cmd.op = key;
+    return ioctl(devfd, PCONTAINER_IOCTL_NAMESPACE, &cmd);
+}
+
+/**
+ * the id of the namespace of devfd, which the statistics and the turns
+ * carry as nsid; 0 if the module cannot tell.
+ */
+unsigned long long pcontainer_namespace_id(int devfd)
+{
+    struct processor_container_cmd cmd;
+    cmd.cid = 0;
+    cmd.op = 0;
+    if (ioctl(devfd, PCONTAINER_IOCTL_NAMESPACE, &cmd) != 0)
+        return 0;
+    return cmd.cid;
+}
+
+/**
+ * shares function in user space that sends command to kernel space
+ * for setting the shares of an existing container.
+ */
+int pcontainer_set_shares(int devfd, int id, int shares)
+{
+    struct processor_container_cmd cmd;
+    cmd.cid = id;
+    cmd.op = shares;
+    return ioctl(devfd, PCONTAINER_IOCTL_SHARES, &cmd);
+}
+
+/**
+ * affinity function in user space that sends command to kernel space
+ * for restricting an existing container to a mask of cpus (0 for all cpus).
+ */
+int pcontainer_set_affinity(int devfd, int id, unsigned long long cpus)
 {
     struct processor_container_cmd cmd;
     cmd.cid = id;
-    return ioctl(devfd, PCONTAINER_IOCTL_CREATE, &cmd);
+    cmd.op = cpus;
+    return ioctl(devfd, PCONTAINER_IOCTL_AFFINITY, &cmd);
+}
+
+/**
+ * width function in user space that sends command to kernel space
+ * for setting how many threads of an existing container run at the same time.
+ */
+int pcontainer_set_width(int devfd, int id, int width)
+{
+    struct processor_container_cmd cmd;
+    cmd.cid = id;
+    cmd.op = width;
+    return ioctl(devfd, PCONTAINER_IOCTL_WIDTH, &cmd);
+}
+
+/**
+ * prealloc function in user space that sends command to kernel space
+ * for keeping nodes of that many creates allocated ahead (0 frees them).
+ */
+int pcontainer_prealloc(int devfd, int nodes)
+{
+    struct processor_container_cmd cmd;
+    cmd.cid = 0;
+    cmd.op = nodes;
+    return ioctl(devfd, PCONTAINER_IOCTL_PREALLOC, &cmd);
+}
+
+/**
+ * quota function in user space that sends command to kernel space
+ * for letting an existing container run at most quota_us of every period_us (0 lifts it).
+ */
+int pcontainer_set_quota(int devfd, int id, unsigned int quota_us, unsigned int period_us)
+{
+    struct processor_container_cmd cmd;
+    cmd.cid = id;
+    cmd.op = PCONTAINER_QUOTA(quota_us, period_us);
+    return ioctl(devfd, PCONTAINER_IOCTL_QUOTA, &cmd);
+}
+
+/**
+ * class function in user space that sends command to kernel space
+ * for putting an existing container in PCONTAINER_CLASS_BATCH or PCONTAINER_CLASS_LATENCY.
+ */
+int pcontainer_set_class(int devfd, int id, int sched_class)
+{
+    struct processor_container_cmd cmd;
+    cmd.cid = id;
+    cmd.op = sched_class;
+    return ioctl(devfd, PCONTAINER_IOCTL_CLASS, &cmd);
+}
+
+/**
+ * slice function in user space that sends command to kernel space
+ * for giving an existing container its own quantum, adapting between min_us and max_us.
+ */
+int pcontainer_set_slice(int devfd, int id, unsigned int min_us, unsigned int max_us)
+{
+    struct processor_container_cmd cmd;
+    cmd.cid = id;
+    cmd.op = PCONTAINER_SLICE(min_us, max_us);
+    return ioctl(devfd, PCONTAINER_IOCTL_SLICE, &cmd);
+}
+
+/**
+ * placement function in user space that sends command to kernel space
+ * for keeping the threads of an existing container near its home cpu (PCONTAINER_PLACE_*).
+ */
+int pcontainer_set_placement(int devfd, int id, int placement)
+{
+    struct processor_container_cmd cmd;
+    cmd.cid = id;
+    cmd.op = placement;
+    return ioctl(devfd, PCONTAINER_IOCTL_PLACEMENT, &cmd);
+}
+
+// tid of the calling thread, so that the lock fast path needs no system call
+static __thread __u32 lock_tid;
+
+/**
+ * lock function in user space that takes a free lock with a compare and swap
+ * and only sends command to kernel space to wait for a taken one.
+ */
+int pcontainer_lock(int devfd, pcontainer_lock_t *lock)
+{
+    struct processor_container_cmd cmd;
+    int ret;
+
+    if (lock_tid == 0)
+        lock_tid = syscall(SYS_gettid) & PCONTAINER_LOCK_TID_MASK;
+    if (__sync_bool_compare_and_swap(&lock->word, 0, lock_tid))
+        return 0;
+    cmd.cid = 0;
+    cmd.op = (unsigned long)&lock->word;
+    // a signal interrupts the wait, the lock may have been released meanwhile
+    while ((ret = ioctl(devfd, PCONTAINER_IOCTL_LOCK, &cmd)) < 0 && errno == EINTR)
+    {
+        if (__sync_bool_compare_and_swap(&lock->word, 0, lock_tid))
+            return 0;
+    }
+    return ret;
+}
+
+/**
+ * unlock function in user space that releases a lock nobody waits for with a
+ * compare and swap and only sends command to kernel space to hand it over.
+ */
+int pcontainer_unlock(int devfd, pcontainer_lock_t *lock)
+{
+    struct processor_container_cmd cmd;
+
+    if (__sync_bool_compare_and_swap(&lock->word, lock_tid, 0))
+        return 0;
+    cmd.cid = 0;
+    cmd.op = (unsigned long)&lock->word;
+    return ioctl(devfd, PCONTAINER_IOCTL_UNLOCK, &cmd);
+}
+
+/**
+ * map the command ring of the device.
+ */
+int pcontainer_ring_init(int devfd, pcontainer_ring_t *ring)
+{
+    long page = sysconf(_SC_PAGESIZE);
+    size_t size = (sizeof(struct pcontainer_ring) + page - 1) & ~(page - 1);
+
+    ring->ring = (struct pcontainer_ring *) mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, devfd, 0);
+    if (ring->ring == MAP_FAILED)
+        return -1;
+    // the threads the ring puts in containers may get SIGPROF from the kernel tick
+    pcontainer_keep_handler(devfd);
+    ring->devfd = devfd;
+    ring->sqpoll = 0;
+    ring->sq_tail = ring->ring->sq_tail;
+    return 0;
+}
+
+/**
+ * queue an operation in the ring without sending it to kernel space yet,
+ * fails with EAGAIN while the submission queue is full.
+ */
+int pcontainer_ring_queue(pcontainer_ring_t *ring, int opcode, int tid, int cid, unsigned long long op, unsigned long long user_data)
+{
+    struct pcontainer_sqe *sqe;
+
+    if (ring->sq_tail - __atomic_load_n(&ring->ring->sq_head, __ATOMIC_ACQUIRE) >= PCONTAINER_RING_ENTRIES)
+    {
+        errno = EAGAIN;
+        return -1;
+    }
+    sqe = &ring->ring->sqes[ring->sq_tail & (PCONTAINER_RING_ENTRIES - 1)];
+    sqe->opcode = opcode;
+    sqe->tid = tid != 0 ? tid : syscall(SYS_gettid);
+    sqe->cid = cid;
+    sqe->op = op;
+    sqe->user_data = user_data;
+    ring->sq_tail++;
+    return 0;
+}
+
+/**
+ * hand the queued operations to kernel space: a single system call runs all
+ * of them, none is needed while the poll thread is awake.
+ */
+int pcontainer_ring_submit(pcontainer_ring_t *ring)
+{
+    struct processor_container_cmd cmd;
+
+    __atomic_store_n(&ring->ring->sq_tail, ring->sq_tail, __ATOMIC_RELEASE);
+    if (ring->sqpoll)
+    {
+        // pairs with the barrier of the poll thread between flags and sq_tail
+        __sync_synchronize();
+        if (!(__atomic_load_n(&ring->ring->flags, __ATOMIC_RELAXED) & PCONTAINER_RING_NEED_WAKEUP))
+            return 0;
+    }
+    cmd.cid = 0;
+    cmd.op = 0;
+    return ioctl(ring->devfd, PCONTAINER_IOCTL_ENTER, &cmd);
+}
+
+/**
+ * copy up to max completions out of the ring and return how many there were.
+ */
+int pcontainer_ring_reap(pcontainer_ring_t *ring, struct pcontainer_cqe *cqes, int max)
+{
+    __u32 head = ring->ring->cq_head;
+    __u32 tail = __atomic_load_n(&ring->ring->cq_tail, __ATOMIC_ACQUIRE);
+    int n = 0;
+
+    while (head != tail && n < max)
+        cqes[n++] = ring->ring->cqes[head++ & (PCONTAINER_RING_ENTRIES - 1)];
+    __atomic_store_n(&ring->ring->cq_head, head, __ATOMIC_RELEASE);
+    return n;
+}
+
+/**
+ * start a kernel thread that runs the queued operations on its own until it
+ * is idle for idle_us, or stop it when idle_us is 0.
+ */
+int pcontainer_ring_sqpoll(pcontainer_ring_t *ring, int idle_us)
+{
+    struct processor_container_cmd cmd;
+    int ret;
+
+    cmd.cid = 0;
+    cmd.op = idle_us;
+    ret = ioctl(ring->devfd, PCONTAINER_IOCTL_SQPOLL, &cmd);
+    if (ret == 0)
+        ring->sqpoll = idle_us != 0;
+    return ret;
+}
+
+/**
+ * unmap the command ring.
+ */
+void pcontainer_ring_exit(pcontainer_ring_t *ring)
+{
+    long page = sysconf(_SC_PAGESIZE);
+
+    munmap(ring->ring, (sizeof(struct pcontainer_ring) + page - 1) & ~(page - 1));
+}
+
+/**
+ * map the statistics of the containers read-only and remember the namespace
+ * of devfd for pcontainer_stats_find().
+ */
+struct pcontainer_stats_page *pcontainer_stats_map(int devfd)
+{
+    long page = sysconf(_SC_PAGESIZE);
+    size_t size = (sizeof(struct pcontainer_stats_page) + page - 1) & ~(page - 1);
+    void *stats = mmap(NULL, size, PROT_READ, MAP_SHARED, devfd, PCONTAINER_STATS_OFFSET);
+    unsigned long long nsid;
+    int i;
+
+    if (stats == MAP_FAILED)
+        return NULL;
+    nsid = pcontainer_namespace_id(devfd);
+    for (i = 0; i < STATS_MAPS; i++)
+    {
+        if (__sync_bool_compare_and_swap(&stats_maps[i].page, NULL, (struct pcontainer_stats_page *) stats))
+        {
+            stats_maps[i].nsid = nsid;
+            break;
+        }
+    }
+    return (struct pcontainer_stats_page *) stats;
+}
+
+/**
+ * namespace of the descriptor page was mapped from, 0 if it is not known.
+ */
+static __u64 pcontainer_stats_nsid(struct pcontainer_stats_page *page)
+{
+    int i;
+
+    for (i = 0; i < STATS_MAPS; i++)
+    {
+        if (stats_maps[i].page == page)
+            return stats_maps[i].nsid;
+    }
+    return 0;
+}
+
+/**
+ * copy a consistent snapshot of a slot, return 1 if a container uses it.
+ */
+int pcontainer_stats_read(struct pcontainer_stats_page *page, int slot, struct pcontainer_stats *stats)
+{
+    struct pcontainer_stats *s = &page->slots[slot];
+    __u32 seq;
+
+    // the kernel module makes seq odd while it updates the slot
+    do
+    {
+        seq = __atomic_load_n(&s->seq, __ATOMIC_ACQUIRE);
+        *stats = *s;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while ((seq & 1) || seq != __atomic_load_n(&s->seq, __ATOMIC_RELAXED));
+    return stats->in_use != 0;
+}
+
+/**
+ * copy the statistics of container cid of the namespace of the descriptor
+ * page was mapped from, return 0 or -1 if it has none.
+ */
+int pcontainer_stats_find(struct pcontainer_stats_page *page, int cid, struct pcontainer_stats *stats)
+{
+    __u64 nsid = pcontainer_stats_nsid(page);
+    int i;
+
+    for (i = 0; i < PCONTAINER_STATS_SLOTS; i++)
+    {
+        if (pcontainer_stats_read(page, i, stats) && stats->cid == (__u64) cid && (nsid == 0 || stats->nsid == nsid))
+            return 0;
+    }
+    errno = ENOENT;
+    return -1;
+}
+
+/**
+ * unmap the statistics.
+ */
+void pcontainer_stats_unmap(struct pcontainer_stats_page *page)
+{
+    long size = sysconf(_SC_PAGESIZE);
+    int i;
+
+    for (i = 0; i < STATS_MAPS; i++)
+    {
+        if (stats_maps[i].page == page)
+            __atomic_store_n(&stats_maps[i].page, NULL, __ATOMIC_RELEASE);
+    }
+
+    munmap(page, (sizeof(struct pcontainer_stats_page) + size - 1) & ~(size - 1));
+}
+
+/**
+ * map the turns of the containers read-only, slot i belongs to the container
+ * of slot i of the statistics.
+ */
+struct pcontainer_turn_page *pcontainer_turn_map(int devfd)
+{
+    long page = sysconf(_SC_PAGESIZE);
+    size_t size = (sizeof(struct pcontainer_turn_page) + page - 1) & ~(page - 1);
+    void *turn = mmap(NULL, size, PROT_READ, MAP_SHARED, devfd, PCONTAINER_TURN_OFFSET);
+
+    return turn == MAP_FAILED ? NULL : (struct pcontainer_turn_page *) turn;
+}
+
+/**
+ * copy a consistent snapshot of a turn slot, return 1 if a container uses it.
+ */
+int pcontainer_turn_read(struct pcontainer_turn_page *page, int slot, struct pcontainer_turn *turn)
+{
+    struct pcontainer_turn *t = &page->slots[slot];
+    __u32 seq;
+
+    // the kernel module makes seq odd while it updates the slot
+    do
+    {
+        seq = __atomic_load_n(&t->seq, __ATOMIC_ACQUIRE);
+        *turn = *t;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while ((seq & 1) || seq != __atomic_load_n(&t->seq, __ATOMIC_RELAXED));
+    return turn->in_use != 0;
+}
+
+/**
+ * unmap the turns.
+ */
+void pcontainer_turn_unmap(struct pcontainer_turn_page *page)
+{
+    long size = sysconf(_SC_PAGESIZE);
+
+    munmap(page, (sizeof(struct pcontainer_turn_page) + size - 1) & ~(size - 1));
+}
+
+/**
+ * copy the turn of the container of the calling thread, return 0 or -1 if
+ * it has none. Safe in a signal handler.
+ */
+static int pcontainer_turn_self(struct pcontainer_turn *turn)
+{
+    struct pcontainer_turn_page *page = turn_page;
+    int i;
+
+    if (page == NULL || !turn_joined || turn_slot == -2)
+        return -1;
+    if (turn_slot >= 0 && pcontainer_turn_read(page, turn_slot, turn) && turn->cid == (__u64) turn_cid &&
+        turn->nsid == turn_nsid)
+        return 0;
+    for (i = 0; i < PCONTAINER_STATS_SLOTS; i++)
+    {
+        if (pcontainer_turn_read(page, i, turn) && turn->cid == (__u64) turn_cid && turn->nsid == turn_nsid)
+        {
+            turn_slot = i;
+            return 0;
+        }
+    }
+    // containers beyond the slots are not published, do not look again
+    turn_slot = -2;
+    return -1;
+}
+
+/**
+ * nanoseconds left in the turn of the calling thread, LLONG_MAX if nothing
+ * waits for it to end, 0 if it should call pcontainer_context_switch_handler()
+ * now: its turn is over, user space ends the quantum or the kernel module
+ * does not publish turns. Cooperative code can run until it returns 0.
+ */
+long long pcontainer_turn_left(void)
+{
+    struct pcontainer_turn turn;
+    struct timespec now;
+    __u64 now_ns;
+    __u32 i;
+
+    if (pcontainer_turn_self(&turn) != 0 || !turn.running || turn.deadline_ns == 0)
+        return 0;
+    for (i = 0; i < turn.nr_active && i < PCONTAINER_TURN_TIDS; i++)
+    {
+        if (turn.tids[i] == turn_tid)
+            break;
+    }
+    // threads beyond the listed ones cannot tell if they hold a turn
+    if (i == turn.nr_active || i == PCONTAINER_TURN_TIDS)
+        return 0;
+    if (turn.deadline_ns == PCONTAINER_TURN_FOREVER)
+        return LLONG_MAX;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    now_ns = (__u64) now.tv_sec * 1000000000ULL + now.tv_nsec;
+    return turn.deadline_ns > now_ns ? (long long) (turn.deadline_ns - now_ns) : 0;
+}
+
+/**
+ * how many SIGPROF the handler of pcontainer_init() got and how many of them
+ * it did not turn into a switch because the thread still held its turn.
+ */
+void pcontainer_switch_counts(unsigned long long *signals, unsigned long long *skipped)
+{
+    *signals = __atomic_load_n(&turn_signals, __ATOMIC_RELAXED);
+    *skipped = __atomic_load_n(&turn_skipped, __ATOMIC_RELAXED);
+}
+
+static int DEVFD;
+
+/**
+ * handler function for the timer to run the context switch function, unless
+ * the turn page shows that the switch would not change anything.
+ */
+static void handler()
+{
+    __atomic_add_fetch(&turn_signals, 1, __ATOMIC_RELAXED);
+    if (pcontainer_turn_left() > 0)
+    {
+        __atomic_add_fetch(&turn_skipped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    pcontainer_context_switch_handler(DEVFD, 0);
+}
+
+/**
+ * install handler() for SIGPROF.
+ */
+static void pcontainer_install_handler(int devfd)
+{
+    struct sigaction sa;
+
+    sa.sa_flags = SA_SIGINFO | SA_RESTART | SA_ONSTACK;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_sigaction = handler;
+    if (sigaction(SIGPROF, &sa, NULL) == -1)
+    {
+        fprintf(stderr, "sigaction");
+        exit(1);
+    }
+    DEVFD = devfd;
+}
+
+/**
+ * install handler() for SIGPROF unless the process handles or ignores it
+ * already. Modules built without task_work support send SIGPROF to a thread
+ * in a container that has to give up the processor, which would kill a
+ * process that never called pcontainer_init().
+ */
+static void pcontainer_keep_handler(int devfd)
+{
+    struct sigaction sa;
+
+    if (sigaction(SIGPROF, NULL, &sa) == 0 && !(sa.sa_flags & SA_SIGINFO) && sa.sa_handler == SIG_DFL)
+        pcontainer_install_handler(devfd);
+}
+
+/**
+ * set up the alarm for context switch every time duration.
+ */
+int pcontainer_init(int devfd)
+{
+    struct itimerval timeout;
+
+    pcontainer_install_handler(devfd);
+    timeout.it_value.tv_sec = 0;
+    timeout.it_value.tv_usec = 5;
+    timeout.it_interval = timeout.it_value;
+    if (setitimer(ITIMER_PROF, &timeout, NULL) == 1)
+        fprintf(stderr, "Timer failed\n");
+    return 0;
+}
+
+/**
+ * let the kernel module end the quantum of every container in the namespace
+ * of devfd with its own timer of quantum_us microseconds instead of the SIGPROF alarm, so threads
+ * only need to create/delete; 0 goes back to switches driven by user space.
+ */
+int pcontainer_init_kernel_tick(int devfd, int quantum_us)
+{
+    struct processor_container_cmd cmd;
+    struct itimerval timeout;
+
+    // modules built without task_work support still send SIGPROF to a
+    // thread that has to give up the processor
+    pcontainer_install_handler(devfd);
+    timeout.it_value.tv_sec = 0;
+    timeout.it_value.tv_usec = 0;
+    timeout.it_interval = timeout.it_value;
+    setitimer(ITIMER_PROF, &timeout, NULL);
+
+    cmd.cid = 0;
+    cmd.op = (__u64)quantum_us * 1000;
+    return ioctl(devfd, PCONTAINER_IOCTL_TICK, &cmd);
 }
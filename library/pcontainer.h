@@ -1,3 +1,6 @@
+#ifndef PCONTAINER_H
+#define PCONTAINER_H
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -14,47 +17,67 @@ extern "C"
 #include <stdio.h>
 #include <stdlib.h>
 #include <fcntl.h>
+#include <limits.h>
+#include <time.h>
+#include <errno.h>
+
+    // lock word shared by the threads of a process: 0 when free, otherwise the
+    // tid of the owner, PCONTAINER_LOCK_CONTENDED when threads wait for it
+    typedef struct
+    {
+        volatile __u32 word;
+    } pcontainer_lock_t;
+
+#define PCONTAINER_LOCK_INITIALIZER { 0 }
 
+    // command ring mapped from the device, operations queued with
+    // pcontainer_ring_queue() run in one system call or none with sqpoll
+    typedef struct
+    {
+        struct pcontainer_ring *ring;
+        int devfd;
+        int sqpoll;
+        __u32 sq_tail; // entries queued but not submitted yet end here
+    } pcontainer_ring_t;
+
+    int pcontainer_open(void);
     int pcontainer_delete(int devfd, int cid);
     int pcontainer_create(int devfd, int cid);
+    int pcontainer_create_child(int devfd, int cid, int parent);
+    int pcontainer_set_group(int devfd, int gid, int parent, int shares);
     int pcontainer_context_switch_handler(int devfd, int cid);
     int pcontainer_init(int devfd);
-    int DEVFD;
-
-    /**
-     * handler function for the timer to run the context switch function.
-     */
-    static void handler()
-    {
-        pcontainer_context_switch_handler(DEVFD, 0);
-    }
-
-    /**
-     * set up the alarm for context switch every time duration.
-     */
-    int pcontainer_init(int devfd)
-    {
-        struct sigaction sa;
-        struct itimerval timeout;
-
-        sa.sa_flags = SA_SIGINFO | SA_RESTART | SA_ONSTACK;
-        sigemptyset(&sa.sa_mask);
-        sa.sa_sigaction = handler;
-        if (sigaction(SIGPROF, &sa, NULL) == -1)
-        {
-            fprintf(stderr, "sigaction");
-            exit(1);
-        }
-
-        DEVFD = devfd;
-        timeout.it_value.tv_sec = 0;
-        timeout.it_value.tv_usec = 5;
-        timeout.it_interval = timeout.it_value;
-        if (setitimer(ITIMER_PROF, &timeout, NULL) == 1)
-            fprintf(stderr, "Timer failed\n");
-        return 0;
-    }
+    int pcontainer_init_kernel_tick(int devfd, int quantum_us);
+    int pcontainer_set_namespace(int devfd, unsigned long long key);
+    unsigned long long pcontainer_namespace_id(int devfd);
+    int pcontainer_set_shares(int devfd, int cid, int shares);
+    int pcontainer_set_affinity(int devfd, int cid, unsigned long long cpus);
+    int pcontainer_set_width(int devfd, int cid, int width);
+    int pcontainer_prealloc(int devfd, int nodes);
+    int pcontainer_set_quota(int devfd, int cid, unsigned int quota_us, unsigned int period_us);
+    int pcontainer_set_class(int devfd, int cid, int sched_class);
+    int pcontainer_set_slice(int devfd, int cid, unsigned int min_us, unsigned int max_us);
+    int pcontainer_set_placement(int devfd, int cid, int placement);
+    int pcontainer_lock(int devfd, pcontainer_lock_t *lock);
+    int pcontainer_unlock(int devfd, pcontainer_lock_t *lock);
+    int pcontainer_ring_init(int devfd, pcontainer_ring_t *ring);
+    int pcontainer_ring_queue(pcontainer_ring_t *ring, int opcode, int tid, int cid, unsigned long long op, unsigned long long user_data);
+    int pcontainer_ring_submit(pcontainer_ring_t *ring);
+    int pcontainer_ring_reap(pcontainer_ring_t *ring, struct pcontainer_cqe *cqes, int max);
+    int pcontainer_ring_sqpoll(pcontainer_ring_t *ring, int idle_us);
+    void pcontainer_ring_exit(pcontainer_ring_t *ring);
+    struct pcontainer_stats_page *pcontainer_stats_map(int devfd);
+    int pcontainer_stats_read(struct pcontainer_stats_page *page, int slot, struct pcontainer_stats *stats);
+    int pcontainer_stats_find(struct pcontainer_stats_page *page, int cid, struct pcontainer_stats *stats);
+    void pcontainer_stats_unmap(struct pcontainer_stats_page *page);
+    struct pcontainer_turn_page *pcontainer_turn_map(int devfd);
+    int pcontainer_turn_read(struct pcontainer_turn_page *page, int slot, struct pcontainer_turn *turn);
+    void pcontainer_turn_unmap(struct pcontainer_turn_page *page);
+    long long pcontainer_turn_left(void);
+    void pcontainer_switch_counts(unsigned long long *signals, unsigned long long *skipped);
 
 #ifdef __cplusplus
 }
-#endif
\ No newline at end of file
+#endif
+
+#endif
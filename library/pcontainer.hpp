@@ -0,0 +1,100 @@
+#ifndef PCONTAINER_HPP
+#define PCONTAINER_HPP
+
+#include "pcontainer.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace pcontainer
+{
+    // descriptor of the device from pcontainer_open(), closed with the last
+    // handle that owns it; its containers are in the namespace of the descriptor
+    class device
+    {
+    public:
+        device();
+        explicit device(int fd) noexcept : fd_(fd) {}
+        device(device &&other) noexcept : fd_(other.release()) {}
+        device &operator=(device &&other) noexcept;
+        device(const device &) = delete;
+        device &operator=(const device &) = delete;
+        ~device();
+
+        int fd() const noexcept { return fd_; }
+        int release() noexcept; // the caller closes the descriptor
+
+    private:
+        int fd_;
+    };
+
+    // the calling thread is in container cid while the guard lives, it must
+    // be destroyed by the same thread
+    class membership
+    {
+    public:
+        membership(const device &dev, int cid);
+        membership(const device &dev, int cid, int group);
+        membership(const membership &) = delete;
+        membership &operator=(const membership &) = delete;
+        ~membership();
+
+        void yield(); // hand the turn to the next thread of the container
+        int cid() const noexcept { return cid_; }
+
+    private:
+        int fd_;
+        int cid_;
+    };
+
+    // runs tasks as fibers on a few threads of container cid, a fiber that
+    // yields or finishes switches to the next one without a system call; a
+    // task runs on the thread that started it until it finishes, so the
+    // pcontainer locks it holds, errno and thread_local data stay on one
+    // thread across yield(), which the other tasks of that thread share
+    class executor
+    {
+    public:
+        static constexpr std::size_t default_stack = 64 * 1024;
+
+        executor(const device &dev, int cid, unsigned int threads, std::size_t stack_size = default_stack);
+        executor(const executor &) = delete;
+        executor &operator=(const executor &) = delete;
+        ~executor();
+
+        void spawn(std::function<void()> task);
+        void wait(); // until every spawned task finished, rethrows the first exception of a task
+        static void yield(); // from a task, let the other fibers run first
+
+        struct fiber;
+
+    private:
+        void worker();
+        void finish(fiber *f);
+
+        int fd_;
+        int cid_;
+        unsigned int width_; // threads of the executor, all of them run at the same time
+        std::size_t stack_size_;
+        std::mutex lock_; // protects everything below
+        std::condition_variable ready_; // fibers were queued, or the executor stops
+        std::condition_variable idle_; // pending_ dropped to 0, or a thread joined
+        std::deque<fiber *> queue_; // fibers waiting for a thread, in order
+        std::vector<fiber *> free_; // finished fibers kept with their stacks for new tasks
+        std::vector<fiber *> all_;
+        std::size_t pending_; // spawned tasks that did not finish
+        unsigned int joined_; // threads that tried to join the container
+        int join_error_; // errno of the first thread that could not join
+        bool stop_;
+        std::exception_ptr error_; // first exception a task threw
+        std::vector<std::thread> threads_;
+    };
+}
+
+#endif
@@ -0,0 +1,406 @@
+#include "pcontainer.hpp"
+
+#include <deque>
+#include <memory>
+#include <system_error>
+#if !defined(__x86_64__)
+#include <ucontext.h>
+#endif
+
+namespace pcontainer
+{
+    /**
+     * throw the errno of a failed call as std::system_error.
+     */
+    static void throw_errno(const char *what)
+    {
+        throw std::system_error(errno, std::generic_category(), what);
+    }
+
+    device::device() : fd_(pcontainer_open())
+    {
+        if (fd_ < 0)
+            throw_errno("pcontainer_open");
+    }
+
+    device &device::operator=(device &&other) noexcept
+    {
+        if (this != &other)
+        {
+            if (fd_ >= 0)
+                close(fd_);
+            fd_ = other.release();
+        }
+        return *this;
+    }
+
+    device::~device()
+    {
+        if (fd_ >= 0)
+            close(fd_);
+    }
+
+    int device::release() noexcept
+    {
+        int fd = fd_;
+
+        fd_ = -1;
+        return fd;
+    }
+
+    membership::membership(const device &dev, int cid) : fd_(dev.fd()), cid_(cid)
+    {
+        if (pcontainer_create(fd_, cid_) != 0)
+            throw_errno("pcontainer_create");
+    }
+
+    membership::membership(const device &dev, int cid, int group) : fd_(dev.fd()), cid_(cid)
+    {
+        if (pcontainer_create_child(fd_, cid_, group) != 0)
+            throw_errno("pcontainer_create_child");
+    }
+
+    membership::~membership()
+    {
+        pcontainer_delete(fd_, cid_);
+    }
+
+    void membership::yield()
+    {
+        pcontainer_context_switch_handler(fd_, cid_);
+    }
+
+    // where a thread of the executor continues when its fiber switches out
+    struct worker_context
+    {
+#if defined(__x86_64__)
+        void *sp;
+#else
+        ucontext_t uc;
+#endif
+    };
+
+    struct executor::fiber
+    {
+        std::function<void()> task;
+        std::unique_ptr<char[]> stack;
+        worker_context *worker; // thread that started the fiber, it runs there until it finishes
+        std::exception_ptr error;
+        bool started;
+        bool done;
+#if defined(__x86_64__)
+        void *sp; // saved stack pointer while switched out
+#else
+        ucontext_t uc;
+#endif
+    };
+
+    static thread_local executor::fiber *current_fiber; // fiber run by the calling thread, if any
+
+#if defined(__x86_64__)
+    // saves the callee-saved registers, MXCSR and the x87 control word on the
+    // current stack, stores the stack pointer in *save and continues on the
+    // stack load; new fibers start in pcontainer_fiber_start with the fiber
+    // in %r15
+    extern "C" void pcontainer_fiber_switch(void **save, void *load) __attribute__((visibility("hidden")));
+    extern "C" void pcontainer_fiber_start() __attribute__((visibility("hidden")));
+#endif
+    extern "C" void pcontainer_fiber_main(executor::fiber *f) __attribute__((visibility("hidden"), noreturn));
+
+    /**
+     * Run the task of a fiber and switch back to its thread for good.
+     */
+    void pcontainer_fiber_main(executor::fiber *f)
+    {
+        try
+        {
+            f->task();
+        }
+        catch (...)
+        {
+            f->error = std::current_exception();
+        }
+        f->done = true;
+#if defined(__x86_64__)
+        pcontainer_fiber_switch(&f->sp, f->worker->sp);
+#else
+        setcontext(&f->worker->uc);
+#endif
+        __builtin_unreachable();
+    }
+
+#if defined(__x86_64__)
+    asm(".text\n"
+        ".globl pcontainer_fiber_switch\n"
+        ".hidden pcontainer_fiber_switch\n"
+        ".type pcontainer_fiber_switch, @function\n"
+        "pcontainer_fiber_switch:\n"
+        "    pushq %rbp\n"
+        "    pushq %rbx\n"
+        "    pushq %r12\n"
+        "    pushq %r13\n"
+        "    pushq %r14\n"
+        "    pushq %r15\n"
+        "    subq $8, %rsp\n"
+        "    stmxcsr (%rsp)\n"
+        "    fnstcw 4(%rsp)\n"
+        "    movq %rsp, (%rdi)\n"
+        "    movq %rsi, %rsp\n"
+        "    ldmxcsr (%rsp)\n"
+        "    fldcw 4(%rsp)\n"
+        "    addq $8, %rsp\n"
+        "    popq %r15\n"
+        "    popq %r14\n"
+        "    popq %r13\n"
+        "    popq %r12\n"
+        "    popq %rbx\n"
+        "    popq %rbp\n"
+        "    ret\n"
+        ".size pcontainer_fiber_switch, .-pcontainer_fiber_switch\n"
+        ".globl pcontainer_fiber_start\n"
+        ".hidden pcontainer_fiber_start\n"
+        ".type pcontainer_fiber_start, @function\n"
+        "pcontainer_fiber_start:\n"
+        "    movq %r15, %rdi\n"
+        "    call pcontainer_fiber_main\n"
+        "    ud2\n"
+        ".size pcontainer_fiber_start, .-pcontainer_fiber_start\n");
+
+    /**
+     * Lay out the stack of a fiber so that switching to it enters
+     * pcontainer_fiber_start with an aligned stack and the floating point
+     * control of the calling thread.
+     */
+    static void fiber_prepare(executor::fiber *f, std::size_t stack_size)
+    {
+        void **top = (void **)(((unsigned long)(f->stack.get() + stack_size)) & ~15UL);
+        unsigned int mxcsr;
+        unsigned short fpucw;
+
+        asm volatile("stmxcsr %0" : "=m"(mxcsr));
+        asm volatile("fnstcw %0" : "=m"(fpucw));
+        top[-1] = (void *)pcontainer_fiber_start; // return address of the switch
+        top[-7] = f; // %r15, %r14 .. %rbp are below it
+        top[-8] = (void *)(mxcsr | (unsigned long)fpucw << 32); // loaded by ldmxcsr and fldcw
+        f->sp = top - 8;
+    }
+
+    static void fiber_resume(worker_context *w, executor::fiber *f)
+    {
+        pcontainer_fiber_switch(&w->sp, f->sp);
+    }
+
+    static void fiber_suspend(executor::fiber *f)
+    {
+        pcontainer_fiber_switch(&f->sp, f->worker->sp);
+    }
+#else
+    static void fiber_prepare(executor::fiber *f, std::size_t stack_size)
+    {
+        getcontext(&f->uc);
+        f->uc.uc_stack.ss_sp = f->stack.get();
+        f->uc.uc_stack.ss_size = stack_size;
+        f->uc.uc_link = NULL;
+        makecontext(&f->uc, (void (*)())pcontainer_fiber_main, 1, f);
+    }
+
+    static void fiber_resume(worker_context *w, executor::fiber *f)
+    {
+        swapcontext(&w->uc, &f->uc);
+    }
+
+    static void fiber_suspend(executor::fiber *f)
+    {
+        swapcontext(&f->uc, &f->worker->uc);
+    }
+#endif
+
+    /**
+     * Start threads threads in container cid with as many of them running at
+     * the same time, at most PCONTAINER_MAX_WIDTH. Throws std::system_error
+     * if they cannot join it or it cannot be widened.
+     */
+    executor::executor(const device &dev, int cid, unsigned int threads, std::size_t stack_size)
+        : fd_(dev.fd()), cid_(cid), width_(threads), stack_size_(stack_size), pending_(0), joined_(0), join_error_(0),
+          stop_(false)
+    {
+        unsigned int i;
+
+        if (threads == 0 || threads > PCONTAINER_MAX_WIDTH)
+            throw std::system_error(EINVAL, std::generic_category(), "executor");
+        for (i = 0; i < threads; i++)
+            threads_.emplace_back(&executor::worker, this);
+        std::unique_lock<std::mutex> guard(lock_);
+        idle_.wait(guard, [&] { return joined_ == threads; });
+        if (join_error_ == 0)
+            return;
+        stop_ = true;
+        guard.unlock();
+        ready_.notify_all();
+        for (auto &t : threads_)
+            t.join();
+        throw std::system_error(join_error_, std::generic_category(), "executor");
+    }
+
+    /**
+     * Wait for the tasks, then take the threads out of the container.
+     */
+    executor::~executor()
+    {
+        {
+            std::unique_lock<std::mutex> guard(lock_);
+            idle_.wait(guard, [&] { return pending_ == 0; });
+            stop_ = true;
+        }
+        ready_.notify_all();
+        for (auto &t : threads_)
+            t.join();
+        for (fiber *f : all_)
+            delete f;
+    }
+
+    /**
+     * Queue task to run as a fiber, reusing the stack of a finished one.
+     */
+    void executor::spawn(std::function<void()> task)
+    {
+        std::unique_ptr<fiber> created;
+        fiber *f;
+
+        std::unique_lock<std::mutex> guard(lock_);
+        if (free_.empty())
+        {
+            guard.unlock();
+            created.reset(new fiber());
+            created->stack.reset(new char[stack_size_]);
+            guard.lock();
+            all_.push_back(created.get());
+            f = created.release();
+        }
+        else
+        {
+            f = free_.back();
+            free_.pop_back();
+        }
+        f->task = std::move(task);
+        f->started = false;
+        f->done = false;
+        queue_.push_back(f);
+        pending_++;
+        guard.unlock();
+        ready_.notify_one();
+    }
+
+    void executor::wait()
+    {
+        std::exception_ptr error;
+
+        {
+            std::unique_lock<std::mutex> guard(lock_);
+            idle_.wait(guard, [&] { return pending_ == 0; });
+            error = error_;
+            error_ = nullptr;
+        }
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+    /**
+     * Switch from the calling task back to its thread, which queues it behind
+     * the fibers already waiting. Outside of a task the thread yields.
+     */
+    void executor::yield()
+    {
+        fiber *f = current_fiber;
+
+        if (f == NULL)
+        {
+            std::this_thread::yield();
+            return;
+        }
+        fiber_suspend(f);
+    }
+
+    /**
+     * Recycle a fiber whose task returned. Called with lock_ held.
+     */
+    void executor::finish(fiber *f)
+    {
+        if (f->error && !error_)
+            error_ = f->error;
+        f->error = nullptr;
+        f->task = nullptr;
+        free_.push_back(f);
+        if (--pending_ == 0)
+            idle_.notify_all();
+    }
+
+    /**
+     * Body of a thread of the executor: joins the container and runs the
+     * queued fibers until the executor stops. A fiber it started stays on it,
+     * so errno, thread_local data and the pcontainer locks of its task do not
+     * change threads under it; it alternates between new and yielded fibers.
+     */
+    void executor::worker()
+    {
+        worker_context context;
+        std::deque<fiber *> yielded; // fibers started here, waiting to continue
+        bool take_yielded = false;
+        fiber *f;
+        int ret = pcontainer_create(fd_, cid_);
+        int error = ret != 0 ? errno : 0;
+
+        // the threads only wait for fibers, not for each other's turn, and the
+        // others only get past pcontainer_create() once the first one widened it
+        if (ret == 0 && pcontainer_set_width(fd_, cid_, width_) != 0)
+        {
+            // leave, so that the next thread gets its turn and fails as well
+            error = errno;
+            pcontainer_delete(fd_, cid_);
+            ret = -1;
+        }
+        std::unique_lock<std::mutex> guard(lock_);
+        if (ret != 0 && join_error_ == 0)
+            join_error_ = error;
+        joined_++;
+        idle_.notify_all();
+        for (;;)
+        {
+            if (yielded.empty())
+                ready_.wait(guard, [&] { return stop_ || !queue_.empty(); });
+            if (queue_.empty() && yielded.empty())
+                break;
+            take_yielded = !take_yielded;
+            if (!yielded.empty() && (take_yielded || queue_.empty()))
+            {
+                f = yielded.front();
+                yielded.pop_front();
+            }
+            else
+            {
+                f = queue_.front();
+                queue_.pop_front();
+            }
+            guard.unlock();
+
+            if (!f->started)
+            {
+                fiber_prepare(f, stack_size_);
+                f->started = true;
+                f->worker = &context;
+            }
+            current_fiber = f;
+            fiber_resume(&context, f);
+            current_fiber = NULL;
+
+            if (!f->done)
+                yielded.push_back(f);
+            guard.lock();
+            if (f->done)
+                finish(f);
+        }
+        guard.unlock();
+        if (ret == 0)
+            pcontainer_delete(fd_, cid_);
+    }
+}
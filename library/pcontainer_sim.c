@@ -0,0 +1,957 @@
+#include "pcontainer.h"
+#include <processor_container/pcontainer_policy.h>
+#include <linux/futex.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Simulation backend of the library: the same calls as pcontainer.c, run in
+ * user space without the kernel module. Containers compete for a number of
+ * slots (PCONTAINER_SIM_SLOTS, one per online cpu by default) of a single run
+ * queue under one mutex, with the policy of the module from
+ * pcontainer_policy.h; a thread waits for its turn on a futex. A tick thread
+ * stands in for the hrtimers of the module and sends SIGPROF to a thread that
+ * lost its turn, like the module does without task_work. Preload it
+ * (LD_PRELOAD=libpcontainer_sim.so.1.0) or link with -lpcontainer_sim.
+ */
+
+#define SIM_HASH_BITS 12
+
+struct sim_container;
+
+struct sim_thread
+{
+    struct sim_container *container;
+    struct sim_thread *prev, *next; // run queue of the container, the active threads first
+    pthread_t thread;
+    int active;
+    volatile int wake; // futex word, changes every time the thread is woken
+};
+
+struct sim_container
+{
+    __u64 cid;
+    struct sim_thread *head, *tail;
+    unsigned int nr_threads;
+    unsigned int width;
+    __u32 shares;
+    __u32 sched_class;
+    __u64 vruntime;
+    __u64 exec_start;
+    int running;
+    int heap_index; // position in the timeline, -1 while running or new
+    struct sim_container *rprev, *rnext; // running containers
+    struct sim_container *hnext;
+};
+
+static pthread_mutex_t sim_lock = PTHREAD_MUTEX_INITIALIZER; // protects everything below
+static struct sim_container *sim_table[1 << SIM_HASH_BITS];
+static struct sim_container **sim_timeline; // min-heap of the waiting containers by vruntime
+static int sim_nr_queued, sim_heap_size;
+static unsigned int sim_nr_running, sim_nr_slots;
+static __u64 sim_min_vruntime;
+static struct sim_container *sim_running;
+static __u64 sim_tick_ns; // quantum of the tick thread, 0 while SIGPROF drives the switches
+static int sim_ticking; // the tick thread is alive
+
+static __thread struct sim_thread *sim_self; // node of the calling thread while in a container
+static __thread volatile int sim_busy; // the calling thread is inside the backend
+static __thread volatile int sim_tick_pending; // SIGPROF arrived while it was
+
+static __u64 sim_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void sim_wake(struct sim_thread *t)
+{
+    __sync_fetch_and_add(&t->wake, 1);
+    syscall(SYS_futex, &t->wake, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+static __u64 sim_key(struct sim_container *c)
+{
+    return pcontainer_policy_key(c->vruntime, c->sched_class);
+}
+
+/**
+ * Restore the heap order from position i in both directions.
+ */
+static void timeline_fix(int i)
+{
+    struct sim_container *c = sim_timeline[i];
+    int child;
+
+    while (i > 0 && pcontainer_policy_before(sim_key(c), sim_key(sim_timeline[(i - 1) / 2])))
+    {
+        sim_timeline[i] = sim_timeline[(i - 1) / 2];
+        sim_timeline[i]->heap_index = i;
+        i = (i - 1) / 2;
+    }
+    while ((child = 2 * i + 1) < sim_nr_queued)
+    {
+        if (child + 1 < sim_nr_queued && pcontainer_policy_before(sim_key(sim_timeline[child + 1]), sim_key(sim_timeline[child])))
+            child++;
+        if (!pcontainer_policy_before(sim_key(sim_timeline[child]), sim_key(c)))
+            break;
+        sim_timeline[i] = sim_timeline[child];
+        sim_timeline[i]->heap_index = i;
+        i = child;
+    }
+    sim_timeline[i] = c;
+    c->heap_index = i;
+}
+
+static int timeline_enqueue(struct sim_container *c)
+{
+    struct sim_container **grown;
+
+    if (sim_nr_queued == sim_heap_size)
+    {
+        grown = realloc(sim_timeline, (sim_heap_size * 2 + 64) * sizeof(*grown));
+        if (grown == NULL)
+            return -ENOMEM;
+        sim_timeline = grown;
+        sim_heap_size = sim_heap_size * 2 + 64;
+    }
+    sim_timeline[sim_nr_queued] = c;
+    timeline_fix(sim_nr_queued++);
+    return 0;
+}
+
+static void timeline_dequeue(struct sim_container *c)
+{
+    int i = c->heap_index;
+
+    c->heap_index = -1;
+    if (i != --sim_nr_queued)
+    {
+        sim_timeline[i] = sim_timeline[sim_nr_queued];
+        timeline_fix(i);
+    }
+}
+
+static void sim_charge(struct sim_container *c)
+{
+    __u64 now = sim_now();
+
+    c->vruntime = pcontainer_policy_charge(c->vruntime, now - c->exec_start, c->shares);
+    c->exec_start = now;
+}
+
+static void sim_grant(struct sim_container *c)
+{
+    struct sim_thread *t;
+
+    c->running = 1;
+    c->exec_start = sim_now();
+    sim_nr_running++;
+    c->rprev = NULL;
+    c->rnext = sim_running;
+    if (sim_running != NULL)
+        sim_running->rprev = c;
+    sim_running = c;
+    for (t = c->head; t != NULL && t->active; t = t->next)
+        sim_wake(t);
+}
+
+/**
+ * Make a thread that lost its turn park: right away with the tick thread,
+ * otherwise the next time it calls the library.
+ */
+static void sim_park(struct sim_thread *t)
+{
+    if (sim_tick_ns != 0 && !pthread_equal(t->thread, pthread_self()))
+        pthread_kill(t->thread, SIGPROF);
+}
+
+/**
+ * Take the slot of a running container away and park its active threads.
+ */
+static void sim_stop_running(struct sim_container *c)
+{
+    struct sim_thread *t;
+
+    sim_charge(c);
+    c->running = 0;
+    sim_nr_running--;
+    if (c->rprev != NULL)
+        c->rprev->rnext = c->rnext;
+    else
+        sim_running = c->rnext;
+    if (c->rnext != NULL)
+        c->rnext->rprev = c->rprev;
+    for (t = c->head; t != NULL && t->active; t = t->next)
+        sim_park(t);
+}
+
+static struct sim_container *sim_pick(void)
+{
+    struct sim_container *next;
+
+    if (sim_nr_queued == 0)
+        return NULL;
+    next = sim_timeline[0];
+    timeline_dequeue(next);
+    if (pcontainer_policy_before(sim_min_vruntime, next->vruntime))
+        sim_min_vruntime = next->vruntime;
+    return next;
+}
+
+/**
+ * Make the first width threads of a container the active ones.
+ */
+static void sim_refill(struct sim_container *c)
+{
+    struct sim_thread *t;
+    unsigned int n = 0;
+
+    for (t = c->head; t != NULL; t = t->next)
+    {
+        if (n++ < c->width)
+        {
+            if (!t->active)
+            {
+                t->active = 1;
+                if (c->running)
+                    sim_wake(t);
+            }
+        }
+        else if (t->active)
+        {
+            t->active = 0;
+            if (c->running)
+                sim_park(t);
+        }
+        else
+            break;
+    }
+}
+
+static void sim_unlink(struct sim_container *c, struct sim_thread *t)
+{
+    if (t->prev != NULL)
+        t->prev->next = t->next;
+    else
+        c->head = t->next;
+    if (t->next != NULL)
+        t->next->prev = t->prev;
+    else
+        c->tail = t->prev;
+}
+
+static void sim_append(struct sim_container *c, struct sim_thread *t)
+{
+    t->next = NULL;
+    t->prev = c->tail;
+    if (c->tail != NULL)
+        c->tail->next = t;
+    else
+        c->head = t;
+    c->tail = t;
+}
+
+static struct sim_container **sim_bucket(__u64 cid)
+{
+    return &sim_table[(cid * 0x9e3779b97f4a7c15ULL) >> (64 - SIM_HASH_BITS)];
+}
+
+static struct sim_container *sim_lookup(__u64 cid)
+{
+    struct sim_container *c;
+
+    for (c = *sim_bucket(cid); c != NULL; c = c->hnext)
+    {
+        if (c->cid == cid)
+            return c;
+    }
+    return NULL;
+}
+
+/**
+ * End of the quantum of the container of t: hand its slot to the first
+ * waiting container if the policy says so.
+ */
+static void sim_tick(struct sim_container *c)
+{
+    struct sim_container *next;
+
+    sim_charge(c);
+    if (sim_nr_queued == 0 || !pcontainer_policy_preempt(sim_key(c), sim_key(sim_timeline[0]), 0))
+        return;
+    sim_stop_running(c);
+    next = sim_pick();
+    timeline_enqueue(c);
+    sim_grant(next);
+}
+
+/**
+ * Tick thread: ends the quantum of every running container each sim_tick_ns,
+ * as the hrtimer of the module does.
+ */
+static void *sim_tick_thread(void *x)
+{
+    struct sim_container *c, *next;
+    struct sim_thread *t;
+    struct timespec ts;
+    unsigned int n;
+    __u64 quantum;
+
+    pthread_mutex_lock(&sim_lock);
+    while ((quantum = sim_tick_ns) != 0)
+    {
+        pthread_mutex_unlock(&sim_lock);
+        ts.tv_sec = quantum / 1000000000;
+        ts.tv_nsec = quantum % 1000000000;
+        nanosleep(&ts, NULL);
+        pthread_mutex_lock(&sim_lock);
+        // containers granted a slot meanwhile go to the head of the list and start a fresh quantum
+        for (c = sim_running; c != NULL; c = next)
+        {
+            next = c->rnext;
+            sim_tick(c);
+            if (!c->running || (n = pcontainer_policy_rotate(c->nr_threads, c->width)) == 0)
+                continue;
+            while (n-- > 0)
+            {
+                t = c->head;
+                sim_unlink(c, t);
+                sim_append(c, t);
+                t->active = 0;
+                sim_park(t);
+            }
+            sim_refill(c);
+        }
+    }
+    sim_ticking = 0;
+    pthread_mutex_unlock(&sim_lock);
+    return NULL;
+}
+
+/**
+ * Wait until the calling thread is active in a running container, with
+ * sim_lock held; returns with it released.
+ */
+static void sim_wait_turn(struct sim_thread *t)
+{
+    int seq;
+
+    while (!t->active || !t->container->running)
+    {
+        seq = t->wake;
+        pthread_mutex_unlock(&sim_lock);
+        syscall(SYS_futex, &t->wake, FUTEX_WAIT_PRIVATE, seq, NULL, NULL, 0);
+        pthread_mutex_lock(&sim_lock);
+    }
+    pthread_mutex_unlock(&sim_lock);
+}
+
+static void sim_enter(void)
+{
+    sim_busy = 1;
+}
+
+static void sim_signal(void);
+
+/**
+ * Leave the backend and handle a SIGPROF that arrived meanwhile.
+ */
+static void sim_leave(void)
+{
+    sim_busy = 0;
+    if (sim_tick_pending)
+    {
+        sim_tick_pending = 0;
+        sim_signal();
+    }
+}
+
+static int sim_switch(void)
+{
+    struct sim_thread *t = sim_self;
+    struct sim_container *c;
+
+    sim_enter();
+    if (t == NULL)
+    {
+        sched_yield();
+        sim_busy = 0;
+        return 0;
+    }
+    c = t->container;
+    pthread_mutex_lock(&sim_lock);
+    if (t->active && c->running)
+    {
+        sim_tick(c);
+        if (t->active && c->nr_threads > c->width)
+        {
+            // hand the processor to the first waiting thread of the container
+            sim_unlink(c, t);
+            sim_append(c, t);
+            t->active = 0;
+            sim_refill(c);
+        }
+        else if (t->active && c->running)
+        {
+            pthread_mutex_unlock(&sim_lock);
+            sched_yield();
+            sim_busy = 0;
+            return 0;
+        }
+    }
+    sim_wait_turn(t);
+    // a tick that arrived while waiting belongs to the quantum that ended
+    sim_tick_pending = 0;
+    sim_busy = 0;
+    return 0;
+}
+
+/**
+ * a device descriptor for the other calls; nothing to open in the simulation.
+ */
+static void sim_fork_prepare(void)
+{
+    pthread_mutex_lock(&sim_lock);
+}
+
+static void sim_fork_parent(void)
+{
+    pthread_mutex_unlock(&sim_lock);
+}
+
+/**
+ * a child starts without the tick thread and the alarm of its parent, like
+ * a process that opened the module for the first time.
+ */
+static void sim_fork_child(void)
+{
+    sim_ticking = 0;
+    sim_tick_ns = 0;
+    pthread_mutex_unlock(&sim_lock);
+}
+
+static void sim_atfork(void)
+{
+    pthread_atfork(sim_fork_prepare, sim_fork_parent, sim_fork_child);
+}
+
+int pcontainer_open(void)
+{
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+
+    pthread_once(&once, sim_atfork);
+    return open("/dev/null", O_RDWR);
+}
+
+int pcontainer_context_switch_handler(int devfd, int cid)
+{
+    return sim_switch();
+}
+
+int pcontainer_create(int devfd, int cid)
+{
+    struct sim_thread *t;
+    struct sim_container *c;
+
+    if (sim_self != NULL)
+    {
+        errno = EBUSY;
+        return -1;
+    }
+    t = calloc(1, sizeof(*t));
+    if (t == NULL)
+        return -1;
+    sim_enter();
+    pthread_mutex_lock(&sim_lock);
+    if (sim_nr_slots == 0)
+    {
+        const char *slots = getenv("PCONTAINER_SIM_SLOTS");
+        sim_nr_slots = slots != NULL && atoi(slots) > 0 ? atoi(slots) : sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    c = sim_lookup(cid);
+    if (c != NULL)
+    {
+        t->container = c;
+        t->thread = pthread_self();
+        sim_append(c, t);
+        c->nr_threads++;
+        sim_refill(c);
+    }
+    else
+    {
+        c = calloc(1, sizeof(*c));
+        if (c == NULL)
+        {
+            pthread_mutex_unlock(&sim_lock);
+            free(t);
+            sim_leave();
+            return -1;
+        }
+        c->cid = cid;
+        c->width = 1;
+        c->shares = PCONTAINER_DEFAULT_SHARES;
+        c->vruntime = sim_min_vruntime;
+        c->heap_index = -1;
+        c->hnext = *sim_bucket(cid);
+        *sim_bucket(cid) = c;
+        t->container = c;
+        t->thread = pthread_self();
+        t->active = 1;
+        sim_append(c, t);
+        c->nr_threads = 1;
+        if (sim_nr_running < sim_nr_slots)
+            sim_grant(c);
+        else
+            timeline_enqueue(c);
+    }
+    sim_self = t;
+    sim_wait_turn(t);
+    sim_tick_pending = 0;
+    sim_leave();
+    return 0;
+}
+
+int pcontainer_delete(int devfd, int cid)
+{
+    struct sim_thread *t = sim_self;
+    struct sim_container *c, **link;
+    struct sim_container *next;
+
+    if (t == NULL)
+        return 0;
+    sim_enter();
+    c = t->container;
+    pthread_mutex_lock(&sim_lock);
+    sim_unlink(c, t);
+    if (--c->nr_threads == 0)
+    {
+        for (link = sim_bucket(c->cid); *link != c; link = &(*link)->hnext)
+            ;
+        *link = c->hnext;
+        if (c->running)
+        {
+            sim_stop_running(c);
+            next = sim_pick();
+            if (next != NULL)
+                sim_grant(next);
+        }
+        else if (c->heap_index >= 0)
+            timeline_dequeue(c);
+        free(c);
+    }
+    else if (t->active)
+        sim_refill(c);
+    pthread_mutex_unlock(&sim_lock);
+    sim_self = NULL;
+    free(t);
+    sim_leave();
+    return 0;
+}
+
+/**
+ * the containers of the backend belong to the process, it has only the one
+ * namespace.
+ */
+int pcontainer_set_namespace(int devfd, unsigned long long key)
+{
+    if (key != 0)
+    {
+        errno = ENOSYS;
+        return -1;
+    }
+    return 0;
+}
+
+unsigned long long pcontainer_namespace_id(int devfd)
+{
+    return 1;
+}
+
+/**
+ * the backend has one flat timeline, there are no groups to create
+ * containers in.
+ */
+int pcontainer_create_child(int devfd, int cid, int parent)
+{
+    errno = ENOSYS;
+    return -1;
+}
+
+int pcontainer_set_group(int devfd, int gid, int parent, int shares)
+{
+    errno = ENOSYS;
+    return -1;
+}
+
+int pcontainer_set_shares(int devfd, int cid, int shares)
+{
+    struct sim_container *c;
+    int ret = -1;
+
+    if (shares <= 0 || shares > PCONTAINER_MAX_SHARES)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    sim_enter();
+    pthread_mutex_lock(&sim_lock);
+    c = sim_lookup(cid);
+    if (c != NULL)
+    {
+        // the runtime so far is charged at the old rate
+        if (c->running)
+            sim_charge(c);
+        c->shares = shares;
+        ret = 0;
+    }
+    pthread_mutex_unlock(&sim_lock);
+    sim_leave();
+    if (ret != 0)
+        errno = ENOENT;
+    return ret;
+}
+
+int pcontainer_set_class(int devfd, int cid, int sched_class)
+{
+    struct sim_container *c;
+    int ret = -1;
+
+    if (sched_class != PCONTAINER_CLASS_BATCH && sched_class != PCONTAINER_CLASS_LATENCY)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    sim_enter();
+    pthread_mutex_lock(&sim_lock);
+    c = sim_lookup(cid);
+    if (c != NULL)
+    {
+        c->sched_class = sched_class;
+        if (c->heap_index >= 0)
+            timeline_fix(c->heap_index);
+        ret = 0;
+    }
+    pthread_mutex_unlock(&sim_lock);
+    sim_leave();
+    if (ret != 0)
+        errno = ENOENT;
+    return ret;
+}
+
+/**
+ * the simulation has a single run queue, affinity only checks its arguments.
+ */
+int pcontainer_set_affinity(int devfd, int cid, unsigned long long cpus)
+{
+    int ret;
+
+    sim_enter();
+    pthread_mutex_lock(&sim_lock);
+    ret = sim_lookup(cid) != NULL ? 0 : -1;
+    pthread_mutex_unlock(&sim_lock);
+    sim_leave();
+    if (ret != 0)
+        errno = ENOENT;
+    return ret;
+}
+
+/**
+ * and placement as well.
+ */
+int pcontainer_set_placement(int devfd, int cid, int placement)
+{
+    if (placement < PCONTAINER_PLACE_OFF || placement > PCONTAINER_PLACE_STRICT)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    return pcontainer_set_affinity(devfd, cid, 0);
+}
+
+int pcontainer_set_width(int devfd, int cid, int width)
+{
+    struct sim_container *c;
+    int ret = -1;
+
+    if (width <= 0 || width > PCONTAINER_MAX_WIDTH)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    sim_enter();
+    pthread_mutex_lock(&sim_lock);
+    c = sim_lookup(cid);
+    if (c != NULL)
+    {
+        c->width = width;
+        sim_refill(c);
+        ret = 0;
+    }
+    pthread_mutex_unlock(&sim_lock);
+    sim_leave();
+    if (ret != 0)
+        errno = ENOENT;
+    return ret;
+}
+
+/**
+ * the simulation allocates from malloc, preallocation only checks its argument.
+ */
+int pcontainer_prealloc(int devfd, int nodes)
+{
+    if (nodes < 0 || nodes > PCONTAINER_MAX_PREALLOC)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+// tid of the calling thread, so that a free lock is taken without a system call
+static __thread __u32 lock_tid;
+
+/**
+ * same lock word as the module, waiters sleep on it as a futex.
+ */
+int pcontainer_lock(int devfd, pcontainer_lock_t *lock)
+{
+    __u32 word;
+
+    if (lock_tid == 0)
+        lock_tid = syscall(SYS_gettid) & PCONTAINER_LOCK_TID_MASK;
+    if (__sync_bool_compare_and_swap(&lock->word, 0, lock_tid))
+        return 0;
+    for (;;)
+    {
+        word = lock->word;
+        if (word == 0)
+        {
+            // taken over while others may still wait, keep them wakeable
+            if (__sync_bool_compare_and_swap(&lock->word, 0, lock_tid | PCONTAINER_LOCK_CONTENDED))
+                return 0;
+            continue;
+        }
+        if (!(word & PCONTAINER_LOCK_CONTENDED) &&
+            !__sync_bool_compare_and_swap(&lock->word, word, word | PCONTAINER_LOCK_CONTENDED))
+            continue;
+        syscall(SYS_futex, &lock->word, FUTEX_WAIT_PRIVATE, word | PCONTAINER_LOCK_CONTENDED, NULL, NULL, 0);
+    }
+}
+
+int pcontainer_unlock(int devfd, pcontainer_lock_t *lock)
+{
+    if (__sync_bool_compare_and_swap(&lock->word, lock_tid, 0))
+        return 0;
+    __atomic_store_n(&lock->word, 0, __ATOMIC_RELEASE);
+    syscall(SYS_futex, &lock->word, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+    return 0;
+}
+
+/**
+ * quotas need the period timers of the module.
+ */
+int pcontainer_set_quota(int devfd, int cid, unsigned int quota_us, unsigned int period_us)
+{
+    errno = ENOSYS;
+    return -1;
+}
+
+/**
+ * the tick thread has one quantum for all containers.
+ */
+int pcontainer_set_slice(int devfd, int cid, unsigned int min_us, unsigned int max_us)
+{
+    errno = ENOSYS;
+    return -1;
+}
+
+/**
+ * the command ring and the statistics live in the module only.
+ */
+int pcontainer_ring_init(int devfd, pcontainer_ring_t *ring)
+{
+    errno = ENOSYS;
+    return -1;
+}
+
+int pcontainer_ring_queue(pcontainer_ring_t *ring, int opcode, int tid, int cid, unsigned long long op, unsigned long long user_data)
+{
+    errno = ENOSYS;
+    return -1;
+}
+
+int pcontainer_ring_submit(pcontainer_ring_t *ring)
+{
+    errno = ENOSYS;
+    return -1;
+}
+
+int pcontainer_ring_reap(pcontainer_ring_t *ring, struct pcontainer_cqe *cqes, int max)
+{
+    return 0;
+}
+
+int pcontainer_ring_sqpoll(pcontainer_ring_t *ring, int idle_us)
+{
+    errno = ENOSYS;
+    return -1;
+}
+
+void pcontainer_ring_exit(pcontainer_ring_t *ring)
+{
+}
+
+struct pcontainer_stats_page *pcontainer_stats_map(int devfd)
+{
+    errno = ENOSYS;
+    return NULL;
+}
+
+int pcontainer_stats_read(struct pcontainer_stats_page *page, int slot, struct pcontainer_stats *stats)
+{
+    return 0;
+}
+
+int pcontainer_stats_find(struct pcontainer_stats_page *page, int cid, struct pcontainer_stats *stats)
+{
+    errno = ENOENT;
+    return -1;
+}
+
+void pcontainer_stats_unmap(struct pcontainer_stats_page *page)
+{
+}
+
+struct pcontainer_turn_page *pcontainer_turn_map(int devfd)
+{
+    errno = ENOSYS;
+    return NULL;
+}
+
+int pcontainer_turn_read(struct pcontainer_turn_page *page, int slot, struct pcontainer_turn *turn)
+{
+    return 0;
+}
+
+void pcontainer_turn_unmap(struct pcontainer_turn_page *page)
+{
+}
+
+/**
+ * the backend publishes no turns, cooperative code switches every time.
+ */
+long long pcontainer_turn_left(void)
+{
+    return 0;
+}
+
+static unsigned long long sim_signals; // SIGPROF handled, the backend skips none
+
+void pcontainer_switch_counts(unsigned long long *signals, unsigned long long *skipped)
+{
+    *signals = __atomic_load_n(&sim_signals, __ATOMIC_RELAXED);
+    *skipped = 0;
+}
+
+/**
+ * SIGPROF from the tick thread parks a thread that lost its turn, the one of
+ * the alarm of pcontainer_init() ends the quantum of the running thread.
+ */
+static void sim_signal(void)
+{
+    struct sim_thread *t = sim_self;
+
+    if (sim_tick_ns == 0)
+    {
+        sim_switch();
+        return;
+    }
+    if (t == NULL)
+        return;
+    sim_busy = 1;
+    pthread_mutex_lock(&sim_lock);
+    sim_wait_turn(t);
+    sim_tick_pending = 0;
+    sim_busy = 0;
+}
+
+/**
+ * handle SIGPROF now unless the thread is inside the backend holding sim_lock,
+ * then when it leaves.
+ */
+static void handler()
+{
+    __atomic_add_fetch(&sim_signals, 1, __ATOMIC_RELAXED);
+    if (sim_busy)
+        sim_tick_pending = 1;
+    else
+        sim_signal();
+}
+
+/**
+ * install handler() for SIGPROF and arm the alarm every quantum_us
+ * microseconds, 0 disarms it.
+ */
+static int sim_alarm(int quantum_us)
+{
+    struct sigaction sa;
+    struct itimerval timeout;
+
+    sa.sa_flags = SA_SIGINFO | SA_RESTART | SA_ONSTACK;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_sigaction = handler;
+    if (sigaction(SIGPROF, &sa, NULL) == -1)
+        return -1;
+    timeout.it_value.tv_sec = quantum_us / 1000000;
+    timeout.it_value.tv_usec = quantum_us % 1000000;
+    timeout.it_interval = timeout.it_value;
+    return setitimer(ITIMER_PROF, &timeout, NULL);
+}
+
+int pcontainer_init(int devfd)
+{
+    pthread_mutex_lock(&sim_lock);
+    sim_tick_ns = 0;
+    pthread_mutex_unlock(&sim_lock);
+    return sim_alarm(5);
+}
+
+/**
+ * end the quanta from the tick thread every quantum_us microseconds instead
+ * of the SIGPROF alarm; 0 goes back to switches driven by the threads.
+ */
+int pcontainer_init_kernel_tick(int devfd, int quantum_us)
+{
+    pthread_t tick;
+    int ret = 0;
+
+    if (sim_alarm(0) != 0)
+        return -1;
+    if (quantum_us < 0)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    pthread_mutex_lock(&sim_lock);
+    sim_tick_ns = quantum_us * 1000ULL;
+    if (sim_tick_ns != 0 && !sim_ticking)
+    {
+        ret = pthread_create(&tick, NULL, sim_tick_thread, NULL);
+        if (ret == 0)
+        {
+            pthread_detach(tick);
+            sim_ticking = 1;
+        }
+    }
+    pthread_mutex_unlock(&sim_lock);
+    if (ret != 0)
+    {
+        errno = ret;
+        return -1;
+    }
+    return 0;
+}